@@ -101,6 +101,53 @@ void Canvas::endUpdate()
 }
 
 
+void Canvas::beginBatch()
+{
+  m_displayController->beginBatch();
+}
+
+
+void Canvas::submitBatch()
+{
+  m_displayController->submitBatch();
+}
+
+
+void Canvas::beginRecord()
+{
+  m_savedOrigin       = m_origin;
+  m_savedClippingRect = m_clippingRect;
+  m_origin            = Point(0, 0);
+  m_clippingRect      = INVALIDRECT;
+  m_displayController->beginRecording();
+}
+
+
+PrimitiveRecording * Canvas::endRecord()
+{
+  m_origin       = m_savedOrigin;
+  m_clippingRect = m_savedClippingRect;
+  return m_displayController->endRecording();
+}
+
+
+void Canvas::playRecord(PrimitiveRecording const * recording, int offsetX, int offsetY)
+{
+  if (recording == nullptr)
+    return;
+  Primitive p;
+  p.cmd               = PrimitiveCmd::ExecuteRecording;
+  p.recordingPlayInfo = RecordingPlayInfo(offsetX, offsetY, recording);
+  m_displayController->addPrimitive(p);
+}
+
+
+void Canvas::addPrimitives(Primitive const * primitives, int count)
+{
+  m_displayController->addPrimitives(primitives, count);
+}
+
+
 void Canvas::clear()
 {
   Primitive p;
@@ -490,6 +537,24 @@ void Canvas::drawBitmap(int X, int Y, Bitmap const * bitmap)
 }
 
 
+void Canvas::drawTileMap(TileMap * tileMap)
+{
+  Primitive p;
+  p.cmd                = PrimitiveCmd::DrawTileMap;
+  p.tileMapDrawingInfo = TileMapDrawingInfo(tileMap, 0, 0);
+  m_displayController->addPrimitive(p);
+}
+
+
+void Canvas::scrollTileMap(TileMap * tileMap, int offsetX, int offsetY)
+{
+  Primitive p;
+  p.cmd                = PrimitiveCmd::ScrollTileMap;
+  p.tileMapDrawingInfo = TileMapDrawingInfo(tileMap, offsetX, offsetY);
+  m_displayController->addPrimitive(p);
+}
+
+
 void Canvas::swapBuffers()
 {
   Primitive p;
@@ -107,6 +107,82 @@ public:
    */
   void endUpdate();
 
+  /**
+   * @brief Starts collecting drawings into a batch.
+   *
+   * Drawings are not added to the drawing queue one by one, but sent in blocks (see FABGLIB_PRIMITIVES_BATCH_SIZE),
+   * reducing the queue overhead when many small drawings are performed (ie text or UI repaints).<br>
+   * Remaining drawings are sent calling submitBatch(). Can be nested.
+   *
+   * Example:
+   *
+   *     Canvas.beginBatch();
+   *     for (int y = 0; y < 25; ++y)
+   *       Canvas.drawText(0, y * 8, rows[y]);
+   *     Canvas.submitBatch();
+   */
+  void beginBatch();
+
+  /**
+   * @brief Sends drawings collected after beginBatch().
+   */
+  void submitBatch();
+
+  /**
+   * @brief Starts recording drawings.
+   *
+   * Drawings performed after beginRecord() are not painted, but stored into a PrimitiveRecording, returned by endRecord().
+   * The recording can be painted many times, at different positions, using playRecord(), without repeating the calls
+   * (and the parameters checks) which built it.<br>
+   * Coordinates are relative to the origin at the time playRecord() is called. Origin and clipping rectangle are reset
+   * at the beginning of the recording, and restored by endRecord().<br>
+   * Points of paths are copied into the recording, while glyphs, bitmaps and other referenced data must remain valid
+   * while the recording is used.
+   *
+   * Example:
+   *
+   *     // record a button once...
+   *     Canvas.beginRecord();
+   *     Canvas.setBrushColor(Color::Blue);
+   *     Canvas.fillRectangle(0, 0, 79, 19);
+   *     Canvas.setPenColor(Color::BrightWhite);
+   *     Canvas.drawRectangle(0, 0, 79, 19);
+   *     PrimitiveRecording * button = Canvas.endRecord();
+   *
+   *     // ...and paint it twice
+   *     Canvas.playRecord(button, 10, 10);
+   *     Canvas.playRecord(button, 10, 40);
+   */
+  void beginRecord();
+
+  /**
+   * @brief Stops recording drawings started by beginRecord().
+   *
+   * @return The recording, or nullptr if memory was not enough. Delete it when not needed anymore, after drawings which play it have been executed (see waitCompletion()).
+   */
+  PrimitiveRecording * endRecord();
+
+  /**
+   * @brief Paints drawings recorded using beginRecord() and endRecord().
+   *
+   * Paint state (colors, origin, clipping rectangle...) changed by the recording is restored when it ends.
+   *
+   * @param recording The recording. It is not copied, so it must remain valid until it has been painted. Nothing is painted when nullptr.
+   * @param offsetX Horizontal position, relative to current origin.
+   * @param offsetY Vertical position, relative to current origin.
+   */
+  void playRecord(PrimitiveRecording const * recording, int offsetX = 0, int offsetY = 0);
+
+  /**
+   * @brief Adds a block of primitives to the drawing queue using a single operation.
+   *
+   * Data referenced by the primitives (glyphs, bitmaps...) must remain valid until primitives are executed.
+   *
+   * @param primitives Array of primitives.
+   * @param count Number of primitives in the array.
+   */
+  void addPrimitives(Primitive const * primitives, int count);
+
   /**
    * @brief Swaps screen buffer when double buffering is enabled.
    *
@@ -707,6 +783,41 @@ public:
    */
   void drawBitmap(int X, int Y, Bitmap const * bitmap);
 
+  /**
+   * @brief Draws a tile map inside the scrolling region.
+   *
+   * The map position shown at the top-left corner of scrolling region is specified by TileMap.viewX and TileMap.viewY.
+   *
+   * @param tileMap Pointer to tile map structure. It must be valid until the primitive is executed.
+   *
+   * Example:
+   *
+   *     static Bitmap * tiles[] = { &grass, &water, &rock };
+   *     static uint8_t map[64 * 15];  // 64x15 tiles
+   *     static TileMap tileMap(16, 16, 64, 15, tiles, map);
+   *
+   *     Canvas.setScrollingRegion(0, 0, 319, 239);
+   *     Canvas.drawTileMap(&tileMap);
+   */
+  void drawTileMap(TileMap * tileMap);
+
+  /**
+   * @brief Moves the view of a tile map drawn inside the scrolling region.
+   *
+   * Screen content of the scrolling region is scrolled and only the tiles of exposed strips are drawn, so this is much faster
+   * than drawing the whole map. TileMap.viewX and TileMap.viewY are updated when the primitive is executed.
+   *
+   * @param tileMap Pointer to tile map structure, previously drawn with Canvas.drawTileMap().
+   * @param offsetX Number of pixels to move the view right (offsetX > 0) or left (offsetX < 0).
+   * @param offsetY Number of pixels to move the view down (offsetY > 0) or up (offsetY < 0).
+   *
+   * Example:
+   *
+   *     // side scrolling, 2 pixels per frame
+   *     Canvas.scrollTileMap(&tileMap, 2, 0);
+   */
+  void scrollTileMap(TileMap * tileMap, int offsetX, int offsetY);
+
   /**
    * @brief Draws a sequence of lines.
    *
@@ -757,6 +868,10 @@ private:
 
   Point               m_origin;
   Rect                m_clippingRect;
+
+  // origin and clipping rectangle before beginRecord()
+  Point               m_savedOrigin;
+  Rect                m_savedClippingRect;
 };
 
 
@@ -0,0 +1,497 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "fabutils.h"
+#include "FramebufferController.h"
+
+
+
+
+namespace fabgl {
+
+
+
+// calls the template method specialized for current pixel format
+#define FB_DISPATCH(method, ...) \
+  switch (m_format) { \
+    case NativePixelFormat::SBGR2222: method<FBFormatSBGR2222>(__VA_ARGS__); break; \
+    case NativePixelFormat::RGB565BE: method<FBFormatRGB565BE>(__VA_ARGS__); break; \
+    default:                          method<FBFormatRGB888>(__VA_ARGS__);   break; \
+  }
+
+
+
+// 8 bit per pixel: 00BBGGRR (like VGAController without sync signals)
+struct FBFormatSBGR2222 {
+  typedef uint8_t Pixel;
+
+  static Pixel fromRGB888(RGB888 const & c)      { return (c.R >> 6) | ((c.G >> 6) << 2) | ((c.B >> 6) << 4); }
+  static RGB888 toRGB888(Pixel p)                { return RGB888((p & 3) * 85, ((p >> 2) & 3) * 85, ((p >> 4) & 3) * 85); }
+  static Pixel fromRGBA2222(uint8_t rgba2222)    { return rgba2222 & 0x3f; }
+  static Pixel fromRGBA8888(RGBA8888 const & c)  { return (c.R >> 6) | ((c.G >> 6) << 2) | ((c.B >> 6) << 4); }
+  static Pixel invert(Pixel p)                   { return ~p & 0x3f; }
+};
+
+
+// 16 bit per pixel: RGB565 big endian, the same layout sent to ST7789
+//   GGGBBBBB RRRRRGGG
+struct FBFormatRGB565BE {
+  typedef uint16_t Pixel;
+
+  static Pixel fromRGB888(RGB888 const & c)
+  {
+    return ((uint16_t)(c.G & 0xe0) >> 5) |    //  0 ..  2: bits 5..7 of G
+           ((uint16_t)(c.R & 0xf8)) |         //  3 ..  7: bits 3..7 of R
+           ((uint16_t)(c.B & 0xf8) << 5) |    //  8 .. 12: bits 3..7 of B
+           ((uint16_t)(c.G & 0x1c) << 11);    // 13 .. 15: bits 2..4 of G
+  }
+  static RGB888 toRGB888(Pixel p)                { return RGB888((p & 0xf8), ((p & 7) << 5) | ((p & 0xe000) >> 11), ((p & 0x1f00) >> 5)); }
+  static Pixel fromRGBA2222(uint8_t rgba2222)    { return fromRGB888(RGB888((rgba2222 & 3) * 85, ((rgba2222 >> 2) & 3) * 85, ((rgba2222 >> 4) & 3) * 85)); }
+  static Pixel fromRGBA8888(RGBA8888 const & c)  { return fromRGB888(RGB888(c.R, c.G, c.B)); }
+  static Pixel invert(Pixel p)                   { return ~p; }
+};
+
+
+// 24 bit per pixel: R, G, B bytes
+struct FBFormatRGB888 {
+  typedef RGB888 Pixel;
+
+  static Pixel fromRGB888(RGB888 const & c)      { return c; }
+  static RGB888 toRGB888(Pixel p)                { return p; }
+  static Pixel fromRGBA2222(uint8_t rgba2222)    { return RGB888((rgba2222 & 3) * 85, ((rgba2222 >> 2) & 3) * 85, ((rgba2222 >> 4) & 3) * 85); }
+  static Pixel fromRGBA8888(RGBA8888 const & c)  { return RGB888(c.R, c.G, c.B); }
+  static Pixel invert(Pixel p)                   { return RGB888(~p.R, ~p.G, ~p.B); }
+};
+
+
+
+FramebufferController::FramebufferController()
+  : m_viewPort(nullptr),
+    m_viewPortWidth(0),
+    m_viewPortHeight(0),
+    m_format(NativePixelFormat::RGB565BE),
+    m_bytesPerPixel(2)
+{
+  // there isn't a background task, so primitives are always executed immediately
+  enableBackgroundPrimitiveExecution(false);
+}
+
+
+FramebufferController::~FramebufferController()
+{
+  end();
+}
+
+
+void FramebufferController::end()
+{
+  freeViewPort();
+}
+
+
+bool FramebufferController::setResolution(int width, int height, NativePixelFormat format)
+{
+  switch (format) {
+    case NativePixelFormat::SBGR2222:
+      m_bytesPerPixel = 1;
+      break;
+    case NativePixelFormat::RGB565BE:
+      m_bytesPerPixel = 2;
+      break;
+    case NativePixelFormat::RGB888:
+      m_bytesPerPixel = 3;
+      break;
+    default:
+      return false; // unsupported pixel format
+  }
+
+  freeViewPort();
+
+  m_format         = format;
+  m_viewPortWidth  = width;
+  m_viewPortHeight = height;
+
+  bool allocated = allocViewPort();
+  if (!allocated) {
+    // not enough memory, nothing will be painted
+    m_viewPortWidth  = 0;
+    m_viewPortHeight = 0;
+  }
+
+  resetPaintState();
+
+  return allocated;
+}
+
+
+bool FramebufferController::allocViewPort()
+{
+  if (m_viewPortWidth <= 0 || m_viewPortHeight <= 0)
+    return false;
+  m_viewPort = (uint8_t*) malloc(frameBufferSize());
+  if (m_viewPort == nullptr)
+    return false;
+  memset(m_viewPort, 0, frameBufferSize());
+  return true;
+}
+
+
+void FramebufferController::freeViewPort()
+{
+  free(m_viewPort);
+  m_viewPort = nullptr;
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbSetPixelAt(PixelDesc const & pixelDesc, Rect & updateRect)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  genericSetPixelAt(pixelDesc, updateRect,
+                    [&] (RGB888 const & color)        { return TPixelFormat::fromRGB888(color); },
+                    [&] (int X, int Y, Pixel pattern) { rawGetRow<Pixel>(Y)[X] = pattern; }
+                   );
+}
+
+
+void FramebufferController::setPixelAt(PixelDesc const & pixelDesc, Rect & updateRect)
+{
+  FB_DISPATCH(fbSetPixelAt, pixelDesc, updateRect);
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbAbsDrawLine(int X1, int Y1, int X2, int Y2, RGB888 color)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  genericAbsDrawLine(X1, Y1, X2, Y2, color,
+                     [&] (RGB888 const & color)                 { return TPixelFormat::fromRGB888(color); },
+                     [&] (int Y, int X1, int X2, Pixel pattern) { auto row = rawGetRow<Pixel>(Y); for (int x = X1; x <= X2; ++x) row[x] = pattern; },
+                     [&] (int Y, int X1, int X2)                { fbRawInvertRow<TPixelFormat>(Y, X1, X2); },
+                     [&] (int X, int Y, Pixel pattern)          { rawGetRow<Pixel>(Y)[X] = pattern; },
+                     [&] (int X, int Y)                         { auto row = rawGetRow<Pixel>(Y); row[X] = TPixelFormat::invert(row[X]); }
+                     );
+}
+
+
+// coordinates are absolute values (not relative to origin)
+// line clipped on current absolute clipping rectangle
+void FramebufferController::absDrawLine(int X1, int Y1, int X2, int Y2, RGB888 color)
+{
+  FB_DISPATCH(fbAbsDrawLine, X1, Y1, X2, Y2, color);
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbRawFillRow(int y, int x1, int x2, RGB888 color)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  const Pixel pattern = TPixelFormat::fromRGB888(color);
+  auto px = rawGetRow<Pixel>(y) + x1;
+  for (int x = x1; x <= x2; ++x, ++px)
+    *px = pattern;
+}
+
+
+// parameters not checked
+void FramebufferController::rawFillRow(int y, int x1, int x2, RGB888 color)
+{
+  if (m_bytesPerPixel == 1)
+    memset(rawGetRow<uint8_t>(y) + x1, FBFormatSBGR2222::fromRGB888(color), x2 - x1 + 1);
+  else
+    FB_DISPATCH(fbRawFillRow, y, x1, x2, color);
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbRawInvertRow(int y, int x1, int x2)
+{
+  auto px = rawGetRow<typename TPixelFormat::Pixel>(y) + x1;
+  for (int x = x1; x <= x2; ++x, ++px)
+    *px = TPixelFormat::invert(*px);
+}
+
+
+// parameters not checked
+void FramebufferController::rawInvertRow(int y, int x1, int x2)
+{
+  FB_DISPATCH(fbRawInvertRow, y, x1, x2);
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbDrawEllipse(Size const & size, Rect & updateRect)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  genericDrawEllipse(size, updateRect,
+                     [&] (RGB888 const & color)        { return TPixelFormat::fromRGB888(color); },
+                     [&] (int X, int Y, Pixel pattern) { rawGetRow<Pixel>(Y)[X] = pattern; }
+                    );
+}
+
+
+void FramebufferController::drawEllipse(Size const & size, Rect & updateRect)
+{
+  FB_DISPATCH(fbDrawEllipse, size, updateRect);
+}
+
+
+void FramebufferController::clear(Rect & updateRect)
+{
+  hideSprites(updateRect);
+  auto color = getActualBrushColor();
+  for (int y = 0; y < m_viewPortHeight; ++y)
+    rawFillRow(y, 0, m_viewPortWidth - 1, color);
+}
+
+
+// rows are copied (not swapped) to keep the frame buffer linear
+void FramebufferController::VScroll(int scroll, Rect & updateRect)
+{
+  genericVScroll(scroll, updateRect,
+                 [&] (int x1, int x2, int srcY, int dstY)   { memmove(rawGetRow<uint8_t>(dstY) + x1 * m_bytesPerPixel,
+                                                                      rawGetRow<uint8_t>(srcY) + x1 * m_bytesPerPixel,
+                                                                      (x2 - x1 + 1) * m_bytesPerPixel); },  // rawCopyRow
+                 [&] (int y, int x1, int x2, RGB888 color)  { rawFillRow(y, x1, x2, color); }               // rawFillRow
+                );
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbHScroll(int scroll, Rect & updateRect)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  genericHScroll(scroll, updateRect,
+                 [&] (RGB888 const & color)              { return TPixelFormat::fromRGB888(color); }, // preparePixel
+                 [&] (int y)                             { return rawGetRow<Pixel>(y); },             // rawGetRow
+                 [&] (Pixel * row, int x)                { return row[x]; },                          // rawGetPixelInRow
+                 [&] (Pixel * row, int x, Pixel pattern) { row[x] = pattern; }                        // rawSetPixelInRow
+                );
+}
+
+
+void FramebufferController::HScroll(int scroll, Rect & updateRect)
+{
+  FB_DISPATCH(fbHScroll, scroll, updateRect);
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbDrawGlyph(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  genericDrawGlyph(glyph, glyphOptions, penColor, brushColor, updateRect,
+                   [&] (RGB888 const & color)              { return TPixelFormat::fromRGB888(color); },
+                   [&] (int y)                             { return rawGetRow<Pixel>(y); },
+                   [&] (Pixel * row, int x, Pixel pattern) { row[x] = pattern; }
+                  );
+}
+
+
+void FramebufferController::drawGlyph(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect)
+{
+  FB_DISPATCH(fbDrawGlyph, glyph, glyphOptions, penColor, brushColor, updateRect);
+}
+
+
+void FramebufferController::invertRect(Rect const & rect, Rect & updateRect)
+{
+  genericInvertRect(rect, updateRect,
+                    [&] (int Y, int X1, int X2) { rawInvertRow(Y, X1, X2); }
+                   );
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbSwapFGBG(Rect const & rect, Rect & updateRect)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  genericSwapFGBG(rect, updateRect,
+                  [&] (RGB888 const & color)              { return TPixelFormat::fromRGB888(color); },
+                  [&] (int y)                             { return rawGetRow<Pixel>(y); },
+                  [&] (Pixel * row, int x)                { return row[x]; },
+                  [&] (Pixel * row, int x, Pixel pattern) { row[x] = pattern; }
+                 );
+}
+
+
+void FramebufferController::swapFGBG(Rect const & rect, Rect & updateRect)
+{
+  FB_DISPATCH(fbSwapFGBG, rect, updateRect);
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbCopyRect(Rect const & source, Rect & updateRect)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  genericCopyRect(source, updateRect,
+                  [&] (int y)                             { return rawGetRow<Pixel>(y); },
+                  [&] (Pixel * row, int x)                { return row[x]; },
+                  [&] (Pixel * row, int x, Pixel pattern) { row[x] = pattern; }
+                 );
+}
+
+
+// supports overlapping of source and dest rectangles
+void FramebufferController::copyRect(Rect const & source, Rect & updateRect)
+{
+  FB_DISPATCH(fbCopyRect, source, updateRect);
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbReadScreen(Rect const & rect, RGB888 * destBuf)
+{
+  for (int y = rect.Y1; y <= rect.Y2; ++y) {
+    auto row = rawGetRow<typename TPixelFormat::Pixel>(y) + rect.X1;
+    for (int x = rect.X1; x <= rect.X2; ++x, ++destBuf, ++row)
+      *destBuf = TPixelFormat::toRGB888(*row);
+  }
+}
+
+
+// no bounds check is done!
+void FramebufferController::readScreen(Rect const & rect, RGB888 * destBuf)
+{
+  FB_DISPATCH(fbReadScreen, rect, destBuf);
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbRawDrawBitmap_Native(int destX, int destY, Bitmap const * bitmap, int X1, int Y1, int XCount, int YCount)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  genericRawDrawBitmap_Native(destX, destY, (Pixel const *) bitmap->data, bitmap->width, X1, Y1, XCount, YCount,
+                              [&] (int y)                          { return rawGetRow<Pixel>(y); },  // rawGetRow
+                              [&] (Pixel * row, int x, Pixel src)  { row[x] = src; }                 // rawSetPixelInRow
+                             );
+}
+
+
+void FramebufferController::rawDrawBitmap_Native(int destX, int destY, Bitmap const * bitmap, int X1, int Y1, int XCount, int YCount)
+{
+  FB_DISPATCH(fbRawDrawBitmap_Native, destX, destY, bitmap, X1, Y1, XCount, YCount);
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbRawDrawBitmap_Mask(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  auto foregroundPattern = TPixelFormat::fromRGB888(bitmap->foregroundColor);
+  genericRawDrawBitmap_Mask(destX, destY, bitmap, (Pixel*)saveBackground, X1, Y1, XCount, YCount,
+                            [&] (int y)              { return rawGetRow<Pixel>(y); },      // rawGetRow
+                            [&] (Pixel * row, int x) { return row[x]; },                   // rawGetPixelInRow
+                            [&] (Pixel * row, int x) { row[x] = foregroundPattern; }       // rawSetPixelInRow
+                           );
+}
+
+
+void FramebufferController::rawDrawBitmap_Mask(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  FB_DISPATCH(fbRawDrawBitmap_Mask, destX, destY, bitmap, saveBackground, X1, Y1, XCount, YCount);
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbRawDrawBitmap_RGBA2222(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  genericRawDrawBitmap_RGBA2222(destX, destY, bitmap, (Pixel*)saveBackground, X1, Y1, XCount, YCount,
+                                [&] (int y)                           { return rawGetRow<Pixel>(y); },                     // rawGetRow
+                                [&] (Pixel * row, int x)              { return row[x]; },                                  // rawGetPixelInRow
+                                [&] (Pixel * row, int x, uint8_t src) { row[x] = TPixelFormat::fromRGBA2222(src); }        // rawSetPixelInRow
+                               );
+}
+
+
+void FramebufferController::rawDrawBitmap_RGBA2222(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  FB_DISPATCH(fbRawDrawBitmap_RGBA2222, destX, destY, bitmap, saveBackground, X1, Y1, XCount, YCount);
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbRawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  genericRawDrawBitmap_RGBA8888(destX, destY, bitmap, (Pixel*)saveBackground, X1, Y1, XCount, YCount,
+                                [&] (int y)                                    { return rawGetRow<Pixel>(y); },               // rawGetRow
+                                [&] (Pixel * row, int x)                       { return row[x]; },                            // rawGetPixelInRow
+                                [&] (Pixel * row, int x, RGBA8888 const & src) { row[x] = TPixelFormat::fromRGBA8888(src); }  // rawSetPixelInRow
+                               );
+}
+
+
+void FramebufferController::rawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  FB_DISPATCH(fbRawDrawBitmap_RGBA8888, destX, destY, bitmap, saveBackground, X1, Y1, XCount, YCount);
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbRawColorToNative(RGB888 const & color, void * dest)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  Pixel pixel = TPixelFormat::fromRGB888(color);
+  memcpy(dest, &pixel, sizeof(Pixel));
+}
+
+
+bool FramebufferController::rawColorToNative(RGB888 const & color, void * dest)
+{
+  FB_DISPATCH(fbRawColorToNative, color, dest);
+  return true;
+}
+
+
+template <typename TPixelFormat>
+void FramebufferController::fbRawDrawBitmap_Runs(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  typedef typename TPixelFormat::Pixel Pixel;
+  genericRawDrawBitmap_Runs(destX, destY, bitmap, (Pixel*)saveBackground, X1, Y1, XCount, YCount,
+                            [&] (int y)                                            { return rawGetRow<Pixel>(y); },                    // rawGetRow
+                            [&] (Pixel * row, int x, Pixel * dest, int count)      { memcpy(dest, row + x, count * sizeof(Pixel)); },  // rawCopyFromRow
+                            [&] (Pixel * row, int x, Pixel const * src, int count) { memcpy(row + x, src, count * sizeof(Pixel)); }    // rawCopyToRow
+                           );
+}
+
+
+void FramebufferController::rawDrawBitmap_Runs(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  FB_DISPATCH(fbRawDrawBitmap_Runs, destX, destY, bitmap, saveBackground, X1, Y1, XCount, YCount);
+}
+
+
+// double buffering is not supported
+void FramebufferController::swapBuffers()
+{
+}
+
+
+
+
+} // end of namespace
@@ -0,0 +1,249 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+
+/**
+ * @file
+ *
+ * @brief This file contains fabgl::FramebufferController definition.
+ */
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "fabglconf.h"
+#include "fabutils.h"
+#include "displaycontroller.h"
+
+
+
+
+
+namespace fabgl {
+
+
+
+/**
+ * @brief Display driver that renders into a plain memory buffer.
+ *
+ * FramebufferController does not drive any hardware: all primitives are painted into a linear buffer
+ * allocated on the heap, using one of the SBGR2222 (1 byte per pixel), RGB565BE (2 bytes per pixel) or
+ * RGB888 (3 bytes per pixel) pixel formats.<br>
+ * It only depends on DisplayController, so it can be used to run and measure the drawing code out of the
+ * target (see FABGLIB_HOST_BUILD and tools/hostshim), or to compare painted frames in regression tests.<br>
+ * There is no background task: primitives are executed as soon as they are added. Call enableBackgroundPrimitiveExecution(true)
+ * to queue them instead, then DisplayController.processPrimitives() to execute the queue.<br>
+ * Double buffering is not supported.
+ *
+ * Example:
+ *
+ *     fabgl::FramebufferController DisplayController;
+ *
+ *     DisplayController.setResolution(320, 240, NativePixelFormat::RGB565BE);
+ *
+ *     Canvas cv(&DisplayController);
+ *     cv.clear();
+ *     cv.drawText(0, 0, "Hello World!");
+ *
+ *     // frame is now available in DisplayController.frameBuffer()
+ */
+class FramebufferController : public GenericDisplayController {
+
+public:
+
+  // unwanted methods
+  FramebufferController(FramebufferController const&) = delete;
+  void operator=(FramebufferController const&)        = delete;
+
+  FramebufferController();
+
+  ~FramebufferController();
+
+  /**
+   * @brief Allocates the frame buffer
+   *
+   * @param width Frame buffer width in pixels.
+   * @param height Frame buffer height in pixels.
+   * @param format Pixel format. Allowed values are NativePixelFormat::SBGR2222, NativePixelFormat::RGB565BE and NativePixelFormat::RGB888.
+   *
+   * @return False if the pixel format is not supported or there isn't enough memory. In this case the frame buffer is empty (0x0 pixels).
+   *
+   * Example:
+   *
+   *     DisplayController.setResolution(640, 480, NativePixelFormat::RGB888);
+   */
+  bool setResolution(int width, int height, NativePixelFormat format = NativePixelFormat::RGB565BE);
+
+  /**
+   * @brief Releases the frame buffer
+   */
+  void end();
+
+  // abstract method of DisplayController (there isn't a background task to suspend)
+  void suspendBackgroundPrimitiveExecution() { }
+
+  // abstract method of DisplayController (there isn't a background task to resume)
+  void resumeBackgroundPrimitiveExecution()  { }
+
+  // abstract method of DisplayController
+  NativePixelFormat nativePixelFormat() { return m_format; }
+
+  // abstract method of DisplayController
+  int getViewPortWidth()  { return m_viewPortWidth; }
+
+  // abstract method of DisplayController
+  int getViewPortHeight() { return m_viewPortHeight; }
+
+  // abstract method of DisplayController
+  int getScreenWidth()    { return m_viewPortWidth; }
+
+  // abstract method of DisplayController
+  int getScreenHeight()   { return m_viewPortHeight; }
+
+  void readScreen(Rect const & rect, RGB888 * destBuf);
+
+  /**
+   * @brief Determines the number of bytes used to store a pixel
+   *
+   * @return 1 for SBGR2222, 2 for RGB565BE, 3 for RGB888.
+   */
+  int bytesPerPixel() { return m_bytesPerPixel; }
+
+  /**
+   * @brief Gets the frame buffer
+   *
+   * The frame buffer is a linear array of getViewPortHeight() rows, each one made of getViewPortWidth() * bytesPerPixel() bytes.
+   *
+   * @return Pointer to the first byte of the frame buffer.
+   */
+  uint8_t const * frameBuffer() { return m_viewPort; }
+
+  /**
+   * @brief Determines the frame buffer size in bytes
+   *
+   * @return Frame buffer size in bytes.
+   */
+  int frameBufferSize()         { return m_viewPortWidth * m_viewPortHeight * m_bytesPerPixel; }
+
+
+private:
+
+  // abstract method of DisplayController
+  int getBitmapSavePixelSize() { return m_bytesPerPixel; }
+
+  bool allocViewPort();
+  void freeViewPort();
+
+  template <typename TPixel>
+  TPixel * rawGetRow(int y) { return (TPixel *) (m_viewPort + y * m_viewPortWidth * m_bytesPerPixel); }
+
+  template <typename TPixelFormat> void fbSetPixelAt(PixelDesc const & pixelDesc, Rect & updateRect);
+  template <typename TPixelFormat> void fbAbsDrawLine(int X1, int Y1, int X2, int Y2, RGB888 color);
+  template <typename TPixelFormat> void fbRawFillRow(int y, int x1, int x2, RGB888 color);
+  template <typename TPixelFormat> void fbRawInvertRow(int y, int x1, int x2);
+  template <typename TPixelFormat> void fbDrawEllipse(Size const & size, Rect & updateRect);
+  template <typename TPixelFormat> void fbHScroll(int scroll, Rect & updateRect);
+  template <typename TPixelFormat> void fbDrawGlyph(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect);
+  template <typename TPixelFormat> void fbSwapFGBG(Rect const & rect, Rect & updateRect);
+  template <typename TPixelFormat> void fbCopyRect(Rect const & source, Rect & updateRect);
+  template <typename TPixelFormat> void fbReadScreen(Rect const & rect, RGB888 * destBuf);
+  template <typename TPixelFormat> void fbRawDrawBitmap_Native(int destX, int destY, Bitmap const * bitmap, int X1, int Y1, int XCount, int YCount);
+  template <typename TPixelFormat> void fbRawDrawBitmap_Mask(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+  template <typename TPixelFormat> void fbRawDrawBitmap_RGBA2222(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+  template <typename TPixelFormat> void fbRawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+  template <typename TPixelFormat> void fbRawColorToNative(RGB888 const & color, void * dest);
+  template <typename TPixelFormat> void fbRawDrawBitmap_Runs(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+
+  // abstract method of DisplayController
+  void setPixelAt(PixelDesc const & pixelDesc, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void clear(Rect & updateRect);
+
+  // abstract method of DisplayController
+  void drawEllipse(Size const & size, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void VScroll(int scroll, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void HScroll(int scroll, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void drawGlyph(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void swapBuffers();
+
+  // abstract method of DisplayController
+  void invertRect(Rect const & rect, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void copyRect(Rect const & source, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void swapFGBG(Rect const & rect, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void absDrawLine(int X1, int Y1, int X2, int Y2, RGB888 color);
+
+  // abstract method of DisplayController
+  void rawFillRow(int y, int x1, int x2, RGB888 color);
+
+  void rawInvertRow(int y, int x1, int x2);
+
+  // abstract method of DisplayController
+  void rawDrawBitmap_Native(int destX, int destY, Bitmap const * bitmap, int X1, int Y1, int XCount, int YCount);
+
+  // abstract method of DisplayController
+  void rawDrawBitmap_Mask(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+
+  // abstract method of DisplayController
+  void rawDrawBitmap_RGBA2222(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+
+  // abstract method of DisplayController
+  void rawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+
+  // overridable method of DisplayController
+  bool rawColorToNative(RGB888 const & color, void * dest);
+
+  // overridable method of DisplayController
+  void rawDrawBitmap_Runs(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+
+
+  // rows are stored contiguously, each one made of m_viewPortWidth * m_bytesPerPixel bytes
+  uint8_t *          m_viewPort;
+
+  int16_t            m_viewPortWidth;
+  int16_t            m_viewPortHeight;
+
+  NativePixelFormat  m_format;
+  int8_t             m_bytesPerPixel;
+
+};
+
+
+} // end of namespace
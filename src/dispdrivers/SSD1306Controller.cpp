@@ -39,6 +39,8 @@
 
 #define SSD1306_BACKGROUND_PRIMITIVE_TIMEOUT 10000  // uS
 
+#define SSD1306_DIRTYREGION_MERGECOST        256    // pixels, about the cost of sending page and column address commands
+
 
 #define SSD1306_SETLOWCOLUMN                         0x00
 #define SSD1306_SETHIGHCOLUMN                        0x10
@@ -391,7 +393,7 @@ void SSD1306Controller::updateTaskFunc(void * pvParameters)
 
     ctrl->m_updateTaskRunning = true;
 
-    Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+    DirtyRegion dirtyRegion(SSD1306_DIRTYREGION_MERGECOST);
 
     int64_t startTime = ctrl->backgroundPrimitiveTimeoutEnabled() ? esp_timer_get_time() : 0;
     do {
@@ -400,18 +402,19 @@ void SSD1306Controller::updateTaskFunc(void * pvParameters)
       if (ctrl->getPrimitive(&prim) == false)
         break;
 
-      ctrl->execPrimitive(prim, updateRect);
+      ctrl->execPrimitive(prim, dirtyRegion);
 
       if (ctrl->m_updateTaskFuncSuspended > 0)
         break;
 
     } while (!ctrl->backgroundPrimitiveTimeoutEnabled() || (startTime + SSD1306_BACKGROUND_PRIMITIVE_TIMEOUT > esp_timer_get_time()));
 
-    ctrl->showSprites(updateRect);
+    ctrl->showSprites(dirtyRegion);
 
     ctrl->m_updateTaskRunning = false;
 
-    ctrl->SSD1306_sendScreenBuffer(updateRect);
+    for (int i = 0; i < dirtyRegion.count(); ++i)
+      ctrl->SSD1306_sendScreenBuffer(dirtyRegion[i]);
   }
 }
 
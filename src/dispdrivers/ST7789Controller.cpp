@@ -37,9 +37,14 @@
 
 #define ST7789_BACKGROUND_PRIMITIVE_TIMEOUT 10000  // uS
 
+#define ST7789_DIRTYREGION_MERGECOST        64     // pixels, about the cost of sending address setting commands
+
+#define ST7789_TILE_SIZE                    16     // width and height of tiles used by damage tracking
+
 #define ST7789_SPI_WRITE_FREQUENCY          40000000
 #define ST7789_SPI_MODE                     SPI_MODE3
 #define ST7789_DMACHANNEL                   2
+#define ST7789_ASYNC_BUFFER_SIZE            4092   // size of each DMA bounce buffer (max size of a single SPI DMA transfer)
 
 
 
@@ -130,15 +135,24 @@ inline uint16_t RGBA8888toNative(RGBA8888 const & rgba8888)
 ST7789Controller::ST7789Controller(int controllerWidth, int controllerHeight)
   : m_spi(nullptr),
     m_SPIDevHandle(nullptr),
+    m_asyncBuffer { nullptr, nullptr },
+    m_asyncBufferIndex(0),
+    m_asyncPending(0),
+    m_asyncWriteOpen(false),
     m_viewPort(nullptr),
     m_viewPortVisible(nullptr),
+    m_contiguousViewPort(false),
+    m_viewPortContiguous(false),
     m_controllerWidth(controllerWidth),
     m_controllerHeight(controllerHeight),
     m_rotOffsetX(0),
     m_rotOffsetY(0),
     m_updateTaskHandle(nullptr),
     m_updateTaskRunning(false),
-    m_orientation(ST7789Orientation::Normal)
+    m_orientation(ST7789Orientation::Normal),
+    m_tileDamageTracking(false),
+    m_tileHashesInvalid(true),
+    m_tileHashes(nullptr)
 {
 }
 
@@ -212,8 +226,10 @@ void ST7789Controller::begin(int SCK, int MOSI, int DC, int RESX, int CS, int ho
 
 void ST7789Controller::end()
 {
-  if (m_updateTaskHandle)
+  if (m_updateTaskHandle) {
+    suspendBackgroundPrimitiveExecution();  // also waits for asynchronous transfers
     vTaskDelete(m_updateTaskHandle);
+  }
   m_updateTaskHandle = nullptr;
 
   freeViewPort();
@@ -259,8 +275,7 @@ void ST7789Controller::setScreenCol(int value)
 {
   if (value != m_screenCol) {
     m_screenCol = iclamp(value, 0, m_viewPortWidth - m_screenWidth);
-    Primitive p(PrimitiveCmd::Refresh, Rect(0, 0, m_viewPortWidth - 1, m_viewPortHeight - 1));
-    addPrimitive(p);
+    sendRefresh();
   }
 }
 
@@ -269,8 +284,7 @@ void ST7789Controller::setScreenRow(int value)
 {
   if (value != m_screenRow) {
     m_screenRow = iclamp(value, 0, m_viewPortHeight - m_screenHeight);
-    Primitive p(PrimitiveCmd::Refresh, Rect(0, 0, m_viewPortWidth - 1, m_viewPortHeight - 1));
-    addPrimitive(p);
+    sendRefresh();
   }
 }
 
@@ -317,8 +331,17 @@ void ST7789Controller::SPIBegin()
     devconf.clock_speed_hz = ST7789_SPI_WRITE_FREQUENCY;
     devconf.spics_io_num   = -1;
     devconf.flags          = 0;
-    devconf.queue_size     = 1;
-    spi_bus_add_device(m_SPIHost, &devconf, &m_SPIDevHandle);
+    devconf.queue_size     = 2;
+    if (spi_bus_add_device(m_SPIHost, &devconf, &m_SPIDevHandle) == ESP_OK) {
+      for (int i = 0; i < 2; ++i)
+        m_asyncBuffer[i] = (uint8_t*) heap_caps_malloc(ST7789_ASYNC_BUFFER_SIZE, MALLOC_CAP_DMA);
+      if (!m_asyncBuffer[0] || !m_asyncBuffer[1]) {
+        // not enough memory, use synchronous transfers
+        heap_caps_free(m_asyncBuffer[0]);
+        heap_caps_free(m_asyncBuffer[1]);
+        m_asyncBuffer[0] = m_asyncBuffer[1] = nullptr;
+      }
+    }
   }
 
   if (m_updateTaskFuncSuspended)
@@ -333,16 +356,25 @@ void ST7789Controller::SPIEnd()
 
   suspendBackgroundPrimitiveExecution();
 
+  SPIEndAsyncWrite();
+
   if (m_SPIDevHandle) {
     spi_bus_remove_device(m_SPIDevHandle);
     m_SPIDevHandle = nullptr;
     spi_bus_free(m_SPIHost);  // this will not free bus if there is a device still connected (ie sdcard)
   }
+
+  heap_caps_free(m_asyncBuffer[0]);
+  heap_caps_free(m_asyncBuffer[1]);
+  m_asyncBuffer[0] = m_asyncBuffer[1] = nullptr;
 }
 
 
 void ST7789Controller::SPIBeginWrite()
 {
+  // previous write may still have asynchronous transfers in progress
+  SPIEndAsyncWrite();
+
   if (m_spi) {
     m_spi->beginTransaction(SPISettings(ST7789_SPI_WRITE_FREQUENCY, SPI_MSBFIRST, ST7789_SPI_MODE));
   }
@@ -432,6 +464,44 @@ void ST7789Controller::SPIWriteBuffer(void * data, size_t size)
 }
 
 
+// sends "size" bytes of the next bounce buffer (m_asyncBufferIndex) without waiting for completion
+// m_asyncPending must be less than 2
+void ST7789Controller::SPIWriteBufferAsync(size_t size)
+{
+  spi_transaction_t * ta = &m_asyncTransaction[m_asyncBufferIndex];
+  ta->flags     = 0;
+  ta->length    = 8 * size;
+  ta->rxlength  = 0;
+  ta->tx_buffer = m_asyncBuffer[m_asyncBufferIndex];
+  ta->rx_buffer = nullptr;
+  spi_device_queue_trans(m_SPIDevHandle, ta, portMAX_DELAY);
+  ++m_asyncPending;
+  m_asyncBufferIndex ^= 1;
+}
+
+
+// waits until there are no more than maxPending queued transactions
+void ST7789Controller::SPIWaitAsync(int maxPending)
+{
+  while (m_asyncPending > maxPending) {
+    spi_transaction_t * ta;
+    spi_device_get_trans_result(m_SPIDevHandle, &ta, portMAX_DELAY);
+    --m_asyncPending;
+  }
+}
+
+
+// waits for asynchronous transfers and completes the write started by sendScreenBuffer()
+void ST7789Controller::SPIEndAsyncWrite()
+{
+  SPIWaitAsync(0);
+  if (m_asyncWriteOpen) {
+    m_asyncWriteOpen = false;
+    SPIEndWrite();
+  }
+}
+
+
 void ST7789Controller::writeCommand(uint8_t cmd)
 {
   gpio_set_level(m_DC, 0);  // 0 = CMD
@@ -629,8 +699,19 @@ void ST7789Controller::setOrientation(ST7789Orientation value)
 }
 
 
+void ST7789Controller::enableTileDamageTracking(bool value)
+{
+  m_tileHashesInvalid = true;
+  if (value && m_viewPort)
+    allocTileHashes();
+  m_tileDamageTracking = value;
+}
+
+
+// display content is unknown, resend everything
 void ST7789Controller::sendRefresh()
 {
+  m_tileHashesInvalid = true;
   Primitive p(PrimitiveCmd::Refresh, Rect(0, 0, m_viewPortWidth - 1, m_viewPortHeight - 1));
   addPrimitive(p);
 }
@@ -638,65 +719,227 @@ void ST7789Controller::sendRefresh()
 
 void ST7789Controller::sendScreenBuffer(Rect updateRect)
 {
-  SPIBeginWrite();
-
   updateRect = updateRect.intersection(Rect(0, 0, m_viewPortWidth - 1, m_viewPortHeight - 1));
+  if (updateRect.X1 > updateRect.X2 || updateRect.Y1 > updateRect.Y2)
+    return;
+
+  SPIBeginWrite();
 
   // select the buffer to send
   auto viewPort = isDoubleBuffered() ? m_viewPortVisible : m_viewPort;
 
+  if (m_tileDamageTracking && m_tileHashes) {
+
+    if (m_tileHashesInvalid) {
+      m_tileHashesInvalid = false;
+      memset(m_tileHashes, 0, m_tileColumns * m_tileRows * sizeof(uint32_t));
+    }
+
+    // send changed tiles, merging horizontally adjacent ones
+    const int tileX1 = updateRect.X1 / ST7789_TILE_SIZE;
+    const int tileX2 = updateRect.X2 / ST7789_TILE_SIZE;
+    for (int tileY = updateRect.Y1 / ST7789_TILE_SIZE; tileY <= updateRect.Y2 / ST7789_TILE_SIZE; ++tileY) {
+      const int y1 = tileY * ST7789_TILE_SIZE;
+      const int y2 = imin(y1 + ST7789_TILE_SIZE, m_viewPortHeight) - 1;
+      uint32_t * hashes = m_tileHashes + tileY * m_tileColumns;
+      int runX1 = -1;  // first pixel of the changed tiles run (-1 = no run)
+      for (int tileX = tileX1; tileX <= tileX2; ++tileX) {
+        const int x1 = tileX * ST7789_TILE_SIZE;
+        const int x2 = imin(x1 + ST7789_TILE_SIZE, m_viewPortWidth) - 1;
+        const uint32_t hash = tileHash(viewPort, x1, y1, x2, y2);
+        if (hash != hashes[tileX]) {
+          hashes[tileX] = hash;
+          if (runX1 < 0)
+            runX1 = x1;
+        } else if (runX1 >= 0) {
+          sendScreenRect(viewPort, Rect(runX1, y1, x1 - 1, y2));
+          runX1 = -1;
+        }
+      }
+      if (runX1 >= 0)
+        sendScreenRect(viewPort, Rect(runX1, y1, imin((tileX2 + 1) * ST7789_TILE_SIZE, m_viewPortWidth) - 1, y2));
+    }
+
+  } else
+    sendScreenRect(viewPort, updateRect);
+
+  // when transfers are still in progress SPIEndWrite() is called by SPIEndAsyncWrite()
+  if (m_asyncPending > 0)
+    m_asyncWriteOpen = true;
+  else
+    SPIEndWrite();
+}
+
+
+// rect must be inside the viewport
+void ST7789Controller::sendScreenRect(uint16_t * * viewPort, Rect const & rect)
+{
+  // commands cannot be sent while queued transfers are in progress
+  SPIWaitAsync(0);
+
   // Column Address Set
   writeCommand(ST7789_CASET);
-  writeWord(m_rotOffsetX + updateRect.X1);   // XS (X Start)
-  writeWord(m_rotOffsetX + updateRect.X2);   // XE (X End)
+  writeWord(m_rotOffsetX + rect.X1);   // XS (X Start)
+  writeWord(m_rotOffsetX + rect.X2);   // XE (X End)
 
   // Row Address Set
   writeCommand(ST7789_RASET);
-  writeWord(m_rotOffsetY + updateRect.Y1);  // YS (Y Start)
-  writeWord(m_rotOffsetY + updateRect.Y2);  // YE (Y End)
+  writeWord(m_rotOffsetY + rect.Y1);  // YS (Y Start)
+  writeWord(m_rotOffsetY + rect.Y2);  // YE (Y End)
 
   writeCommand(ST7789_RAMWR);
-  const int width = updateRect.width();
-  for (int row = updateRect.Y1; row <= updateRect.Y2; ++row) {
-    writeData(viewPort[row] + updateRect.X1, sizeof(uint16_t) * width);
+  const int width   = rect.width();
+  const int rowSize = sizeof(uint16_t) * width;
+  if (m_asyncBuffer[0] && rowSize <= ST7789_ASYNC_BUFFER_SIZE) {
+    // copy as many rows as possible into a bounce buffer and send it asynchronously, while the other one is being filled
+    // (rows larger than a bounce buffer are sent synchronously)
+    gpio_set_level(m_DC, 1);  // 1 = DATA
+    const int rowsPerChunk = ST7789_ASYNC_BUFFER_SIZE / rowSize;
+    if (m_viewPortContiguous && width == m_viewPortWidth) {
+      // rows are one after another: copy whole chunks
+      uint8_t const * src = (uint8_t const *) viewPort[rect.Y1];
+      for (int remaining = rowSize * rect.height(); remaining > 0; ) {
+        SPIWaitAsync(1);
+        const int size = imin(rowsPerChunk * rowSize, remaining);
+        memcpy(m_asyncBuffer[m_asyncBufferIndex], src, size);
+        SPIWriteBufferAsync(size);
+        src       += size;
+        remaining -= size;
+      }
+      return;
+    }
+    for (int row = rect.Y1; row <= rect.Y2; ) {
+      SPIWaitAsync(1);  // wait for the buffer to fill to be transferred
+      uint8_t * dest = m_asyncBuffer[m_asyncBufferIndex];
+      const int rows = imin(rowsPerChunk, rect.Y2 - row + 1);
+      for (int i = 0; i < rows; ++i, ++row, dest += rowSize)
+        memcpy(dest, viewPort[row] + rect.X1, rowSize);
+      SPIWriteBufferAsync(rows * rowSize);
+    }
+  } else if (m_viewPortContiguous && width == m_viewPortWidth) {
+    // rows are one after another: send whole chunks
+    uint8_t * src = (uint8_t*) viewPort[rect.Y1];
+    for (int remaining = rowSize * rect.height(); remaining > 0; ) {
+      const int size = imin(ST7789_ASYNC_BUFFER_SIZE, remaining);
+      writeData(src, size);
+      src       += size;
+      remaining -= size;
+    }
+  } else {
+    for (int row = rect.Y1; row <= rect.Y2; ++row) {
+      writeData(viewPort[row] + rect.X1, rowSize);
+    }
   }
+}
 
-  SPIEndWrite();
+
+// FNV-1a hash of the pixels inside the specified rectangle, never returns 0
+uint32_t ST7789Controller::tileHash(uint16_t * * viewPort, int x1, int y1, int x2, int y2)
+{
+  uint32_t hash = 2166136261u;
+  for (int y = y1; y <= y2; ++y) {
+    uint16_t const * row = viewPort[y];
+    for (int x = x1; x <= x2; ++x)
+      hash = (hash ^ row[x]) * 16777619u;
+  }
+  return hash | 1;
 }
 
 
-void ST7789Controller::allocViewPort()
+// hashes are never deallocated while the viewport exists, because the update task may be using them
+void ST7789Controller::allocTileHashes()
 {
-  m_viewPort = (uint16_t**) heap_caps_malloc(m_viewPortHeight * sizeof(uint16_t*), MALLOC_CAP_32BIT);
-  for (int i = 0; i < m_viewPortHeight; ++i) {
-    m_viewPort[i] = (uint16_t*) heap_caps_malloc(m_viewPortWidth * sizeof(uint16_t), MALLOC_CAP_DMA);
-    memset(m_viewPort[i], 0, m_viewPortWidth * sizeof(uint16_t));
+  if (m_tileHashes == nullptr) {
+    m_tileColumns = (m_viewPortWidth + ST7789_TILE_SIZE - 1) / ST7789_TILE_SIZE;
+    m_tileRows    = (m_viewPortHeight + ST7789_TILE_SIZE - 1) / ST7789_TILE_SIZE;
+    uint32_t * hashes = (uint32_t*) heap_caps_malloc(m_tileColumns * m_tileRows * sizeof(uint32_t), MALLOC_CAP_32BIT);
+    memset(hashes, 0, m_tileColumns * m_tileRows * sizeof(uint32_t));
+    m_tileHashes = hashes;
   }
+}
 
-  if (isDoubleBuffered()) {
-    m_viewPortVisible = (uint16_t**) heap_caps_malloc(m_viewPortHeight * sizeof(uint16_t*), MALLOC_CAP_32BIT);
+
+// allocates rows table and rows (a single block when "contiguous" is true), all cleared
+// returns nullptr on fail
+uint16_t * * ST7789Controller::allocViewPortRows(bool contiguous)
+{
+  const int rowSize = m_viewPortWidth * sizeof(uint16_t);
+  uint16_t * * rows = (uint16_t**) heap_caps_malloc(m_viewPortHeight * sizeof(uint16_t*), MALLOC_CAP_32BIT);
+  if (rows == nullptr)
+    return nullptr;
+  if (contiguous) {
+    uint16_t * block = (uint16_t*) heap_caps_malloc(rowSize * m_viewPortHeight, MALLOC_CAP_DMA);
+    if (block == nullptr) {
+      heap_caps_free(rows);
+      return nullptr;
+    }
+    memset(block, 0, rowSize * m_viewPortHeight);
+    for (int i = 0; i < m_viewPortHeight; ++i)
+      rows[i] = block + i * m_viewPortWidth;
+  } else {
     for (int i = 0; i < m_viewPortHeight; ++i) {
-      m_viewPortVisible[i] = (uint16_t*) heap_caps_malloc(m_viewPortWidth * sizeof(uint16_t), MALLOC_CAP_DMA);
-      memset(m_viewPortVisible[i], 0, m_viewPortWidth * sizeof(uint16_t));
+      rows[i] = (uint16_t*) heap_caps_malloc(rowSize, MALLOC_CAP_DMA);
+      memset(rows[i], 0, rowSize);
+    }
+  }
+  return rows;
+}
+
+
+void ST7789Controller::freeViewPortRows(uint16_t * * rows)
+{
+  if (m_viewPortContiguous)
+    heap_caps_free(rows[0]);
+  else {
+    for (int i = 0; i < m_viewPortHeight; ++i)
+      heap_caps_free(rows[i]);
+  }
+  heap_caps_free(rows);
+}
+
+
+void ST7789Controller::allocViewPort()
+{
+  m_viewPortContiguous = m_contiguousViewPort;
+
+  if (m_viewPortContiguous) {
+    m_viewPort = allocViewPortRows(true);
+    if (m_viewPort && isDoubleBuffered()) {
+      m_viewPortVisible = allocViewPortRows(true);
+      if (m_viewPortVisible == nullptr) {
+        freeViewPortRows(m_viewPort);
+        m_viewPort = nullptr;
+      }
     }
+    // not enough memory for a single block, fallback to rows allocation
+    if (m_viewPort == nullptr)
+      m_viewPortContiguous = false;
   }
+
+  if (!m_viewPortContiguous) {
+    m_viewPort = allocViewPortRows(false);
+    if (isDoubleBuffered())
+      m_viewPortVisible = allocViewPortRows(false);
+  }
+
+  m_tileHashesInvalid = true;
+  if (m_tileDamageTracking)
+    allocTileHashes();
 }
 
 
 void ST7789Controller::freeViewPort()
 {
   if (m_viewPort) {
-    for (int i = 0; i < m_viewPortHeight; ++i)
-      heap_caps_free(m_viewPort[i]);
-    heap_caps_free(m_viewPort);
+    freeViewPortRows(m_viewPort);
     m_viewPort = nullptr;
   }
   if (m_viewPortVisible) {
-    for (int i = 0; i < m_viewPortHeight; ++i)
-      heap_caps_free(m_viewPortVisible[i]);
-    heap_caps_free(m_viewPortVisible);
+    freeViewPortRows(m_viewPortVisible);
     m_viewPortVisible = nullptr;
   }
+  heap_caps_free(m_tileHashes);
+  m_tileHashes = nullptr;
 }
 
 
@@ -706,15 +949,21 @@ void ST7789Controller::updateTaskFunc(void * pvParameters)
 
   while (true) {
 
+    // nothing to execute: complete the last transfer before blocking, otherwise suspendBackgroundPrimitiveExecution() would wait for it forever
+    if (ctrl->execQueueCount() == 0)
+      ctrl->SPIEndAsyncWrite();
+
     ctrl->waitForPrimitives();
 
     // primitive processing blocked?
-    if (ctrl->m_updateTaskFuncSuspended > 0)
+    if (ctrl->m_updateTaskFuncSuspended > 0) {
+      ctrl->SPIEndAsyncWrite();              // don't keep the bus while blocked
       ulTaskNotifyTake(true, portMAX_DELAY); // yes, wait for a notify
+    }
 
     ctrl->m_updateTaskRunning = true;
 
-    Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+    DirtyRegion dirtyRegion(ST7789_DIRTYREGION_MERGECOST);
 
     int64_t startTime = ctrl->backgroundPrimitiveTimeoutEnabled() ? esp_timer_get_time() : 0;
     do {
@@ -723,18 +972,23 @@ void ST7789Controller::updateTaskFunc(void * pvParameters)
       if (ctrl->getPrimitive(&prim, ST7789_BACKGROUND_PRIMITIVE_TIMEOUT / 1000) == false)
         break;
 
-      ctrl->execPrimitive(prim, updateRect);
+      ctrl->execPrimitive(prim, dirtyRegion);
 
       if (ctrl->m_updateTaskFuncSuspended > 0)
         break;
 
     } while (!ctrl->backgroundPrimitiveTimeoutEnabled() || (startTime + ST7789_BACKGROUND_PRIMITIVE_TIMEOUT > esp_timer_get_time()));
 
-    ctrl->showSprites(updateRect);
+    ctrl->showSprites(dirtyRegion);
 
-    ctrl->m_updateTaskRunning = false;
+    // last transfer runs while next primitives are executed. Nothing to send, release the bus.
+    for (int i = 0; i < dirtyRegion.count(); ++i)
+      ctrl->sendScreenBuffer(dirtyRegion[i]);
+    if (dirtyRegion.count() == 0)
+      ctrl->SPIEndAsyncWrite();
 
-    ctrl->sendScreenBuffer(updateRect);
+    // cleared after sendScreenBuffer() has set m_asyncWriteOpen, so suspendBackgroundPrimitiveExecution() cannot miss the open write
+    ctrl->m_updateTaskRunning = false;
   }
 }
 
@@ -743,7 +997,7 @@ void ST7789Controller::updateTaskFunc(void * pvParameters)
 void ST7789Controller::suspendBackgroundPrimitiveExecution()
 {
   ++m_updateTaskFuncSuspended;
-  while (m_updateTaskRunning)
+  while (m_updateTaskRunning || m_asyncWriteOpen)
     taskYIELD();
 }
 
@@ -827,13 +1081,57 @@ void ST7789Controller::clear(Rect & updateRect)
 {
   hideSprites(updateRect);
   auto pattern = preparePixel(getActualBrushColor());
-  for (int y = 0; y < m_viewPortHeight; ++y)
-    rawFillRow(y, 0, m_viewPortWidth - 1, pattern);
+  if (m_viewPortContiguous)
+    fillContiguousRows(0, m_viewPortHeight, pattern);
+  else {
+    for (int y = 0; y < m_viewPortHeight; ++y)
+      rawFillRow(y, 0, m_viewPortWidth - 1, pattern);
+  }
+}
+
+
+// fills "count" full rows starting from "y", viewport must be contiguous
+void ST7789Controller::fillContiguousRows(int y, int count, uint16_t pattern)
+{
+  uint16_t * dest = m_viewPort[y];
+  const int size = m_viewPortWidth * count;
+  if ((pattern >> 8) == (pattern & 0xff))
+    memset(dest, pattern & 0xff, size * sizeof(uint16_t));
+  else {
+    for (int i = 0; i < size; ++i)
+      dest[i] = pattern;
+  }
+}
+
+
+// scroll moving rows (all rows at once when scrolling region is full width)
+void ST7789Controller::contiguousVScroll(int scroll, Rect & updateRect)
+{
+  Rect const & region = paintState().scrollingRegion;
+  if (region.X1 == 0 && region.X2 == m_viewPortWidth - 1 && scroll != 0 && abs(scroll) < region.height()) {
+    hideSprites(updateRect);
+    const int rows = region.height() - abs(scroll);
+    const int srcY = scroll < 0 ? region.Y1 - scroll : region.Y1;
+    const int dstY = scroll < 0 ? region.Y1 : region.Y1 + scroll;
+    memmove(m_viewPort[dstY], m_viewPort[srcY], rows * m_viewPortWidth * sizeof(uint16_t));
+    // fill exposed area with brush color
+    fillContiguousRows(scroll < 0 ? region.Y2 + scroll + 1 : region.Y1, abs(scroll), preparePixel(getActualBrushColor()));
+  } else {
+    genericVScroll(scroll, updateRect,
+                   [&] (int x1, int x2, int srcY, int dstY)    { memmove(m_viewPort[dstY] + x1, m_viewPort[srcY] + x1, (x2 - x1 + 1) * sizeof(uint16_t)); }, // rawCopyRow
+                   [&] (int y, int x1, int x2, RGB888 pattern) { rawFillRow(y, x1, x2, pattern); }                                                                  // rawFillRow
+                  );
+  }
 }
 
 
 void ST7789Controller::VScroll(int scroll, Rect & updateRect)
 {
+  if (m_viewPortContiguous) {
+    contiguousVScroll(scroll, updateRect);
+    return;
+  }
+
   genericVScroll(scroll, updateRect,
                  [&] (int yA, int yB, int x1, int x2)        { swapRows(yA, yB, x1, x2); },              // swapRowsCopying
                  [&] (int yA, int yB)                        { tswap(m_viewPort[yA], m_viewPort[yB]); }, // swapRowsPointers
@@ -944,6 +1242,23 @@ void ST7789Controller::rawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const
 }
 
 
+bool ST7789Controller::rawColorToNative(RGB888 const & color, void * dest)
+{
+  *(uint16_t*)dest = preparePixel(color);
+  return true;
+}
+
+
+void ST7789Controller::rawDrawBitmap_Runs(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  genericRawDrawBitmap_Runs(destX, destY, bitmap, (uint16_t*)saveBackground, X1, Y1, XCount, YCount,
+                            [&] (int y)                                                { return m_viewPort[y]; },                          // rawGetRow
+                            [&] (uint16_t * row, int x, uint16_t * dest, int count)      { memcpy(dest, row + x, count * sizeof(uint16_t)); }, // rawCopyFromRow
+                            [&] (uint16_t * row, int x, uint16_t const * src, int count) { memcpy(row + x, src, count * sizeof(uint16_t)); }   // rawCopyToRow
+                           );
+}
+
+
 void ST7789Controller::swapBuffers()
 {
   tswap(m_viewPort, m_viewPortVisible);
@@ -244,6 +244,40 @@ public:
    */
   void setOrientation(ST7789Orientation value);
 
+  /**
+   * @brief Enables or disables tile damage tracking
+   *
+   * When enabled the viewport is divided into tiles of 16x16 pixels and an hash of each tile content is kept.
+   * Updated tiles are sent to the display only when their hash has changed since the last time they have been sent,
+   * so repainting identical pixels (ie redrawing a window border) doesn't consume SPI bandwidth.<br>
+   * Tracking requires four bytes for each tile and some CPU time to calculate the hashes.<br>
+   * Damage tracking is disabled by default.
+   *
+   * @param value True enables tile damage tracking.
+   */
+  void enableTileDamageTracking(bool value);
+
+  /**
+   * @brief Allocates the viewport as a single memory block
+   *
+   * By default each viewport row is allocated separately and vertical scrolling swaps rows pointers.
+   * When contiguous viewport is enabled all rows (of each buffer, when double buffered) are allocated in a single block and
+   * rows are never swapped, so clear, full width vertical scrolling and sending full width rectangles operate on the whole block.
+   * Scrolling copies memory instead of swapping pointers.<br>
+   * When the single block cannot be allocated the viewport is allocated row by row.<br>
+   * Takes effect at next setResolution() call.
+   *
+   * @param value True to allocate the viewport as a single block.
+   */
+  void enableContiguousViewPort(bool value) { m_contiguousViewPort = value; }
+
+  /**
+   * @brief Determines whether the viewport is allocated as a single memory block
+   *
+   * @return True if viewport rows are stored one after another.
+   */
+  bool isViewPortContiguous()               { return m_viewPortContiguous; }
+
 
 private:
 
@@ -260,6 +294,7 @@ private:
   void sendRefresh();
 
   void sendScreenBuffer(Rect updateRect);
+  void sendScreenRect(uint16_t * * viewPort, Rect const & rect);
   void writeCommand(uint8_t cmd);
   void writeByte(uint8_t data);
   void writeWord(uint16_t data);
@@ -273,9 +308,17 @@ private:
   void SPIWriteByte(uint8_t data);
   void SPIWriteWord(uint16_t data);
   void SPIWriteBuffer(void * data, size_t size);
+  void SPIWriteBufferAsync(size_t size);
+  void SPIWaitAsync(int maxPending);
+  void SPIEndAsyncWrite();
 
   void allocViewPort();
   void freeViewPort();
+  uint16_t * * allocViewPortRows(bool contiguous);
+  void freeViewPortRows(uint16_t * * rows);
+
+  void allocTileHashes();
+  uint32_t tileHash(uint16_t * * viewPort, int x1, int y1, int x2, int y2);
 
   static void updateTaskFunc(void * pvParameters);
 
@@ -289,6 +332,7 @@ private:
   void drawEllipse(Size const & size, Rect & updateRect);
 
   void VScroll(int scroll, Rect & updateRect);
+  void contiguousVScroll(int scroll, Rect & updateRect);
 
   void HScroll(int scroll, Rect & updateRect);
 
@@ -315,6 +359,8 @@ private:
 
   void rawFillRow(int y, int x1, int x2, uint16_t pattern);
 
+  void fillContiguousRows(int y, int count, uint16_t pattern);
+
   void swapRows(int yA, int yB, int x1, int x2);
 
   void rawInvertRow(int y, int x1, int x2);
@@ -331,6 +377,12 @@ private:
   // abstract method of DisplayController
   void rawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
 
+  // overridable method of DisplayController
+  bool rawColorToNative(RGB888 const & color, void * dest);
+
+  // overridable method of DisplayController
+  void rawDrawBitmap_Runs(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+
 
   SPIClass *         m_spi;
 
@@ -343,6 +395,14 @@ private:
 
   spi_device_handle_t m_SPIDevHandle;
 
+  // asynchronous (DMA) transfers, available only using SDK driver. Rows to send are copied into one of the two
+  // bounce buffers, so primitives can draw on the viewport while the other buffer is being transferred.
+  uint8_t *           m_asyncBuffer[2];
+  spi_transaction_t   m_asyncTransaction[2];
+  int8_t              m_asyncBufferIndex;  // next buffer to fill
+  int8_t              m_asyncPending;      // number of queued and not completed transactions
+  volatile bool       m_asyncWriteOpen;    // SPIEndWrite() deferred until queued transactions are completed
+
   // when double buffer is enabled the "drawing" view port is always m_viewPort, while the "visible" view port is always m_viewPortVisible
   // when double buffer is not enabled then m_viewPort = m_viewPortVisible
   uint16_t * *       m_viewPort;
@@ -356,6 +416,9 @@ private:
   int16_t            m_viewPortWidth;
   int16_t            m_viewPortHeight;
 
+  bool               m_contiguousViewPort;  // contiguous viewport requested
+  bool               m_viewPortContiguous;  // rows of m_viewPort (and m_viewPortVisible) are allocated in a single block
+
   // maximum width and height the controller can handle (240x320 on ST7789)
   int16_t            m_controllerWidth;
   int16_t            m_controllerHeight;
@@ -371,6 +434,13 @@ private:
 
   ST7789Orientation  m_orientation;
 
+  // tile damage tracking
+  bool               m_tileDamageTracking;
+  volatile bool      m_tileHashesInvalid;  // set when the display content is unknown (ie orientation changed)
+  uint32_t *         m_tileHashes;         // hash of each tile as sent to the display (0 = unknown)
+  int16_t            m_tileColumns;
+  int16_t            m_tileRows;
+
 };
 
 
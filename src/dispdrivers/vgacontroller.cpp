@@ -60,7 +60,16 @@ namespace fabgl {
 VGAController * VGAController::s_instance = nullptr;
 
 
+// converts four glyph pixels (a nibble, leftmost pixel at bit 3) to a 32 bit word mask, ordered as VGA_PIXELINROW
+static const uint32_t s_glyphNibbleMask[16] = {
+  0x00000000, 0x0000ff00, 0x000000ff, 0x0000ffff, 0xff000000, 0xff00ff00, 0xff0000ff, 0xff00ffff,
+  0x00ff0000, 0x00ffff00, 0x00ff00ff, 0x00ffffff, 0xffff0000, 0xffffff00, 0xffff00ff, 0xffffffff,
+};
+
+
 VGAController::VGAController()
+  : m_contiguousViewPort(false),
+    m_viewPortContiguous(false)
 {
   s_instance = this;
 }
@@ -252,8 +261,12 @@ void VGAController::setResolution(char const * modeline, int viewPortWidth, int
 
 // this method may adjust m_viewPortHeight to the actual number of allocated rows.
 // to reduce memory allocation overhead try to allocate the minimum number of blocks.
-void VGAController::allocateViewPort()
+// contiguous viewport is allocated in just one block.
+// rowlen is the size in bytes of a viewport row
+void VGAController::allocateViewPort(uint32_t allocCaps, int rowlen)
 {
+  m_viewPortContiguous = m_contiguousViewPort;
+  const int maxPoolsCount = m_viewPortContiguous ? 1 : FABGLIB_VIEWPORT_MEMORY_POOL_COUNT;
   int linesCount[FABGLIB_VIEWPORT_MEMORY_POOL_COUNT]; // where store number of lines for each pool
   int poolsCount = 0; // number of allocated pools
   int remainingLines = m_viewPortHeight;
@@ -263,12 +276,12 @@ void VGAController::allocateViewPort()
     remainingLines *= 2;
 
   // allocate pools
-  while (remainingLines > 0 && poolsCount < FABGLIB_VIEWPORT_MEMORY_POOL_COUNT) {
-    int largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_DMA);
-    linesCount[poolsCount] = tmin(remainingLines, largestBlock / m_viewPortWidth);
+  while (remainingLines > 0 && poolsCount < maxPoolsCount) {
+    int largestBlock = heap_caps_get_largest_free_block(allocCaps);
+    linesCount[poolsCount] = tmin(remainingLines, largestBlock / rowlen);
     if (linesCount[poolsCount] == 0)  // no more memory available for lines
       break;
-    m_viewPortMemoryPool[poolsCount] = (uint8_t*) heap_caps_malloc(linesCount[poolsCount] * m_viewPortWidth, MALLOC_CAP_DMA);
+    m_viewPortMemoryPool[poolsCount] = (uint8_t*) heap_caps_malloc(linesCount[poolsCount] * rowlen, allocCaps);
     remainingLines -= linesCount[poolsCount];
     m_viewPortHeight += linesCount[poolsCount];
     ++poolsCount;
@@ -288,13 +301,23 @@ void VGAController::allocateViewPort()
         m_viewPort[l + i] = pool;
       else
         m_viewPortVisible[l + i - m_viewPortHeight] = pool; // set only when double buffered is enabled
-      pool += m_viewPortWidth;
+      pool += rowlen;
     }
     l += linesCount[p];
   }
 }
 
 
+void VGAController::allocateViewPort()
+{
+  allocateViewPort(MALLOC_CAP_DMA, m_viewPortWidth);
+
+  // fill view port
+  for (int i = 0; i < m_viewPortHeight; ++i)
+    fill(m_viewPort[i], 0, m_viewPortWidth, 0, 0, 0, false, false);
+}
+
+
 void VGAController::freeViewPort()
 {
   for (uint8_t * * poolPtr = m_viewPortMemoryPool; *poolPtr; ++poolPtr) {
@@ -349,10 +372,6 @@ void VGAController::setResolution(VGATimings const& timings, int viewPortWidth,
   fillVertBuffers(0);
   fillHorizBuffers(0);
 
-  // fill view port
-  for (int i = 0; i < m_viewPortHeight; ++i)
-    fill(m_viewPort[i], 0, m_viewPortWidth, 0, 0, 0, false, false);
-
   m_DMABuffersHead->qe.stqe_next = (lldesc_t*) &m_DMABuffersVisible[0];
 
   resetPaintState();
@@ -753,11 +772,10 @@ void IRAM_ATTR VGAController::rawFillRow(int y, int x1, int x2, uint8_t pattern)
     VGA_PIXELINROW(row, x) = pattern;
   }
   // fill whole 32 bits words (don't care about VGA_PIXELINROW adjusted alignment)
-  if (x <= x2) {
-    int sz = (x2 & ~3) - x;
-    memset((void*)(row + x), pattern, sz);
-    x += sz;
-  }
+  const uint32_t pattern32 = pattern * 0x01010101;
+  volatile uint32_t * w = (volatile uint32_t *)(row + x);
+  for (const int right = (x2 + 1) & ~3; x < right; x += 4)
+    *w++ = pattern32;
   // fill last unaligned bytes
   for (; x <= x2; ++x) {
     VGA_PIXELINROW(row, x) = pattern;
@@ -770,13 +788,62 @@ void IRAM_ATTR VGAController::rawInvertRow(int y, int x1, int x2)
 {
   auto row = m_viewPort[y];
   const uint8_t HVSync = packHVSync();
-  for (int x = x1; x <= x2; ++x) {
+  // invert first bytes before full 32 bits word
+  int x = x1;
+  for (; x <= x2 && (x & 3) != 0; ++x) {
+    uint8_t * px = (uint8_t*) &VGA_PIXELINROW(row, x);
+    *px = HVSync | ~(*px);
+  }
+  // invert whole 32 bits words (don't care about VGA_PIXELINROW adjusted alignment)
+  const uint32_t HVSync32 = HVSync * 0x01010101;
+  volatile uint32_t * w = (volatile uint32_t *)(row + x);
+  for (const int right = (x2 + 1) & ~3; x < right; x += 4, ++w)
+    *w = HVSync32 | ~(*w);
+  // invert last unaligned bytes
+  for (; x <= x2; ++x) {
     uint8_t * px = (uint8_t*) &VGA_PIXELINROW(row, x);
     *px = HVSync | ~(*px);
   }
 }
 
 
+// swaps pen and brush patterns inside the range x1...x2 of y
+// parameters not checked
+void IRAM_ATTR VGAController::rawSwapFGBGRow(int y, int x1, int x2, uint8_t penPattern, uint8_t brushPattern)
+{
+  uint8_t * row = (uint8_t*) m_viewPort[y];
+  // swap first bytes before full 32 bits word
+  int x = x1;
+  for (; x <= x2 && (x & 3) != 0; ++x) {
+    uint8_t px = VGA_PIXELINROW(row, x);
+    if (px == penPattern)
+      VGA_PIXELINROW(row, x) = brushPattern;
+    else if (px == brushPattern)
+      VGA_PIXELINROW(row, x) = penPattern;
+  }
+  // swap whole 32 bits words (don't care about VGA_PIXELINROW adjusted alignment)
+  const uint32_t pen32   = penPattern * 0x01010101;
+  const uint32_t brush32 = brushPattern * 0x01010101;
+  uint32_t * w = (uint32_t*)(row + x);
+  for (const int right = (x2 + 1) & ~3; x < right; x += 4, ++w) {
+    const uint32_t px = *w;
+    // 0xff in each byte equal to pen (penMask) or equal to brush (brushMask)
+    const uint32_t penMask   = VGA_EQUALBYTESMASK(px ^ pen32);
+    const uint32_t brushMask = VGA_EQUALBYTESMASK(px ^ brush32) & ~penMask;
+    if (penMask | brushMask)
+      *w = (px & ~(penMask | brushMask)) | (brush32 & penMask) | (pen32 & brushMask);
+  }
+  // swap last unaligned bytes
+  for (; x <= x2; ++x) {
+    uint8_t px = VGA_PIXELINROW(row, x);
+    if (px == penPattern)
+      VGA_PIXELINROW(row, x) = brushPattern;
+    else if (px == brushPattern)
+      VGA_PIXELINROW(row, x) = penPattern;
+  }
+}
+
+
 // swaps all pixels inside the range x1...x2 of yA and yB
 // parameters not checked
 void IRAM_ATTR VGAController::swapRows(int yA, int yB, int x1, int x2)
@@ -790,14 +857,36 @@ void IRAM_ATTR VGAController::swapRows(int yA, int yB, int x1, int x2)
   // swap whole 32 bits words (don't care about VGA_PIXELINROW adjusted alignment)
   uint32_t * a = (uint32_t*)(rowA + x);
   uint32_t * b = (uint32_t*)(rowB + x);
-  for (int right = (x2 & ~3); x < right; x += 4)
+  for (const int right = (x2 + 1) & ~3; x < right; x += 4)
     tswap(*a++, *b++);
   // swap last unaligned bytes
-  for (x = (x2 & ~3); x <= x2; ++x)
+  for (; x <= x2; ++x)
     tswap(VGA_PIXELINROW(rowA, x), VGA_PIXELINROW(rowB, x));
 }
 
 
+// copies all pixels inside the range x1...x2 of srcY to dstY
+// parameters not checked
+void IRAM_ATTR VGAController::copyRow(int x1, int x2, int srcY, int dstY)
+{
+  uint8_t * src = (uint8_t*) m_viewPort[srcY];
+  uint8_t * dst = (uint8_t*) m_viewPort[dstY];
+  // copy first bytes before full 32 bits word
+  int x = x1;
+  for (; x <= x2 && (x & 3) != 0; ++x)
+    VGA_PIXELINROW(dst, x) = VGA_PIXELINROW(src, x);
+  // copy whole 32 bits words (don't care about VGA_PIXELINROW adjusted alignment)
+  int right = (x2 + 1) & ~3;
+  if (x < right) {
+    memcpy(dst + x, src + x, right - x);
+    x = right;
+  }
+  // copy last unaligned bytes
+  for (; x <= x2; ++x)
+    VGA_PIXELINROW(dst, x) = VGA_PIXELINROW(src, x);
+}
+
+
 void IRAM_ATTR VGAController::drawEllipse(Size const & size, Rect & updateRect)
 {
   genericDrawEllipse(size, updateRect,
@@ -811,8 +900,12 @@ void IRAM_ATTR VGAController::clear(Rect & updateRect)
 {
   hideSprites(updateRect);
   uint8_t pattern = preparePixel(getActualBrushColor());
-  for (int y = 0; y < m_viewPortHeight; ++y)
-    memset((uint8_t*) m_viewPort[y], pattern, m_viewPortWidth);
+  if (m_viewPortContiguous)
+    memset((uint8_t*) m_viewPort[0], pattern, m_viewPortWidth * m_viewPortHeight);
+  else {
+    for (int y = 0; y < m_viewPortHeight; ++y)
+      memset((uint8_t*) m_viewPort[y], pattern, m_viewPortWidth);
+  }
 }
 
 
@@ -821,6 +914,12 @@ void IRAM_ATTR VGAController::clear(Rect & updateRect)
 // Speciying horizontal scrolling region slow-down scrolling!
 void IRAM_ATTR VGAController::VScroll(int scroll, Rect & updateRect)
 {
+  if (m_viewPortContiguous) {
+    // rows are not swapped, so DMA buffers don't need to be reassigned
+    contiguousVScroll(scroll, updateRect);
+    return;
+  }
+
   genericVScroll(scroll, updateRect,
                  [&] (int yA, int yB, int x1, int x2)        { swapRows(yA, yB, x1, x2); },              // swapRowsCopying
                  [&] (int yA, int yB)                        { tswap(m_viewPort[yA], m_viewPort[yB]); }, // swapRowsPointers
@@ -859,6 +958,28 @@ void IRAM_ATTR VGAController::VScroll(int scroll, Rect & updateRect)
 }
 
 
+// scroll moving rows (all rows at once when scrolling region is full width)
+void IRAM_ATTR VGAController::contiguousVScroll(int scroll, Rect & updateRect)
+{
+  Rect const & region = paintState().scrollingRegion;
+  if (region.X1 == 0 && region.X2 == m_viewPortWidth - 1 && scroll != 0 && abs(scroll) < region.height()) {
+    hideSprites(updateRect);
+    const int rows = region.height() - abs(scroll);
+    const int srcY = scroll < 0 ? region.Y1 - scroll : region.Y1;
+    const int dstY = scroll < 0 ? region.Y1 : region.Y1 + scroll;
+    memmove((uint8_t*) m_viewPort[dstY], (uint8_t*) m_viewPort[srcY], rows * m_viewPortWidth);
+    // fill exposed area with brush color
+    const int fillY = scroll < 0 ? region.Y2 + scroll + 1 : region.Y1;
+    memset((uint8_t*) m_viewPort[fillY], preparePixel(getActualBrushColor()), abs(scroll) * m_viewPortWidth);
+  } else {
+    genericVScroll(scroll, updateRect,
+                   [&] (int x1, int x2, int srcY, int dstY)    { copyRow(x1, x2, srcY, dstY); },   // rawCopyRow
+                   [&] (int y, int x1, int x2, RGB888 pattern) { rawFillRow(y, x1, x2, pattern); } // rawFillRow
+                  );
+  }
+}
+
+
 // Scrolling by 1, 2, 3 and 4 pixels is optimized. Also scrolling multiples of 4 (8, 16, 24...) is optimized.
 // Scrolling by other values requires up to three steps (scopose scrolling by 1, 2, 3 or 4): for example scrolling by 5 is scomposed to 4 and 1, scrolling
 // by 6 is 4 + 2, etc.
@@ -1006,6 +1127,15 @@ void IRAM_ATTR VGAController::HScroll(int scroll, Rect & updateRect)
 
 void IRAM_ATTR VGAController::drawGlyph(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect)
 {
+  // glyphs with width multiple of 4 (ie 8 and 16), 32 bit aligned and not horizontally clipped are drawn four pixels at the time
+  const int glyphX = glyph.X + paintState().origin.X;
+  if (!glyphOptions.bold && !glyphOptions.italic && !glyphOptions.blank && !glyphOptions.underline && !glyphOptions.doubleWidth &&
+      (glyph.width & 3) == 0 && glyph.width <= 32 && (glyphX & 3) == 0 &&
+      glyphX >= paintState().absClippingRect.X1 && glyphX + glyph.width - 1 <= paintState().absClippingRect.X2) {
+    drawGlyph_aligned(glyph, glyphOptions, penColor, brushColor, updateRect);
+    return;
+  }
+
   genericDrawGlyph(glyph, glyphOptions, penColor, brushColor, updateRect,
                    [&] (RGB888 const & color) { return preparePixel(color); },
                    [&] (int y)                { return (uint8_t*) m_viewPort[y]; },
@@ -1014,6 +1144,75 @@ void IRAM_ATTR VGAController::drawGlyph(Glyph const & glyph, GlyphOptions glyphO
 }
 
 
+// assume glyph has width multiple of 4 (up to 32), it is 32 bit aligned and not horizontally clipped
+// glyphOptions can have only fillBackground, invert and reduceLuminosity set (like genericDrawGlyph_light)
+void IRAM_ATTR VGAController::drawGlyph_aligned(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect)
+{
+  const int clipY1 = paintState().absClippingRect.Y1;
+  const int clipY2 = paintState().absClippingRect.Y2;
+
+  const int glyphX = glyph.X + paintState().origin.X;
+  const int glyphY = glyph.Y + paintState().origin.Y;
+
+  const int glyphWidthByte = glyph.width / 8 + ((glyph.width & 7) ? 1 : 0);
+  const int nibbles        = glyph.width / 4;
+
+  int Y1     = 0;
+  int YCount = glyph.height;
+  int destY  = glyphY;
+
+  if (destY < clipY1) {
+    Y1 = clipY1 - destY;
+    destY = clipY1;
+  }
+  if (Y1 >= glyph.height)
+    return;
+  if (destY + YCount > clipY2 + 1)
+    YCount = clipY2 + 1 - destY;
+  if (Y1 + YCount > glyph.height)
+    YCount = glyph.height - Y1;
+  if (YCount <= 0)
+    return;
+
+  updateRect = updateRect.merge(Rect(glyphX, destY, glyphX + glyph.width - 1, destY + YCount - 1));
+  hideSprites(updateRect);
+
+  if (glyphOptions.invert ^ paintState().paintOptions.swapFGBG)
+    tswap(penColor, brushColor);
+
+  // a very simple and ugly reduce luminosity (faint) implementation!
+  if (glyphOptions.reduceLuminosity) {
+    if (penColor.R > 128) penColor.R = 128;
+    if (penColor.G > 128) penColor.G = 128;
+    if (penColor.B > 128) penColor.B = 128;
+  }
+
+  const uint32_t pen32   = preparePixel(penColor) * 0x01010101;
+  const uint32_t brush32 = preparePixel(brushColor) * 0x01010101;
+
+  uint8_t const * srcrow = glyph.data + Y1 * glyphWidthByte;
+  for (int y = 0; y < YCount; ++y, ++destY, srcrow += glyphWidthByte) {
+    uint32_t * dst = (uint32_t*) (m_viewPort[destY] + glyphX);
+    // leftmost pixel at bit 31
+    uint32_t src = 0;
+    for (int i = 0; i < glyphWidthByte; ++i)
+      src |= (uint32_t) srcrow[i] << (24 - 8 * i);
+    if (glyphOptions.fillBackground) {
+      for (int i = 0; i < nibbles; ++i, src <<= 4) {
+        const uint32_t mask = s_glyphNibbleMask[src >> 28];
+        *dst++ = (pen32 & mask) | (brush32 & ~mask);
+      }
+    } else {
+      for (int i = 0; i < nibbles; ++i, src <<= 4, ++dst) {
+        const uint32_t mask = s_glyphNibbleMask[src >> 28];
+        if (mask)
+          *dst = (*dst & ~mask) | (pen32 & mask);
+      }
+    }
+  }
+}
+
+
 void IRAM_ATTR VGAController::invertRect(Rect const & rect, Rect & updateRect)
 {
   genericInvertRect(rect, updateRect,
@@ -1025,10 +1224,8 @@ void IRAM_ATTR VGAController::invertRect(Rect const & rect, Rect & updateRect)
 void IRAM_ATTR VGAController::swapFGBG(Rect const & rect, Rect & updateRect)
 {
   genericSwapFGBG(rect, updateRect,
-                  [&] (RGB888 const & color)                  { return preparePixel(color); },
-                  [&] (int y)                                 { return (uint8_t*) m_viewPort[y]; },
-                  [&] (uint8_t * row, int x)                  { return VGA_PIXELINROW(row, x); },
-                  [&] (uint8_t * row, int x, uint8_t pattern) { VGA_PIXELINROW(row, x) = pattern; }
+                  [&] (RGB888 const & color)                               { return preparePixel(color); },
+                  [&] (int y, int x1, int x2, uint8_t pen, uint8_t brush) { rawSwapFGBGRow(y, x1, x2, pen, brush); }
                  );
 }
 
@@ -1083,13 +1280,66 @@ void VGAController::writeScreen(Rect const & rect, RGB222 * srcBuf)
 }
 
 
+// copies count pixels from src to row starting at x, adding HVSync bits
+static void IRAM_ATTR copyToRow(uint8_t * row, int x, uint8_t const * src, int count, uint8_t HVSync)
+{
+  const uint32_t HVSync32 = HVSync * 0x01010101;
+  const int xEnd = x + count;
+  // copy first bytes before full 32 bits word
+  for (; x < xEnd && (x & 3) != 0; ++x)
+    VGA_PIXELINROW(row, x) = HVSync | *src++;
+  // copy whole 32 bits words, VGA_PIXELINROW swaps 16 bit halves
+  uint32_t * dst = (uint32_t*)(row + x);
+  const int right = xEnd & ~3;
+  if (((uintptr_t)src & 3) == 0) {
+    for (; x < right; x += 4, src += 4) {
+      const uint32_t v = *(uint32_t const *)src;
+      *dst++ = HVSync32 | (v >> 16) | (v << 16);
+    }
+  } else {
+    for (; x < right; x += 4, src += 4)
+      *dst++ = HVSync32 | src[2] | (src[3] << 8) | (src[0] << 16) | (src[1] << 24);
+  }
+  // copy last unaligned bytes
+  for (; x < xEnd; ++x)
+    VGA_PIXELINROW(row, x) = HVSync | *src++;
+}
+
+
+// copies count pixels of row starting at x to dest
+static void IRAM_ATTR copyFromRow(uint8_t const * row, int x, uint8_t * dest, int count)
+{
+  const int xEnd = x + count;
+  for (; x < xEnd && (x & 3) != 0; ++x)
+    *dest++ = VGA_PIXELINROW(row, x);
+  uint32_t const * src = (uint32_t const *)(row + x);
+  const int right = xEnd & ~3;
+  if (((uintptr_t)dest & 3) == 0) {
+    for (; x < right; x += 4, dest += 4) {
+      const uint32_t v = *src++;
+      *(uint32_t*)dest = (v >> 16) | (v << 16);
+    }
+  } else {
+    for (; x < right; x += 4, dest += 4) {
+      const uint32_t v = *src++;
+      dest[0] = v >> 16;
+      dest[1] = v >> 24;
+      dest[2] = v;
+      dest[3] = v >> 8;
+    }
+  }
+  for (; x < xEnd; ++x)
+    *dest++ = VGA_PIXELINROW(row, x);
+}
+
+
 void IRAM_ATTR VGAController::rawDrawBitmap_Native(int destX, int destY, Bitmap const * bitmap, int X1, int Y1, int XCount, int YCount)
 {
   const uint8_t HVSync = packHVSync();
-  genericRawDrawBitmap_Native(destX, destY, (uint8_t*) bitmap->data, bitmap->width, X1, Y1, XCount, YCount,
-                              [&] (int y)                             { return (uint8_t*) m_viewPort[y]; },       // rawGetRow
-                              [&] (uint8_t * row, int x, uint8_t src) { VGA_PIXELINROW(row, x) = HVSync | src; }  // rawSetPixelInRow
-                             );
+  const int     width  = bitmap->width;
+  const int     yEnd   = Y1 + YCount;
+  for (int y = Y1; y < yEnd; ++y, ++destY)
+    copyToRow((uint8_t*) m_viewPort[destY], destX, bitmap->data + y * width + X1, XCount, HVSync);
 }
 
 
@@ -1126,6 +1376,25 @@ void IRAM_ATTR VGAController::rawDrawBitmap_RGBA8888(int destX, int destY, Bitma
 }
 
 
+// native runs contain color bits only, sync bits are added while drawing
+bool VGAController::rawColorToNative(RGB888 const & color, void * dest)
+{
+  *(uint8_t*)dest = (color.R >> 6) | (color.G >> 6 << 2) | (color.B >> 6 << 4);
+  return true;
+}
+
+
+void IRAM_ATTR VGAController::rawDrawBitmap_Runs(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  const uint8_t HVSync = packHVSync();
+  genericRawDrawBitmap_Runs(destX, destY, bitmap, (uint8_t*)saveBackground, X1, Y1, XCount, YCount,
+                            [&] (int y)                                              { return (uint8_t*) m_viewPort[y]; },      // rawGetRow
+                            [&] (uint8_t * row, int x, uint8_t * dest, int count)      { copyFromRow(row, x, dest, count); },       // rawCopyFromRow
+                            [&] (uint8_t * row, int x, uint8_t const * src, int count) { copyToRow(row, x, src, count, HVSync); }   // rawCopyToRow
+                           );
+}
+
+
 void IRAM_ATTR VGAController::swapBuffers()
 {
   tswap(m_DMABuffers, m_DMABuffersVisible);
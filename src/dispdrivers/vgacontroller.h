@@ -68,6 +68,9 @@ namespace fabgl {
 // Thanks to https://github.com/paulscottrobson for the new macro. Before was: (row[((X) & 0xFFFC) + ((2 + (X)) & 3)])
 #define VGA_PIXELINROW(row, X) (row[(X) ^ 2])
 
+// given a 32 bit word, returns 0xff in each byte that is zero, 0x00 otherwise
+#define VGA_EQUALBYTESMASK(v) (((~((((v) & 0x7f7f7f7f) + 0x7f7f7f7f) | (v)) & 0x80808080) >> 7) * 0xff)
+
 // requires variables: m_viewPort
 #define VGA_PIXEL(X, Y)    VGA_PIXELINROW(m_viewPort[(Y)], X)
 #define VGA_INVERT_PIXEL(X, Y) { auto px = &VGA_PIXEL((X), (Y)); *px = ~(*px ^ VGA_SYNC_MASK); }
@@ -251,7 +254,28 @@ public:
    */
   void setResolution(char const * modeline, int viewPortWidth = -1, int viewPortHeight = -1, bool doubleBuffered = false);
 
-  void setResolution(VGATimings const& timings, int viewPortWidth = -1, int viewPortHeight = -1, bool doubleBuffered = false);
+  virtual void setResolution(VGATimings const& timings, int viewPortWidth = -1, int viewPortHeight = -1, bool doubleBuffered = false);
+
+  /**
+   * @brief Allocates the viewport as a single memory block.
+   *
+   * By default the viewport is allocated in up to FABGLIB_VIEWPORT_MEMORY_POOL_COUNT blocks and vertical scrolling swaps rows pointers.
+   * When contiguous viewport is enabled it is allocated in a single block (with the back buffer, when double buffered) and rows are never
+   * swapped, so viewport rows are always stored one after another. Clear and full width vertical scrolling operate on the whole block, but
+   * scrolling copies memory instead of swapping pointers.<br>
+   * The viewport height may be reduced to the rows that fit into the largest free block.<br>
+   * Takes effect at next setResolution() call.
+   *
+   * @param value True to allocate the viewport as a single block.
+   */
+  void enableContiguousViewPort(bool value) { m_contiguousViewPort = value; }
+
+  /**
+   * @brief Determines whether the viewport is allocated as a single memory block
+   *
+   * @return True if viewport rows are stored one after another.
+   */
+  bool isViewPortContiguous()               { return m_viewPortContiguous; }
 
   VGATimings * getResolutionTimings() { return &m_timings; }
 
@@ -338,9 +362,9 @@ public:
    *     VGAController.writeScreen(rect.translate(110, 0), buf);
    *     delete buf;
    */
-  void readScreen(Rect const & rect, RGB222 * destBuf);
+  virtual void readScreen(Rect const & rect, RGB222 * destBuf);
 
-  void readScreen(Rect const & rect, RGB888 * destBuf);
+  virtual void readScreen(Rect const & rect, RGB888 * destBuf);
 
   /**
    * @brief Writes pixels inside the specified rectangle.
@@ -368,7 +392,7 @@ public:
    *     VGAController.writeScreen(rect.translate(110, 0), buf);
    *     delete buf;
    */
-  void writeScreen(Rect const & rect, RGB222 * srcBuf);
+  virtual void writeScreen(Rect const & rect, RGB222 * srcBuf);
 
   /**
    * @brief Creates a raw pixel to use with VGAController.setRawPixel
@@ -398,7 +422,7 @@ public:
    *     // Set color of pixel at 100, 100
    *     VGAController.setRawPixel(100, 100, VGAController.createRawPixel(RGB222(3, 0, 0));
    */
-  void setRawPixel(int x, int y, uint8_t rgb) { VGA_PIXEL(x, y) = rgb; }
+  virtual void setRawPixel(int x, int y, uint8_t rgb) { VGA_PIXEL(x, y) = rgb; }
 
   /**
    * @brief Gets a raw scanline pointer.
@@ -413,9 +437,9 @@ public:
    *
    * @param y Vertical scanline position (0 = top row)
    */
-  uint8_t * getScanline(int y)                { return (uint8_t*) m_viewPort[y]; }
+  virtual uint8_t * getScanline(int y)                { return (uint8_t*) m_viewPort[y]; }
 
-private:
+protected:
 
   void init(gpio_num_t VSyncGPIO);
 
@@ -426,8 +450,9 @@ private:
   void fillHorizBuffers(int offsetX);
   void fillVertBuffers(int offsetY);
   int fill(uint8_t volatile * buffer, int startPos, int length, uint8_t red, uint8_t green, uint8_t blue, bool hsync, bool vsync);
-  void allocateViewPort();
-  void freeViewPort();
+  void allocateViewPort(uint32_t allocCaps, int rowlen);
+  virtual void allocateViewPort();
+  virtual void freeViewPort();
   int calcRequiredDMABuffersCount(int viewPortHeight);  
 
   // abstract method of DisplayController
@@ -441,6 +466,7 @@ private:
 
   // abstract method of DisplayController
   void VScroll(int scroll, Rect & updateRect);
+  void contiguousVScroll(int scroll, Rect & updateRect);
 
   // abstract method of DisplayController
   void HScroll(int scroll, Rect & updateRect);
@@ -472,6 +498,12 @@ private:
   // abstract method of DisplayController
   void rawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
 
+  // overridable method of DisplayController
+  bool rawColorToNative(RGB888 const & color, void * dest);
+
+  // overridable method of DisplayController
+  void rawDrawBitmap_Runs(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+
   // abstract method of DisplayController
   void rawFillRow(int y, int x1, int x2, RGB888 color);
 
@@ -480,6 +512,9 @@ private:
   void rawInvertRow(int y, int x1, int x2);
 
   void swapRows(int yA, int yB, int x1, int x2);
+  void drawGlyph_aligned(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect);
+  void rawSwapFGBGRow(int y, int x1, int x2, uint8_t penPattern, uint8_t brushPattern);
+  void copyRow(int x1, int x2, int srcY, int dstY);
 
   // abstract method of DisplayController
   void absDrawLine(int X1, int Y1, int X2, int Y2, RGB888 color);
@@ -493,9 +528,9 @@ private:
 
   // DMA related methods
   bool setDMABuffersCount(int buffersCount);
-  void setDMABufferBlank(int index, void volatile * address, int length);
+  virtual void setDMABufferBlank(int index, void volatile * address, int length);
   void setDMABufferView(int index, int row, int scan, volatile uint8_t * * viewPort, bool onVisibleDMA);
-  void setDMABufferView(int index, int row, int scan);
+  virtual void setDMABufferView(int index, int row, int scan);
   void volatile * getDMABuffer(int index, int * length);
 
 
@@ -528,6 +563,9 @@ private:
 
   uint8_t *              m_viewPortMemoryPool[FABGLIB_VIEWPORT_MEMORY_POOL_COUNT + 1];  // last allocated pool is nullptr
 
+  bool                   m_contiguousViewPort;  // contiguous viewport requested
+  bool                   m_viewPortContiguous;  // viewport allocated in m_viewPortMemoryPool[0] only, rows never swapped
+
   // when double buffer is enabled the running DMA buffer is always m_DMABuffersRunning
   // when double buffer is not enabled then m_DMABuffers = m_DMABuffersRunning
   lldesc_t volatile *    m_DMABuffersHead;
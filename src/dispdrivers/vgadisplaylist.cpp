@@ -0,0 +1,254 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include <atomic>
+
+#include "esp_attr.h"
+
+#include "vgadisplaylist.h"
+
+
+
+
+namespace fabgl {
+
+
+
+// same pixels order of VGA_PIXELINROW
+#define DISPLAYLIST_PIXEL(dest, X) ((dest)[(X) ^ 2])
+
+
+
+/*************************************************************************************/
+/* VGADisplayList definitions */
+
+
+VGADisplayList::VGADisplayList(int maxItems)
+  : m_maxItems(maxItems),
+    m_count(0),
+    m_renderers(0),
+    m_background(0),
+    m_HVSync(0)
+{
+  // rendered by interrupts, so items must be in internal memory
+  m_items = (DisplayListItem *) heap_caps_malloc(sizeof(DisplayListItem) * maxItems, MALLOC_CAP_32BIT | MALLOC_CAP_INTERNAL);
+  if (!m_items)
+    m_maxItems = 0;
+}
+
+
+VGADisplayList::~VGADisplayList()
+{
+  heap_caps_free(m_items);
+}
+
+
+int VGADisplayList::add(DisplayListItem const & item)
+{
+  const int index = m_count;
+  if (index >= m_maxItems)
+    return -1;
+  m_items[index] = item;
+  // the item must be complete before a renderer can see it
+  std::atomic_thread_fence(std::memory_order_release);
+  m_count = index + 1;
+  return index;
+}
+
+
+void VGADisplayList::clear()
+{
+  m_count = 0;
+  // a renderer started before may still read old items, which next add() will overwrite
+  waitRenderers();
+}
+
+
+void VGADisplayList::replace(int index, DisplayListItem const & item)
+{
+  if (index < 0 || index >= m_count)
+    return;
+  DisplayListItem & dest = m_items[index];
+  dest.visible = false;
+  waitRenderers();
+  // now renderers skip this item, so it can be written field by field
+  DisplayListItem hidden = item;
+  hidden.visible = false;
+  dest = hidden;
+  std::atomic_thread_fence(std::memory_order_release);
+  dest.visible = item.visible;
+}
+
+
+// waits until renderers started before the last change have finished. Renderers started later see the change.
+void VGADisplayList::waitRenderers()
+{
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  while (m_renderers.load() > 0)
+    ;
+}
+
+
+// fills pixels from x1 to x2 (included). Whole 32 bit words are filled by memset, pixels order inside them doesn't matter
+static void IRAM_ATTR fillSpan(uint8_t * dest, int x1, int x2, uint8_t value)
+{
+  for (; x1 <= x2 && (x1 & 3) != 0; ++x1)
+    DISPLAYLIST_PIXEL(dest, x1) = value;
+  const int right = (x2 + 1) & ~3;
+  if (x1 < right) {
+    memset(dest + x1, value, right - x1);
+    x1 = right;
+  }
+  for (; x1 <= x2; ++x1)
+    DISPLAYLIST_PIXEL(dest, x1) = value;
+}
+
+
+void IRAM_ATTR VGADisplayList::renderLine(int y, uint8_t * dest, int width)
+{
+  memset(dest, m_background, width);
+
+  m_renderers.fetch_add(1);
+  const int count = m_count;
+  for (int i = 0; i < count; ++i) {
+    DisplayListItem const & item = m_items[i];
+    if (!item.visible || y < item.Y)
+      continue;
+    const int row = y - item.Y;
+    switch (item.type) {
+
+      case DisplayListItemType::Rectangle:
+        if (row < item.height)
+          fillSpan(dest, tmax((int)item.X, 0), tmin(item.X + item.width - 1, width - 1), item.color);
+        break;
+
+      case DisplayListItemType::Text:
+        if (row < item.font->height)
+          renderTextRow(item, row, dest, width);
+        break;
+
+      case DisplayListItemType::Bitmap:
+        if (row < item.bitmap->height)
+          renderBitmapRow(item, row, dest, width);
+        break;
+
+    }
+  }
+  m_renderers.fetch_sub(1);
+}
+
+
+void IRAM_ATTR VGADisplayList::renderTextRow(DisplayListItem const & item, int row, uint8_t * dest, int width)
+{
+  FontInfo const * font = item.font;
+  const uint8_t penColor   = item.color;
+  const uint8_t brushColor = item.brushColor;
+  const bool    fillBackground = item.fillBackground;
+
+  int x = item.X;
+  for (uint8_t const * text = (uint8_t const *) item.text; *text && x < width; ++text) {
+    uint8_t const * glyph;
+    int glyphWidth;
+    if (font->chptr) {
+      // variable width
+      glyph      = font->data + font->chptr[*text];
+      glyphWidth = *glyph++;
+    } else {
+      // fixed width
+      glyphWidth = font->width;
+      glyph      = font->data + *text * font->height * ((glyphWidth + 7) / 8);
+    }
+    if (x + glyphWidth > 0) {
+      uint8_t const * src = glyph + row * ((glyphWidth + 7) / 8);
+      const int gx1 = tmax(0, -x);
+      const int gx2 = tmin(glyphWidth, width - x);
+      for (int gx = gx1; gx < gx2; ++gx) {
+        if ((src[gx >> 3] << (gx & 7)) & 0x80)
+          DISPLAYLIST_PIXEL(dest, x + gx) = penColor;
+        else if (fillBackground)
+          DISPLAYLIST_PIXEL(dest, x + gx) = brushColor;
+      }
+    }
+    x += glyphWidth;
+  }
+}
+
+
+void IRAM_ATTR VGADisplayList::renderBitmapRow(DisplayListItem const & item, int row, uint8_t * dest, int width)
+{
+  Bitmap const * bitmap = item.bitmap;
+  const int X  = item.X;
+  const int x1 = tmax(X, 0);
+  const int x2 = tmin(X + bitmap->width - 1, width - 1);
+  const uint8_t HVSync = m_HVSync;
+
+  switch (bitmap->format) {
+
+    case PixelFormat::Native:
+    {
+      uint8_t const * src = bitmap->data + row * bitmap->width;
+      for (int x = x1; x <= x2; ++x)
+        DISPLAYLIST_PIXEL(dest, x) = HVSync | src[x - X];
+      break;
+    }
+
+    case PixelFormat::Mask:
+    {
+      RGB888 const & fg = bitmap->foregroundColor;
+      const uint8_t color = HVSync | (fg.R >> 6) | (fg.G >> 6 << 2) | (fg.B >> 6 << 4);
+      uint8_t const * src = bitmap->data + row * ((bitmap->width + 7) / 8);
+      for (int x = x1; x <= x2; ++x)
+        if ((src[(x - X) >> 3] << ((x - X) & 7)) & 0x80)
+          DISPLAYLIST_PIXEL(dest, x) = color;
+      break;
+    }
+
+    case PixelFormat::RGBA2222:
+    {
+      uint8_t const * src = bitmap->data + row * bitmap->width;
+      for (int x = x1; x <= x2; ++x)
+        if (src[x - X] & 0xc0)  // alpha > 0 ?
+          DISPLAYLIST_PIXEL(dest, x) = HVSync | (src[x - X] & 0x3f);
+      break;
+    }
+
+    case PixelFormat::RGBA8888:
+    {
+      RGBA8888 const * src = (RGBA8888 const *) bitmap->data + row * bitmap->width;
+      for (int x = x1; x <= x2; ++x) {
+        RGBA8888 const & px = src[x - X];
+        if (px.A)
+          DISPLAYLIST_PIXEL(dest, x) = HVSync | (px.R >> 6) | (px.G >> 6 << 2) | (px.B >> 6 << 4);
+      }
+      break;
+    }
+
+    default:
+      break;
+
+  }
+}
+
+
+
+} // end of namespace
@@ -0,0 +1,213 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+
+/**
+ * @file
+ *
+ * @brief This file contains fabgl::VGADisplayList definition.
+ */
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#include "fabglconf.h"
+#include "fabutils.h"
+#include "displaycontroller.h"
+
+
+
+
+namespace fabgl {
+
+
+
+/** \ingroup Enumerations
+ * @brief Specifies the type of a display list item
+ */
+enum class DisplayListItemType : uint8_t {
+  Rectangle,  /**< Filled rectangle. Uses X, Y, width, height and color */
+  Text,       /**< Single row text. Uses X, Y, font, text, color, brushColor and fillBackground */
+  Bitmap,     /**< Bitmap of any format. Uses X, Y and bitmap */
+};
+
+
+/**
+ * @brief Represents an item of a display list
+ *
+ * Colors are raw pixels, including sync signals (see VGAController.createRawPixel()).<br>
+ * Items can be modified in place after they have been added: changes appear on next rendered rows. While the display
+ * is rendering only X, Y, width, height, colors, fillBackground and visible can be changed in place. Changing type,
+ * font, text or bitmap requires VGADisplayList.replace().
+ */
+struct DisplayListItem {
+  DisplayListItemType type;           /**< Item type */
+  bool                visible;        /**< If false the item is not rendered */
+  bool                fillBackground; /**< Text: if true glyph background is painted with brushColor */
+  uint8_t             color;          /**< Rectangle: fill color. Text: pen color */
+  uint8_t             brushColor;     /**< Text: background color, used when fillBackground is true */
+  int16_t             X;              /**< Horizontal position of top-left corner (may be negative) */
+  int16_t             Y;              /**< Vertical position of top-left corner (may be negative) */
+  int16_t             width;          /**< Rectangle: horizontal size */
+  int16_t             height;         /**< Rectangle: vertical size */
+  FontInfo const *    font;           /**< Text: font */
+  char const *        text;           /**< Text: zero terminated string. It is not copied, so it must live while the item is visible */
+  Bitmap const *      bitmap;         /**< Bitmap: the bitmap. It is not copied, so it must live while the item is visible */
+};
+
+
+/**
+ * @brief Represents a retained list of rectangles, texts and bitmaps, rendered one scanline at the time
+ *
+ * Items are rendered in the order they have been added, so later items cover earlier ones.<br>
+ * renderLine() depends only on the display list content, so it can be run and measured also outside of the
+ * VGA controller (see VGADisplayListController).
+ *
+ * The display list can be modified while another task (or an interrupt) is rendering: add() copies the item before
+ * it is counted, while clear() and replace() wait for renderers that may still read the old items. For this reason
+ * clear() and replace() must not be called from the rendering interrupt.
+ */
+class VGADisplayList {
+
+public:
+
+  /**
+   * @brief Initializes a new instance of VGADisplayList
+   *
+   * @param maxItems Maximum number of items. Items memory is allocated once here.
+   */
+  VGADisplayList(int maxItems);
+
+  ~VGADisplayList();
+
+  // unwanted methods
+  VGADisplayList(VGADisplayList const&)  = delete;
+  void operator=(VGADisplayList const&)  = delete;
+
+  /**
+   * @brief Appends an item
+   *
+   * @param item Item to copy into the display list.
+   *
+   * @return Index of the new item, or -1 when the display list is full.
+   */
+  int add(DisplayListItem const & item);
+
+  /**
+   * @brief Removes all items
+   *
+   * Returns when running renderers have finished, so slots can be reused by add().
+   */
+  void clear();
+
+  /**
+   * @brief Replaces an item
+   *
+   * The item is hidden while it is copied, then gets the visibility of the new one.
+   *
+   * @param index Item index, as returned by add().
+   * @param item Item to copy into the display list.
+   */
+  void replace(int index, DisplayListItem const & item);
+
+  /**
+   * @brief Gets an item, to modify it in place
+   *
+   * While rendering only some fields can be changed in place (see DisplayListItem), use replace() for the others.
+   *
+   * @param index Item index, as returned by add().
+   *
+   * @return Reference to the item.
+   */
+  DisplayListItem & item(int index)       { return m_items[index]; }
+
+  /**
+   * @brief Determines number of items
+   *
+   * @return Number of items.
+   */
+  int count()                             { return m_count; }
+
+  /**
+   * @brief Determines maximum number of items
+   *
+   * @return Maximum number of items.
+   */
+  int maxItems()                          { return m_maxItems; }
+
+  /**
+   * @brief Sets the raw pixel painted where there aren't items
+   *
+   * @param value Raw pixel, including sync signals.
+   */
+  void setBackground(uint8_t value)       { m_background = value; }
+
+  /**
+   * @brief Sets sync signals added to bitmap pixels
+   *
+   * @param value Raw pixel with sync bits only (color bits are zero).
+   */
+  void setHVSync(uint8_t value)           { m_HVSync = value; }
+
+  /**
+   * @brief Renders a scanline
+   *
+   * Pixel X is stored at dest[X ^ 2], the same order of VGA_PIXELINROW.
+   *
+   * @param y Scanline to render.
+   * @param dest Destination buffer. Must be 32 bit aligned.
+   * @param width Number of pixels to render. Must be a multiple of 4.
+   */
+  void renderLine(int y, uint8_t * dest, int width);
+
+
+private:
+
+  void renderTextRow(DisplayListItem const & item, int row, uint8_t * dest, int width);
+  void renderBitmapRow(DisplayListItem const & item, int row, uint8_t * dest, int width);
+
+  void waitRenderers();
+
+
+  DisplayListItem *      m_items;
+  int16_t                m_maxItems;
+  volatile int16_t       m_count;
+
+  // number of renderLine() calls in progress
+  std::atomic<int>       m_renderers;
+
+  uint8_t                m_background;
+  uint8_t                m_HVSync;
+
+};
+
+
+
+} // end of namespace
+
+
+
@@ -0,0 +1,197 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "fabutils.h"
+#include "vgadisplaylistcontroller.h"
+
+
+
+
+namespace fabgl {
+
+
+
+/*************************************************************************************/
+/* VGADisplayListController definitions */
+
+
+// texts, fonts and bitmaps may be in flash, so the I2S interrupt can't be placed in IRAM only
+VGADisplayListController::VGADisplayListController(int maxItems)
+  : VGALineBufferController(fillLines, ESP_INTR_FLAG_LEVEL3),
+    m_displayList(maxItems),
+    m_backgroundColor(Color::Black)
+{
+}
+
+
+void VGADisplayListController::setResolution(VGATimings const& timings, int viewPortWidth, int viewPortHeight, bool doubleBuffered)
+{
+  VGALineBufferController::setResolution(timings, viewPortWidth, viewPortHeight, false);
+}
+
+
+// there isn't a viewport, rows are rendered from the display list
+void VGADisplayListController::allocateViewPort()
+{
+  allocateLineBuffers();
+
+  m_viewPort              = nullptr;
+  m_viewPortVisible       = nullptr;
+  m_viewPortMemoryPool[0] = nullptr;
+  m_viewPortContiguous    = false;
+
+  updateSyncBits();
+
+  fillLines(this, 0, FABGLIB_VGA_LINEBUFFERS);
+}
+
+
+void VGADisplayListController::freeViewPort()
+{
+  freeLineBuffers();
+}
+
+
+// sync signals polarity is known only after timings have been set, so items added before setResolution() are fixed here
+void VGADisplayListController::updateSyncBits()
+{
+  const uint8_t HVSync = packHVSync();
+  m_displayList.setHVSync(HVSync);
+  m_displayList.setBackground(rawPixel(m_backgroundColor));
+  for (int i = 0; i < m_displayList.count(); ++i) {
+    DisplayListItem & item = m_displayList.item(i);
+    item.color      = HVSync | (item.color & ~VGA_SYNC_MASK);
+    item.brushColor = HVSync | (item.brushColor & ~VGA_SYNC_MASK);
+  }
+}
+
+
+void VGADisplayListController::setBackgroundColor(RGB888 const & color)
+{
+  m_backgroundColor = color;
+  m_displayList.setBackground(rawPixel(color));
+}
+
+
+int VGADisplayListController::addRectangle(Rect const & rect, RGB888 const & color)
+{
+  DisplayListItem item = { };
+  item.type    = DisplayListItemType::Rectangle;
+  item.visible = true;
+  item.color   = rawPixel(color);
+  item.X       = rect.X1;
+  item.Y       = rect.Y1;
+  item.width   = rect.width();
+  item.height  = rect.height();
+  return m_displayList.add(item);
+}
+
+
+int VGADisplayListController::addText(int X, int Y, FontInfo const * font, char const * text, RGB888 const & penColor)
+{
+  DisplayListItem item = { };
+  item.type    = DisplayListItemType::Text;
+  item.visible = true;
+  item.color   = rawPixel(penColor);
+  item.X       = X;
+  item.Y       = Y;
+  item.font    = font;
+  item.text    = text;
+  return m_displayList.add(item);
+}
+
+
+int VGADisplayListController::addText(int X, int Y, FontInfo const * font, char const * text, RGB888 const & penColor, RGB888 const & brushColor)
+{
+  DisplayListItem item = { };
+  item.type           = DisplayListItemType::Text;
+  item.visible        = true;
+  item.fillBackground = true;
+  item.color          = rawPixel(penColor);
+  item.brushColor     = rawPixel(brushColor);
+  item.X              = X;
+  item.Y              = Y;
+  item.font           = font;
+  item.text           = text;
+  return m_displayList.add(item);
+}
+
+
+int VGADisplayListController::addBitmap(int X, int Y, Bitmap const * bitmap)
+{
+  DisplayListItem item = { };
+  item.type    = DisplayListItemType::Bitmap;
+  item.visible = true;
+  item.X       = X;
+  item.Y       = Y;
+  item.bitmap  = bitmap;
+  return m_displayList.add(item);
+}
+
+
+void VGADisplayListController::readScreen(Rect const & rect, RGB888 * destBuf)
+{
+  uint8_t * row = (uint8_t *) malloc(m_viewPortWidth);
+  if (row) {
+    for (int y = rect.Y1; y <= rect.Y2; ++y) {
+      m_displayList.renderLine(y, row, m_viewPortWidth);
+      for (int x = rect.X1; x <= rect.X2; ++x, ++destBuf) {
+        uint8_t rawpix = VGA_PIXELINROW(row, x);
+        *destBuf = RGB888((rawpix & 3) * 85, ((rawpix >> 2) & 3) * 85, ((rawpix >> 4) & 3) * 85);
+      }
+    }
+    free(row);
+  }
+}
+
+
+void VGADisplayListController::readScreen(Rect const & rect, RGB222 * destBuf)
+{
+  uint8_t * dbuf = (uint8_t*) destBuf;
+  uint8_t * row  = (uint8_t *) malloc(m_viewPortWidth);
+  if (row) {
+    for (int y = rect.Y1; y <= rect.Y2; ++y) {
+      m_displayList.renderLine(y, row, m_viewPortWidth);
+      for (int x = rect.X1; x <= rect.X2; ++x, ++dbuf)
+        *dbuf = VGA_PIXELINROW(row, x) & ~VGA_SYNC_MASK;
+    }
+    free(row);
+  }
+}
+
+
+// renders "count" rows starting from "row" into line buffers
+void IRAM_ATTR VGADisplayListController::fillLines(VGALineBufferController * controller, int row, int count)
+{
+  auto ctrl = (VGADisplayListController *) controller;
+  const int rowEnd = tmin(row + count, (int) ctrl->m_viewPortHeight);
+  for (; row < rowEnd; ++row)
+    ctrl->m_displayList.renderLine(row, (uint8_t *) ctrl->m_lineBuffers[row % FABGLIB_VGA_LINEBUFFERS], ctrl->m_viewPortWidth);
+}
+
+
+
+} // end of namespace
@@ -0,0 +1,278 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+
+/**
+ * @file
+ *
+ * @brief This file contains fabgl::VGADisplayListController definition.
+ */
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "fabglconf.h"
+#include "fabutils.h"
+#include "displaycontroller.h"
+#include "vgalinebuffercontroller.h"
+#include "vgadisplaylist.h"
+
+
+
+
+namespace fabgl {
+
+
+
+/**
+ * @brief Represents the VGA controller which renders each scanline from a display list, without a frame buffer
+ *
+ * The screen content is a retained list of rectangles, texts and bitmaps (see VGADisplayList). Each scanline is rendered
+ * just before it is sent, into FABGLIB_VGA_LINEBUFFERS DMA line buffers, so the memory required doesn't depend on the
+ * screen size: high resolutions like 800x600 are possible even when a frame buffer wouldn't fit in RAM.<br>
+ * Rendering time of a scanline must be less than the time required to send it, so this controller is suitable for
+ * screens made of few flat items, like dashboards and simple user interfaces.<br>
+ * Canvas drawing primitives require a frame buffer, so they are ignored. Sprites aren't supported.<br>
+ * Texts, fonts and bitmaps are not copied and may be stored in flash. While flash is written rendering is suspended and
+ * the screen shows garbage.
+ *
+ * This example shows a text on a blue rectangle at 800x600:
+ *
+ *     fabgl::VGADisplayListController VGAController;
+ *
+ *     VGAController.begin();
+ *     VGAController.setResolution(SVGA_800x600_60Hz);
+ *     VGAController.setBackgroundColor(Color::Black);
+ *     VGAController.addRectangle(Rect(100, 100, 699, 199), Color::Blue);
+ *     int label = VGAController.addText(120, 140, &fabgl::FONT_8x14, "Temperature:", Color::BrightWhite);
+ *
+ *     // hide the label
+ *     VGAController.displayListItem(label).visible = false;
+ */
+class VGADisplayListController : public VGALineBufferController {
+
+public:
+
+  /**
+   * @brief Initializes a new instance of VGADisplayListController
+   *
+   * @param maxItems Maximum number of display list items.
+   */
+  VGADisplayListController(int maxItems = 64);
+
+  // unwanted methods
+  VGADisplayListController(VGADisplayListController const&) = delete;
+  void operator=(VGADisplayListController const&)           = delete;
+
+  using VGALineBufferController::setResolution;
+
+  /**
+   * @brief Sets current resolution using a timings structure
+   *
+   * Double buffering is not available, so doubleBuffered is ignored.
+   */
+  void setResolution(VGATimings const& timings, int viewPortWidth = -1, int viewPortHeight = -1, bool doubleBuffered = false);
+
+  /**
+   * @brief Sets the color of screen areas not covered by items
+   *
+   * @param color Background color.
+   */
+  void setBackgroundColor(RGB888 const & color);
+
+  /**
+   * @brief Appends a filled rectangle to the display list
+   *
+   * @param rect Rectangle position and size.
+   * @param color Fill color.
+   *
+   * @return Index of the new item, or -1 when the display list is full.
+   */
+  int addRectangle(Rect const & rect, RGB888 const & color);
+
+  /**
+   * @brief Appends a transparent text to the display list
+   *
+   * @param X Horizontal position of the text.
+   * @param Y Vertical position of the text.
+   * @param font Font.
+   * @param text Zero terminated string. It is not copied: it can be modified later, and changes will appear on next frame.
+   * @param penColor Text color.
+   *
+   * @return Index of the new item, or -1 when the display list is full.
+   */
+  int addText(int X, int Y, FontInfo const * font, char const * text, RGB888 const & penColor);
+
+  /**
+   * @brief Appends a text with filled background to the display list
+   *
+   * @param X Horizontal position of the text.
+   * @param Y Vertical position of the text.
+   * @param font Font.
+   * @param text Zero terminated string. It is not copied: it can be modified later, and changes will appear on next frame.
+   * @param penColor Text color.
+   * @param brushColor Background color.
+   *
+   * @return Index of the new item, or -1 when the display list is full.
+   */
+  int addText(int X, int Y, FontInfo const * font, char const * text, RGB888 const & penColor, RGB888 const & brushColor);
+
+  /**
+   * @brief Appends a bitmap to the display list
+   *
+   * @param X Horizontal position of the bitmap.
+   * @param Y Vertical position of the bitmap.
+   * @param bitmap The bitmap. It is not copied.
+   *
+   * @return Index of the new item, or -1 when the display list is full.
+   */
+  int addBitmap(int X, int Y, Bitmap const * bitmap);
+
+  /**
+   * @brief Gets a display list item, to modify it in place
+   *
+   * Colors of items are raw pixels, use createRawPixel() to change them.<br>
+   * Type, font, text and bitmap must be changed using displayList()->replace().
+   *
+   * @param index Item index, as returned by addRectangle(), addText() or addBitmap().
+   *
+   * @return Reference to the item.
+   */
+  DisplayListItem & displayListItem(int index) { return m_displayList.item(index); }
+
+  /**
+   * @brief Removes all items from the display list
+   *
+   * Returns when the scanline being rendered is complete, so must not be called from interrupts.
+   */
+  void clearDisplayList()                      { m_displayList.clear(); }
+
+  /**
+   * @brief Gets the display list
+   *
+   * @return The display list.
+   */
+  VGADisplayList * displayList()               { return &m_displayList; }
+
+  /**
+   * @brief Reads pixels inside the specified rectangle, rendering them from the display list
+   *
+   * @param rect Screen rectangle to read.
+   * @param destBuf Destination buffer. Buffer size must be at least rect.width() * rect.height().
+   */
+  void readScreen(Rect const & rect, RGB888 * destBuf);
+
+  void readScreen(Rect const & rect, RGB222 * destBuf);
+
+  // there isn't a frame buffer: raw pixels and written rectangles are ignored, getScanline() always returns nullptr
+  void setRawPixel(int x, int y, uint8_t rgb)          { }
+  uint8_t * getScanline(int y)                         { return nullptr; }
+  void writeScreen(Rect const & rect, RGB222 * srcBuf) { }
+
+
+protected:
+
+  void allocateViewPort();
+  void freeViewPort();
+
+
+private:
+
+  uint8_t rawPixel(RGB888 const & color)    { return preparePixel(RGB222(color)); }
+
+  void updateSyncBits();
+
+  static void fillLines(VGALineBufferController * controller, int row, int count);
+
+  // drawing primitives are ignored, there isn't a frame buffer
+
+  // abstract method of DisplayController
+  void setPixelAt(PixelDesc const & pixelDesc, Rect & updateRect) { }
+
+  // abstract method of DisplayController
+  void absDrawLine(int X1, int Y1, int X2, int Y2, RGB888 color) { }
+
+  // abstract method of DisplayController
+  void rawFillRow(int y, int x1, int x2, RGB888 color) { }
+
+  // abstract method of DisplayController
+  void drawEllipse(Size const & size, Rect & updateRect) { }
+
+  // abstract method of DisplayController
+  void clear(Rect & updateRect) { }
+
+  // abstract method of DisplayController
+  void VScroll(int scroll, Rect & updateRect) { }
+
+  // abstract method of DisplayController
+  void HScroll(int scroll, Rect & updateRect) { }
+
+  // abstract method of DisplayController
+  void drawGlyph(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect) { }
+
+  // abstract method of DisplayController
+  void invertRect(Rect const & rect, Rect & updateRect) { }
+
+  // abstract method of DisplayController
+  void copyRect(Rect const & source, Rect & updateRect) { }
+
+  // abstract method of DisplayController
+  void swapFGBG(Rect const & rect, Rect & updateRect) { }
+
+  // abstract method of DisplayController
+  void swapBuffers() { }
+
+  // abstract method of DisplayController
+  void rawDrawBitmap_Native(int destX, int destY, Bitmap const * bitmap, int X1, int Y1, int XCount, int YCount) { }
+
+  // abstract method of DisplayController
+  void rawDrawBitmap_Mask(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount) { }
+
+  // abstract method of DisplayController
+  void rawDrawBitmap_RGBA2222(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount) { }
+
+  // abstract method of DisplayController
+  void rawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount) { }
+
+  // overridable method of DisplayController
+  void rawDrawBitmap_Runs(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount) { }
+
+  // overridable method of DisplayController
+  bool rawColorToNative(RGB888 const & color, void * dest) { return false; }
+
+
+  VGADisplayList         m_displayList;
+
+  RGB888                 m_backgroundColor;
+
+};
+
+
+
+} // end of namespace
+
+
+
@@ -0,0 +1,140 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "freertos/FreeRTOS.h"
+
+#include "soc/i2s_struct.h"
+#include "esp_intr_alloc.h"
+
+#include "fabutils.h"
+#include "vgalinebuffercontroller.h"
+
+
+
+
+namespace fabgl {
+
+
+
+/*************************************************************************************/
+/* VGALineBufferController definitions */
+
+
+VGALineBufferController::VGALineBufferController(FillLinesCallback fillLines, int interruptFlags)
+  : m_fillLines(fillLines),
+    m_interruptFlags(interruptFlags),
+    m_isr_handle(nullptr)
+{
+  for (int i = 0; i < FABGLIB_VGA_LINEBUFFERS; ++i)
+    m_lineBuffers[i] = nullptr;
+}
+
+
+void VGALineBufferController::setResolution(VGATimings const& timings, int viewPortWidth, int viewPortHeight, bool doubleBuffered)
+{
+  // stop line buffers filling before buffers are released
+  if (m_isr_handle) {
+    esp_intr_free(m_isr_handle);
+    m_isr_handle = nullptr;
+  }
+
+  VGAController::setResolution(timings, viewPortWidth, viewPortHeight, doubleBuffered);
+
+  // GPIOStream.play() resets I2S, so the interrupt is enabled here
+  m_lineBuffersNextRow = FABGLIB_VGA_LINEBUFFERS;
+  esp_intr_alloc(ETS_I2S1_INTR_SOURCE, m_interruptFlags, I2SInterrupt, this, &m_isr_handle);
+  I2S1.int_clr.val     = 0xffffffff;
+  I2S1.int_ena.out_eof = 1;
+}
+
+
+// called by allocateViewPort() of derived classes: m_viewPortWidth is already set
+void VGALineBufferController::allocateLineBuffers()
+{
+  for (int i = 0; i < FABGLIB_VGA_LINEBUFFERS; ++i)
+    m_lineBuffers[i] = (volatile uint8_t*) heap_caps_malloc(m_viewPortWidth, MALLOC_CAP_DMA);
+}
+
+
+void VGALineBufferController::freeLineBuffers()
+{
+  for (int i = 0; i < FABGLIB_VGA_LINEBUFFERS; ++i) {
+    heap_caps_free((void*) m_lineBuffers[i]);
+    m_lineBuffers[i] = nullptr;
+  }
+}
+
+
+// vertical sync lines raise the I2S interrupt, to prepare first rows of next frame
+void VGALineBufferController::setDMABufferBlank(int index, void volatile * address, int length)
+{
+  VGAController::setDMABufferBlank(index, address, length);
+  const bool isVSync = (address == m_HBlankLine_withVSync);
+  m_DMABuffers[index].eof        = isVSync;
+  m_DMABuffersVisible[index].eof = isVSync;
+}
+
+
+// rows are sent from line buffers. Last scan of each half of line buffers raises the I2S interrupt, to refill it.
+void VGALineBufferController::setDMABufferView(int index, int row, int scan)
+{
+  uint8_t * bufferPtr;
+  if (scan > 0 && m_timings.multiScanBlack == 1 && m_timings.HStartingBlock == FrontPorch)
+    bufferPtr = (uint8_t *) (m_HBlankLine + m_HLineSize - m_timings.HVisibleArea);  // see VGAController::setDMABufferView()
+  else
+    bufferPtr = getLineBuffer(row);
+  const int  half = FABGLIB_VGA_LINEBUFFERS / 2;
+  const bool eof  = (row % half == half - 1) && (scan == m_timings.scanCount - 1);
+  for (int i = 0; i < 2; ++i) {
+    lldesc_t volatile * DMABuffer = (i == 0 ? m_DMABuffers : m_DMABuffersVisible) + index;
+    DMABuffer->size   = (m_viewPortWidth + 3) & (~3);
+    DMABuffer->length = m_viewPortWidth;
+    DMABuffer->buf    = bufferPtr;
+    DMABuffer->eof    = eof;
+  }
+}
+
+
+// out_eof is raised on vertical sync and after each half of line buffers has been sent
+void IRAM_ATTR VGALineBufferController::I2SInterrupt(void * arg)
+{
+  auto ctrl = (VGALineBufferController *) arg;
+
+  if (I2S1.int_st.out_eof) {
+    auto desc = (lldesc_t volatile *) I2S1.out_eof_des_addr;
+    if (desc->buf == ctrl->m_HBlankLine_withVSync) {
+      // new frame, prepare all line buffers
+      ctrl->m_fillLines(ctrl, 0, FABGLIB_VGA_LINEBUFFERS);
+      ctrl->m_lineBuffersNextRow = FABGLIB_VGA_LINEBUFFERS;
+    } else {
+      // half of line buffers has been sent, refill it while DMA sends the other half
+      ctrl->m_fillLines(ctrl, ctrl->m_lineBuffersNextRow, FABGLIB_VGA_LINEBUFFERS / 2);
+      ctrl->m_lineBuffersNextRow += FABGLIB_VGA_LINEBUFFERS / 2;
+    }
+  }
+
+  I2S1.int_clr.val = I2S1.int_st.val;
+}
+
+
+
+} // end of namespace
@@ -0,0 +1,114 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+
+/**
+ * @file
+ *
+ * @brief This file contains fabgl::VGALineBufferController definition.
+ */
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "esp_intr_alloc.h"
+
+#include "fabglconf.h"
+#include "fabutils.h"
+#include "vgacontroller.h"
+
+
+
+
+namespace fabgl {
+
+
+
+/**
+ * @brief Base class of VGA controllers which generate visible rows just before they are sent
+ *
+ * Visible rows are not sent by DMA from the viewport, but from a ring of FABGLIB_VGA_LINEBUFFERS line buffers.
+ * The I2S interrupt is raised on vertical sync and each time half of line buffers has been sent: derived class
+ * fills the next rows, while DMA sends the other half.<br>
+ * Derived classes allocate (or don't allocate) the viewport and specify the function which fills line buffers.
+ */
+class VGALineBufferController : public VGAController {
+
+public:
+
+  // unwanted methods
+  VGALineBufferController(VGALineBufferController const&) = delete;
+  void operator=(VGALineBufferController const&)          = delete;
+
+  using VGAController::setResolution;
+
+  void setResolution(VGATimings const& timings, int viewPortWidth = -1, int viewPortHeight = -1, bool doubleBuffered = false);
+
+
+protected:
+
+  // Fills "count" line buffers starting from viewport row "row". Called by the I2S interrupt, so it must be in IRAM.
+  // Rows greater or equal than viewport height must be ignored.
+  typedef void (*FillLinesCallback)(VGALineBufferController * controller, int row, int count);
+
+  // interruptFlags: flags of I2S interrupt. Without ESP_INTR_FLAG_IRAM fillLines can read flash, but the interrupt is
+  // delayed while flash is written (and the screen shows garbage)
+  VGALineBufferController(FillLinesCallback fillLines, int interruptFlags = ESP_INTR_FLAG_LEVEL3 | ESP_INTR_FLAG_IRAM);
+
+  void allocateLineBuffers();
+  void freeLineBuffers();
+
+  void setDMABufferBlank(int index, void volatile * address, int length);
+  void setDMABufferView(int index, int row, int scan);
+
+  uint8_t * getLineBuffer(int row) { return (uint8_t *) m_lineBuffers[row % FABGLIB_VGA_LINEBUFFERS]; }
+
+
+  FillLinesCallback      m_fillLines;
+
+  // Row "r" goes into m_lineBuffers[r % FABGLIB_VGA_LINEBUFFERS]
+  volatile uint8_t *     m_lineBuffers[FABGLIB_VGA_LINEBUFFERS];
+
+
+private:
+
+  static void I2SInterrupt(void * arg);
+
+
+  // next viewport row to fill
+  volatile int16_t       m_lineBuffersNextRow;
+
+  int                    m_interruptFlags;
+  intr_handle_t          m_isr_handle;
+
+};
+
+
+
+} // end of namespace
+
+
+
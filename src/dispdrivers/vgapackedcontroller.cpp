@@ -0,0 +1,684 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include <limits.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "fabutils.h"
+#include "vgapackedcontroller.h"
+
+
+
+
+namespace fabgl {
+
+
+
+// calls the template method specialized for current number of bits per pixel
+#define VGAPACKED_DISPATCH(method, ...) \
+  switch (m_bitsPerPixel) { \
+    case 1:  method<VGAPackedFormat<1>>(__VA_ARGS__); break; \
+    case 2:  method<VGAPackedFormat<2>>(__VA_ARGS__); break; \
+    default: method<VGAPackedFormat<4>>(__VA_ARGS__); break; \
+  }
+
+
+// Pixels are palette indexes packed from the most significant bits: leftmost pixel of a byte is bit 7 (1 bit per pixel),
+// bits 7-6 (2 bits per pixel) or bits 7-4 (4 bits per pixel)
+template <int BPP>
+struct VGAPackedFormat {
+  enum { PixelsPerByte = 8 / BPP, Mask = (1 << BPP) - 1 };
+
+  static int shift(int x)                                    { return (PixelsPerByte - 1 - (x & (PixelsPerByte - 1))) * BPP; }
+  static uint8_t getPixel(uint8_t const * row, int x)        { return (row[x / PixelsPerByte] >> shift(x)) & Mask; }
+  static void setPixel(uint8_t * row, int x, uint8_t index)  { uint8_t * b = row + x / PixelsPerByte; *b = (*b & ~(Mask << shift(x))) | (index << shift(x)); }
+  static void invertPixel(uint8_t * row, int x)              { row[x / PixelsPerByte] ^= Mask << shift(x); }
+  static uint8_t pattern(uint8_t index)                      { return index * (0xff / Mask); }  // a byte filled with index
+};
+
+
+
+/*************************************************************************************/
+/* VGAPackedController definitions */
+
+
+// 1 bit per pixel: each nibble (4 pixels) is expanded to 32 bits
+static void IRAM_ATTR expandRow1(uint8_t const * src, uint32_t * dst, int width, uint32_t const * LUT)
+{
+  for (; width >= 8; width -= 8, ++src) {
+    *dst++ = LUT[*src >> 4];
+    *dst++ = LUT[*src & 0x0f];
+  }
+  if (width > 0)
+    *dst = LUT[*src >> 4];
+}
+
+
+// 2 bits per pixel: each byte (4 pixels) is expanded to 32 bits
+static void IRAM_ATTR expandRow2(uint8_t const * src, uint32_t * dst, int width, uint32_t const * LUT)
+{
+  for (; width > 0; width -= 4)
+    *dst++ = LUT[*src++];
+}
+
+
+// 4 bits per pixel: each byte (2 pixels) is expanded to 16 bits. Pixels 0 and 1 are stored in the high 16 bits (see VGA_PIXELINROW)
+// when width is not a multiple of 4 the last byte pair may be incomplete, missing pixels are filled with index 0
+static void IRAM_ATTR expandRow4(uint8_t const * src, uint32_t * dst, int width, uint32_t const * LUT)
+{
+  for (; width >= 4; width -= 4, src += 2)
+    *dst++ = LUT[src[1]] | (LUT[src[0]] << 16);
+  if (width > 0)
+    *dst = LUT[width > 2 ? src[1] : 0] | (LUT[src[0]] << 16);
+}
+
+
+VGAPackedController::VGAPackedController(int bitsPerPixel)
+  : VGALineBufferController(fillLines),
+    m_bitsPerPixel(bitsPerPixel == 1 || bitsPerPixel == 2 ? bitsPerPixel : 4)
+{
+  for (int i = 0; i < 16; ++i)
+    m_palette[i] = RGB888((Color) i);
+  if (m_bitsPerPixel == 1) {
+    m_palette[1] = RGB888(Color::BrightWhite);
+  } else if (m_bitsPerPixel == 2) {
+    m_palette[1] = RGB888(Color::BrightCyan);
+    m_palette[2] = RGB888(Color::BrightMagenta);
+    m_palette[3] = RGB888(Color::BrightWhite);
+  }
+}
+
+
+NativePixelFormat VGAPackedController::nativePixelFormat()
+{
+  switch (m_bitsPerPixel) {
+    case 1:
+      return NativePixelFormat::Palette2;
+    case 2:
+      return NativePixelFormat::Palette4;
+    default:
+      return NativePixelFormat::Palette16;
+  }
+}
+
+
+// packed viewport rows are not sent by DMA, so they don't need DMA capable memory. Only line buffers do.
+void VGAPackedController::allocateViewPort()
+{
+  allocateLineBuffers();
+
+  VGAController::allocateViewPort(MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL, rowLength());
+
+  // the I2S interrupt always expands rows from m_viewPortVisible
+  if (!isDoubleBuffered())
+    m_viewPortVisible = m_viewPort;
+
+  updatePalette();
+
+  // fill view port with palette item 0
+  for (int i = 0; i < m_viewPortHeight; ++i)
+    memset((uint8_t*) m_viewPort[i], 0, rowLength());
+  if (isDoubleBuffered()) {
+    for (int i = 0; i < m_viewPortHeight; ++i)
+      memset((uint8_t*) m_viewPortVisible[i], 0, rowLength());
+  }
+  fillLines(this, 0, FABGLIB_VGA_LINEBUFFERS);
+}
+
+
+void VGAPackedController::freeViewPort()
+{
+  VGAController::freeViewPort();
+  freeLineBuffers();
+}
+
+
+void VGAPackedController::setPaletteItem(int index, RGB888 const & color)
+{
+  if (index >= 0 && index < getPaletteSize()) {
+    m_palette[index] = color;
+    // tables require timings (sync signals polarity), otherwise they are built by setResolution()
+    if (m_lineBuffers[0])
+      updatePalette();
+  }
+}
+
+
+// builds nearest colors map and expansion table
+void VGAPackedController::updatePalette()
+{
+  const int paletteSize = getPaletteSize();
+
+  for (int c = 0; c < 64; ++c) {
+    const int R = (c & 3) * 85;
+    const int G = ((c >> 2) & 3) * 85;
+    const int B = ((c >> 4) & 3) * 85;
+    int minDist = INT_MAX;
+    for (int i = 0; i < paletteSize; ++i) {
+      const int dist = (R - m_palette[i].R) * (R - m_palette[i].R) + (G - m_palette[i].G) * (G - m_palette[i].G) + (B - m_palette[i].B) * (B - m_palette[i].B);
+      if (dist < minDist) {
+        minDist = dist;
+        m_colorToIndex[c] = i;
+      }
+    }
+  }
+
+  uint32_t native[16];
+  for (int i = 0; i < paletteSize; ++i)
+    native[i] = preparePixel(RGB222(m_palette[i]));
+
+  // pixel 0 = byte 2, pixel 1 = byte 3, pixel 2 = byte 0, pixel 3 = byte 1 (see VGA_PIXELINROW)
+  switch (m_bitsPerPixel) {
+    case 1:
+      for (int n = 0; n < 16; ++n)
+        m_lineLUT[n] = native[(n >> 1) & 1] | (native[n & 1] << 8) | (native[n >> 3] << 16) | (native[(n >> 2) & 1] << 24);
+      break;
+    case 2:
+      for (int b = 0; b < 256; ++b)
+        m_lineLUT[b] = native[(b >> 2) & 3] | (native[b & 3] << 8) | (native[b >> 6] << 16) | (native[(b >> 4) & 3] << 24);
+      break;
+    default:
+      for (int b = 0; b < 256; ++b)
+        m_lineLUT[b] = native[b >> 4] | (native[b & 0x0f] << 8);
+      break;
+  }
+}
+
+
+uint8_t IRAM_ATTR VGAPackedController::colorToIndex(RGB888 const & color)
+{
+  RGB222 c(color);
+  return m_colorToIndex[c.R | (c.G << 2) | (c.B << 4)];
+}
+
+
+// expands "count" rows of the visible viewport, starting from "row", into line buffers
+void IRAM_ATTR VGAPackedController::fillLines(VGALineBufferController * controller, int row, int count)
+{
+  auto ctrl = (VGAPackedController *) controller;
+  const int rowEnd = tmin(row + count, (int) ctrl->m_viewPortHeight);
+  for (; row < rowEnd; ++row) {
+    uint8_t const * src = (uint8_t const *) ctrl->m_viewPortVisible[row];
+    uint32_t *      dst = (uint32_t *) ctrl->m_lineBuffers[row % FABGLIB_VGA_LINEBUFFERS];
+    switch (ctrl->m_bitsPerPixel) {
+      case 1:
+        expandRow1(src, dst, ctrl->m_viewPortWidth, ctrl->m_lineLUT);
+        break;
+      case 2:
+        expandRow2(src, dst, ctrl->m_viewPortWidth, ctrl->m_lineLUT);
+        break;
+      default:
+        expandRow4(src, dst, ctrl->m_viewPortWidth, ctrl->m_lineLUT);
+        break;
+    }
+  }
+}
+
+
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedSetPixelAt(PixelDesc const & pixelDesc, Rect & updateRect)
+{
+  genericSetPixelAt(pixelDesc, updateRect,
+                    [&] (RGB888 const & color)        { return colorToIndex(color); },
+                    [&] (int X, int Y, uint8_t index) { TFormat::setPixel((uint8_t*) m_viewPort[Y], X, index); }
+                   );
+}
+
+
+void IRAM_ATTR VGAPackedController::setPixelAt(PixelDesc const & pixelDesc, Rect & updateRect)
+{
+  VGAPACKED_DISPATCH(packedSetPixelAt, pixelDesc, updateRect);
+}
+
+
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedAbsDrawLine(int X1, int Y1, int X2, int Y2, RGB888 color)
+{
+  genericAbsDrawLine(X1, Y1, X2, Y2, color,
+                     [&] (RGB888 const & color)                 { return colorToIndex(color); },
+                     [&] (int Y, int X1, int X2, uint8_t index) { packedRawFillRow<TFormat>(Y, X1, X2, index); },
+                     [&] (int Y, int X1, int X2)                { packedRawInvertRow<TFormat>(Y, X1, X2); },
+                     [&] (int X, int Y, uint8_t index)          { TFormat::setPixel((uint8_t*) m_viewPort[Y], X, index); },
+                     [&] (int X, int Y)                         { TFormat::invertPixel((uint8_t*) m_viewPort[Y], X); }
+                     );
+}
+
+
+// coordinates are absolute values (not relative to origin)
+// line clipped on current absolute clipping rectangle
+void IRAM_ATTR VGAPackedController::absDrawLine(int X1, int Y1, int X2, int Y2, RGB888 color)
+{
+  VGAPACKED_DISPATCH(packedAbsDrawLine, X1, Y1, X2, Y2, color);
+}
+
+
+// parameters not checked
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedRawFillRow(int y, int x1, int x2, uint8_t index)
+{
+  uint8_t * row = (uint8_t*) m_viewPort[y];
+  // fill first pixels before a whole byte
+  int x = x1;
+  for (; x <= x2 && (x % TFormat::PixelsPerByte) != 0; ++x)
+    TFormat::setPixel(row, x, index);
+  // fill whole bytes
+  const int right = (x2 + 1) & ~(TFormat::PixelsPerByte - 1);
+  if (x < right) {
+    memset(row + x / TFormat::PixelsPerByte, TFormat::pattern(index), (right - x) / TFormat::PixelsPerByte);
+    x = right;
+  }
+  // fill last pixels
+  for (; x <= x2; ++x)
+    TFormat::setPixel(row, x, index);
+}
+
+
+// parameters not checked
+void IRAM_ATTR VGAPackedController::rawFillRow(int y, int x1, int x2, RGB888 color)
+{
+  VGAPACKED_DISPATCH(packedRawFillRow, y, x1, x2, colorToIndex(color));
+}
+
+
+// inverts palette indexes
+// parameters not checked
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedRawInvertRow(int y, int x1, int x2)
+{
+  uint8_t * row = (uint8_t*) m_viewPort[y];
+  int x = x1;
+  for (; x <= x2 && (x % TFormat::PixelsPerByte) != 0; ++x)
+    TFormat::invertPixel(row, x);
+  const int right = (x2 + 1) & ~(TFormat::PixelsPerByte - 1);
+  for (; x < right; x += TFormat::PixelsPerByte)
+    row[x / TFormat::PixelsPerByte] ^= 0xff;
+  for (; x <= x2; ++x)
+    TFormat::invertPixel(row, x);
+}
+
+
+// swaps all pixels inside the range x1...x2 of yA and yB
+// parameters not checked
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedSwapRows(int yA, int yB, int x1, int x2)
+{
+  uint8_t * rowA = (uint8_t*) m_viewPort[yA];
+  uint8_t * rowB = (uint8_t*) m_viewPort[yB];
+  int x = x1;
+  for (; x <= x2 && (x % TFormat::PixelsPerByte) != 0; ++x) {
+    const uint8_t a = TFormat::getPixel(rowA, x);
+    TFormat::setPixel(rowA, x, TFormat::getPixel(rowB, x));
+    TFormat::setPixel(rowB, x, a);
+  }
+  const int right = (x2 + 1) & ~(TFormat::PixelsPerByte - 1);
+  for (; x < right; x += TFormat::PixelsPerByte)
+    tswap(rowA[x / TFormat::PixelsPerByte], rowB[x / TFormat::PixelsPerByte]);
+  for (; x <= x2; ++x) {
+    const uint8_t a = TFormat::getPixel(rowA, x);
+    TFormat::setPixel(rowA, x, TFormat::getPixel(rowB, x));
+    TFormat::setPixel(rowB, x, a);
+  }
+}
+
+
+// copies all pixels inside the range x1...x2 of srcY to dstY
+// parameters not checked
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedCopyRow(int x1, int x2, int srcY, int dstY)
+{
+  uint8_t * src = (uint8_t*) m_viewPort[srcY];
+  uint8_t * dst = (uint8_t*) m_viewPort[dstY];
+  int x = x1;
+  for (; x <= x2 && (x % TFormat::PixelsPerByte) != 0; ++x)
+    TFormat::setPixel(dst, x, TFormat::getPixel(src, x));
+  const int right = (x2 + 1) & ~(TFormat::PixelsPerByte - 1);
+  if (x < right) {
+    memcpy(dst + x / TFormat::PixelsPerByte, src + x / TFormat::PixelsPerByte, (right - x) / TFormat::PixelsPerByte);
+    x = right;
+  }
+  for (; x <= x2; ++x)
+    TFormat::setPixel(dst, x, TFormat::getPixel(src, x));
+}
+
+
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedDrawEllipse(Size const & size, Rect & updateRect)
+{
+  genericDrawEllipse(size, updateRect,
+                     [&] (RGB888 const & color)        { return colorToIndex(color); },
+                     [&] (int X, int Y, uint8_t index) { TFormat::setPixel((uint8_t*) m_viewPort[Y], X, index); }
+                    );
+}
+
+
+void IRAM_ATTR VGAPackedController::drawEllipse(Size const & size, Rect & updateRect)
+{
+  VGAPACKED_DISPATCH(packedDrawEllipse, size, updateRect);
+}
+
+
+void IRAM_ATTR VGAPackedController::clear(Rect & updateRect)
+{
+  hideSprites(updateRect);
+  // replicate palette index to the whole byte
+  uint8_t pattern = colorToIndex(getActualBrushColor());
+  for (int bits = m_bitsPerPixel; bits < 8; bits *= 2)
+    pattern |= pattern << bits;
+  const int rowlen = rowLength();
+  if (m_viewPortContiguous)
+    memset((uint8_t*) m_viewPort[0], pattern, rowlen * m_viewPortHeight);
+  else {
+    for (int y = 0; y < m_viewPortHeight; ++y)
+      memset((uint8_t*) m_viewPort[y], pattern, rowlen);
+  }
+}
+
+
+// DMA descriptors point to line buffers, so swapping rows pointers doesn't require to reassign them
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedVScroll(int scroll, Rect & updateRect)
+{
+  if (m_viewPortContiguous) {
+    genericVScroll(scroll, updateRect,
+                   [&] (int x1, int x2, int srcY, int dstY)  { packedCopyRow<TFormat>(x1, x2, srcY, dstY); },                 // rawCopyRow
+                   [&] (int y, int x1, int x2, RGB888 color) { packedRawFillRow<TFormat>(y, x1, x2, colorToIndex(color)); }   // rawFillRow
+                  );
+  } else {
+    genericVScroll(scroll, updateRect,
+                   [&] (int yA, int yB, int x1, int x2)      { packedSwapRows<TFormat>(yA, yB, x1, x2); },                    // swapRowsCopying
+                   [&] (int yA, int yB)                      { tswap(m_viewPort[yA], m_viewPort[yB]); },                      // swapRowsPointers
+                   [&] (int y, int x1, int x2, RGB888 color) { packedRawFillRow<TFormat>(y, x1, x2, colorToIndex(color)); }   // rawFillRow
+                  );
+  }
+}
+
+
+// scroll < 0 -> scroll UP
+// scroll > 0 -> scroll DOWN
+void IRAM_ATTR VGAPackedController::VScroll(int scroll, Rect & updateRect)
+{
+  VGAPACKED_DISPATCH(packedVScroll, scroll, updateRect);
+}
+
+
+// Scrolling region and scroll amount aligned to whole bytes move bytes, otherwise pixels are moved one at the time
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedHScroll(int scroll, Rect & updateRect)
+{
+  const int Y1 = paintState().scrollingRegion.Y1;
+  const int Y2 = paintState().scrollingRegion.Y2;
+  const int X1 = paintState().scrollingRegion.X1;
+  const int X2 = paintState().scrollingRegion.X2;
+
+  const int PixelsPerByte = TFormat::PixelsPerByte;
+
+  if ((X1 % PixelsPerByte) == 0 && ((X2 + 1) % PixelsPerByte) == 0 && (scroll % PixelsPerByte) == 0) {
+    hideSprites(updateRect);
+    const uint8_t pattern = TFormat::pattern(colorToIndex(getActualBrushColor()));
+    const int width = (X2 - X1 + 1) / PixelsPerByte;
+    const int s     = tmin(abs(scroll) / PixelsPerByte, width);
+    for (int y = Y1; y <= Y2; ++y) {
+      uint8_t * row = (uint8_t*) m_viewPort[y] + X1 / PixelsPerByte;
+      if (scroll < 0) {
+        // scroll left
+        memmove(row, row + s, width - s);
+        memset(row + width - s, pattern, s);
+      } else {
+        // scroll right
+        memmove(row + s, row, width - s);
+        memset(row, pattern, s);
+      }
+    }
+  } else {
+    genericHScroll(scroll, updateRect,
+                   [&] (RGB888 const & color)               { return colorToIndex(color); },         // preparePixel
+                   [&] (int y)                              { return (uint8_t*) m_viewPort[y]; },    // rawGetRow
+                   [&] (uint8_t * row, int x)               { return TFormat::getPixel(row, x); },   // rawGetPixelInRow
+                   [&] (uint8_t * row, int x, uint8_t index) { TFormat::setPixel(row, x, index); }   // rawSetPixelInRow
+                  );
+  }
+}
+
+
+void IRAM_ATTR VGAPackedController::HScroll(int scroll, Rect & updateRect)
+{
+  VGAPACKED_DISPATCH(packedHScroll, scroll, updateRect);
+}
+
+
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedDrawGlyph(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect)
+{
+  genericDrawGlyph(glyph, glyphOptions, penColor, brushColor, updateRect,
+                   [&] (RGB888 const & color)                { return colorToIndex(color); },
+                   [&] (int y)                               { return (uint8_t*) m_viewPort[y]; },
+                   [&] (uint8_t * row, int x, uint8_t index) { TFormat::setPixel(row, x, index); }
+                  );
+}
+
+
+void IRAM_ATTR VGAPackedController::drawGlyph(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect)
+{
+  VGAPACKED_DISPATCH(packedDrawGlyph, glyph, glyphOptions, penColor, brushColor, updateRect);
+}
+
+
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedInvertRect(Rect const & rect, Rect & updateRect)
+{
+  genericInvertRect(rect, updateRect,
+                    [&] (int Y, int X1, int X2) { packedRawInvertRow<TFormat>(Y, X1, X2); }
+                   );
+}
+
+
+void IRAM_ATTR VGAPackedController::invertRect(Rect const & rect, Rect & updateRect)
+{
+  VGAPACKED_DISPATCH(packedInvertRect, rect, updateRect);
+}
+
+
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedSwapFGBG(Rect const & rect, Rect & updateRect)
+{
+  genericSwapFGBG(rect, updateRect,
+                  [&] (RGB888 const & color) { return colorToIndex(color); },
+                  [&] (int y, int x1, int x2, uint8_t pen, uint8_t brush) {
+                    uint8_t * row = (uint8_t*) m_viewPort[y];
+                    for (int x = x1; x <= x2; ++x) {
+                      const uint8_t index = TFormat::getPixel(row, x);
+                      if (index == pen)
+                        TFormat::setPixel(row, x, brush);
+                      else if (index == brush)
+                        TFormat::setPixel(row, x, pen);
+                    }
+                  }
+                 );
+}
+
+
+void IRAM_ATTR VGAPackedController::swapFGBG(Rect const & rect, Rect & updateRect)
+{
+  VGAPACKED_DISPATCH(packedSwapFGBG, rect, updateRect);
+}
+
+
+// Slow operation!
+// supports overlapping of source and dest rectangles
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedCopyRect(Rect const & source, Rect & updateRect)
+{
+  genericCopyRect(source, updateRect,
+                  [&] (int y)                               { return (uint8_t*) m_viewPort[y]; },
+                  [&] (uint8_t * row, int x)                { return TFormat::getPixel(row, x); },
+                  [&] (uint8_t * row, int x, uint8_t index) { TFormat::setPixel(row, x, index); }
+                 );
+}
+
+
+void IRAM_ATTR VGAPackedController::copyRect(Rect const & source, Rect & updateRect)
+{
+  VGAPACKED_DISPATCH(packedCopyRect, source, updateRect);
+}
+
+
+template <typename TFormat>
+void VGAPackedController::packedReadScreen(Rect const & rect, RGB888 * destBuf)
+{
+  for (int y = rect.Y1; y <= rect.Y2; ++y) {
+    uint8_t * row = (uint8_t*) m_viewPort[y];
+    for (int x = rect.X1; x <= rect.X2; ++x, ++destBuf)
+      *destBuf = m_palette[TFormat::getPixel(row, x)];
+  }
+}
+
+
+// no bounds check is done!
+void VGAPackedController::readScreen(Rect const & rect, RGB888 * destBuf)
+{
+  VGAPACKED_DISPATCH(packedReadScreen, rect, destBuf);
+}
+
+
+template <typename TFormat>
+void VGAPackedController::packedReadScreen(Rect const & rect, RGB222 * destBuf)
+{
+  for (int y = rect.Y1; y <= rect.Y2; ++y) {
+    uint8_t * row = (uint8_t*) m_viewPort[y];
+    for (int x = rect.X1; x <= rect.X2; ++x, ++destBuf)
+      *destBuf = RGB222(m_palette[TFormat::getPixel(row, x)]);
+  }
+}
+
+
+// no bounds check is done!
+void VGAPackedController::readScreen(Rect const & rect, RGB222 * destBuf)
+{
+  VGAPACKED_DISPATCH(packedReadScreen, rect, destBuf);
+}
+
+
+template <typename TFormat>
+void VGAPackedController::packedWriteScreen(Rect const & rect, RGB222 * srcBuf)
+{
+  for (int y = rect.Y1; y <= rect.Y2; ++y) {
+    uint8_t * row = (uint8_t*) m_viewPort[y];
+    for (int x = rect.X1; x <= rect.X2; ++x, ++srcBuf)
+      TFormat::setPixel(row, x, colorToIndex(RGB888(srcBuf->R * 85, srcBuf->G * 85, srcBuf->B * 85)));
+  }
+}
+
+
+// no bounds check is done!
+void VGAPackedController::writeScreen(Rect const & rect, RGB222 * srcBuf)
+{
+  VGAPACKED_DISPATCH(packedWriteScreen, rect, srcBuf);
+}
+
+
+// no bounds check is done!
+void VGAPackedController::setRawPixel(int x, int y, uint8_t rgb)
+{
+  RGB222 color(rgb & 3, (rgb >> 2) & 3, (rgb >> 4) & 3);
+  writeScreen(Rect(x, y, x, y), &color);
+}
+
+
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedRawDrawBitmap_Native(int destX, int destY, Bitmap const * bitmap, int X1, int Y1, int XCount, int YCount)
+{
+  genericRawDrawBitmap_Native(destX, destY, (uint8_t*) bitmap->data, bitmap->width, X1, Y1, XCount, YCount,
+                              [&] (int y)                               { return (uint8_t*) m_viewPort[y]; },   // rawGetRow
+                              [&] (uint8_t * row, int x, uint8_t index) { TFormat::setPixel(row, x, index); }   // rawSetPixelInRow
+                             );
+}
+
+
+void IRAM_ATTR VGAPackedController::rawDrawBitmap_Native(int destX, int destY, Bitmap const * bitmap, int X1, int Y1, int XCount, int YCount)
+{
+  VGAPACKED_DISPATCH(packedRawDrawBitmap_Native, destX, destY, bitmap, X1, Y1, XCount, YCount);
+}
+
+
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedRawDrawBitmap_Mask(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  const uint8_t foregroundIndex = colorToIndex(bitmap->foregroundColor);
+  genericRawDrawBitmap_Mask(destX, destY, bitmap, (uint8_t*)saveBackground, X1, Y1, XCount, YCount,
+                            [&] (int y)                { return (uint8_t*) m_viewPort[y]; },                 // rawGetRow
+                            [&] (uint8_t * row, int x) { return TFormat::getPixel(row, x); },                // rawGetPixelInRow
+                            [&] (uint8_t * row, int x) { TFormat::setPixel(row, x, foregroundIndex); }       // rawSetPixelInRow
+                           );
+}
+
+
+void IRAM_ATTR VGAPackedController::rawDrawBitmap_Mask(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  VGAPACKED_DISPATCH(packedRawDrawBitmap_Mask, destX, destY, bitmap, saveBackground, X1, Y1, XCount, YCount);
+}
+
+
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedRawDrawBitmap_RGBA2222(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  genericRawDrawBitmap_RGBA2222(destX, destY, bitmap, (uint8_t*)saveBackground, X1, Y1, XCount, YCount,
+                                [&] (int y)                             { return (uint8_t*) m_viewPort[y]; },                          // rawGetRow
+                                [&] (uint8_t * row, int x)              { return TFormat::getPixel(row, x); },                         // rawGetPixelInRow
+                                [&] (uint8_t * row, int x, uint8_t src) { TFormat::setPixel(row, x, m_colorToIndex[src & 0x3f]); }     // rawSetPixelInRow
+                               );
+}
+
+
+void IRAM_ATTR VGAPackedController::rawDrawBitmap_RGBA2222(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  VGAPACKED_DISPATCH(packedRawDrawBitmap_RGBA2222, destX, destY, bitmap, saveBackground, X1, Y1, XCount, YCount);
+}
+
+
+template <typename TFormat>
+void IRAM_ATTR VGAPackedController::packedRawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  genericRawDrawBitmap_RGBA8888(destX, destY, bitmap, (uint8_t*)saveBackground, X1, Y1, XCount, YCount,
+                                 [&] (int y)                                      { return (uint8_t*) m_viewPort[y]; },    // rawGetRow
+                                 [&] (uint8_t * row, int x)                       { return TFormat::getPixel(row, x); },   // rawGetPixelInRow
+                                 [&] (uint8_t * row, int x, RGBA8888 const & src) { TFormat::setPixel(row, x, m_colorToIndex[(src.R >> 6) | (src.G >> 6 << 2) | (src.B >> 6 << 4)]); }   // rawSetPixelInRow
+                                );
+}
+
+
+void IRAM_ATTR VGAPackedController::rawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount)
+{
+  VGAPACKED_DISPATCH(packedRawDrawBitmap_RGBA8888, destX, destY, bitmap, saveBackground, X1, Y1, XCount, YCount);
+}
+
+
+// DMA descriptors point to line buffers and the I2S interrupt expands m_viewPortVisible rows, so only rows pointers are swapped
+void IRAM_ATTR VGAPackedController::swapBuffers()
+{
+  tswap(m_viewPort, m_viewPortVisible);
+}
+
+
+
+} // end of namespace
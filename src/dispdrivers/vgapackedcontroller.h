@@ -0,0 +1,245 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+
+/**
+ * @file
+ *
+ * @brief This file contains fabgl::VGAPackedController definition.
+ */
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "fabglconf.h"
+#include "fabutils.h"
+#include "displaycontroller.h"
+#include "vgalinebuffercontroller.h"
+
+
+
+
+namespace fabgl {
+
+
+
+/**
+ * @brief Represents the VGA controller with palette based packed pixels
+ *
+ * VGAPackedController stores each pixel as an index of a palette of 2, 4 or 16 colors, using 1, 2 or 4 bits per pixel, instead
+ * of the byte per pixel used by VGAController. The packed viewport is not sent directly by DMA: an I2S interrupt expands
+ * rows, a few at the time, into FABGLIB_VGA_LINEBUFFERS DMA line buffers just before they are displayed.<br>
+ * This makes possible high resolutions and double buffering with limited memory. For example 640x480 with 16 colors
+ * requires 150KB (300KB with VGAController), and can be double buffered with 4 colors.<br>
+ * Palette items can be changed at any time using setPaletteItem(). Colors specified in drawing primitives are
+ * converted to the nearest palette item.<br>
+ * Native bitmaps contain one palette index per byte.
+ *
+ * This example initializes a 16 colors 640x480 VGA display:
+ *
+ *     fabgl::VGAPackedController VGAController(4);
+ *
+ *     VGAController.begin();
+ *     VGAController.setResolution(VGA_640x480_60Hz);
+ */
+class VGAPackedController : public VGALineBufferController {
+
+public:
+
+  /**
+   * @brief Initializes a new instance of VGAPackedController
+   *
+   * @param bitsPerPixel Number of bits per pixel: 1 (2 colors), 2 (4 colors) or 4 (16 colors).
+   */
+  VGAPackedController(int bitsPerPixel = 4);
+
+  // unwanted methods
+  VGAPackedController(VGAPackedController const&) = delete;
+  void operator=(VGAPackedController const&)      = delete;
+
+  // abstract method of DisplayController
+  NativePixelFormat nativePixelFormat();
+
+  /**
+   * @brief Determines the number of bits used for each pixel
+   *
+   * @return 1 (2 colors), 2 (4 colors) or 4 (16 colors).
+   */
+  int getBitsPerPixel()  { return m_bitsPerPixel; }
+
+  /**
+   * @brief Determines the number of palette items
+   *
+   * @return 2, 4 or 16.
+   */
+  int getPaletteSize()   { return 1 << m_bitsPerPixel; }
+
+  /**
+   * @brief Sets a palette item
+   *
+   * Default palette is Black and BrightWhite for 2 colors, Black, BrightCyan, BrightMagenta and BrightWhite for 4 colors,
+   * all the Color enum values for 16 colors.<br>
+   * Pixels already painted with the specified index change color on the next frame.
+   *
+   * @param index Palette index (0 to getPaletteSize() - 1).
+   * @param color Item color.
+   *
+   * Example:
+   *
+   *     // items 0 and 1 are dark blue and yellow
+   *     VGAController.setPaletteItem(0, RGB888(0, 0, 128));
+   *     VGAController.setPaletteItem(1, RGB888(255, 255, 0));
+   */
+  void setPaletteItem(int index, RGB888 const & color);
+
+  /**
+   * @brief Gets a palette item
+   *
+   * @param index Palette index (0 to getPaletteSize() - 1).
+   *
+   * @return Item color.
+   */
+  RGB888 getPaletteItem(int index) { return m_palette[index]; }
+
+  void readScreen(Rect const & rect, RGB888 * destBuf);
+
+  void readScreen(Rect const & rect, RGB222 * destBuf);
+
+  void writeScreen(Rect const & rect, RGB222 * srcBuf);
+
+  // the raw pixel color is converted to the nearest palette index
+  void setRawPixel(int x, int y, uint8_t rgb);
+
+  // rows contain packed palette indexes, not raw pixels: always returns nullptr
+  uint8_t * getScanline(int y) { return nullptr; }
+
+
+protected:
+
+  void allocateViewPort();
+  void freeViewPort();
+
+
+private:
+
+  int rowLength() { return (m_viewPortWidth * m_bitsPerPixel + 7) / 8; }
+
+  uint8_t colorToIndex(RGB888 const & color);
+
+  void updatePalette();
+
+  static void fillLines(VGALineBufferController * controller, int row, int count);
+
+  // abstract method of DisplayController
+  void setPixelAt(PixelDesc const & pixelDesc, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void absDrawLine(int X1, int Y1, int X2, int Y2, RGB888 color);
+
+  // abstract method of DisplayController
+  void rawFillRow(int y, int x1, int x2, RGB888 color);
+
+  // abstract method of DisplayController
+  void drawEllipse(Size const & size, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void clear(Rect & updateRect);
+
+  // abstract method of DisplayController
+  void VScroll(int scroll, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void HScroll(int scroll, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void drawGlyph(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void invertRect(Rect const & rect, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void copyRect(Rect const & source, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void swapFGBG(Rect const & rect, Rect & updateRect);
+
+  // abstract method of DisplayController
+  void swapBuffers();
+
+  // abstract method of DisplayController
+  void rawDrawBitmap_Native(int destX, int destY, Bitmap const * bitmap, int X1, int Y1, int XCount, int YCount);
+
+  // abstract method of DisplayController
+  void rawDrawBitmap_Mask(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+
+  // abstract method of DisplayController
+  void rawDrawBitmap_RGBA2222(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+
+  // abstract method of DisplayController
+  void rawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+
+  // overridable method of DisplayController
+  bool rawColorToNative(RGB888 const & color, void * dest) { return false; }
+
+  template <typename TFormat> void packedSetPixelAt(PixelDesc const & pixelDesc, Rect & updateRect);
+  template <typename TFormat> void packedAbsDrawLine(int X1, int Y1, int X2, int Y2, RGB888 color);
+  template <typename TFormat> void packedRawFillRow(int y, int x1, int x2, uint8_t index);
+  template <typename TFormat> void packedRawInvertRow(int y, int x1, int x2);
+  template <typename TFormat> void packedSwapRows(int yA, int yB, int x1, int x2);
+  template <typename TFormat> void packedCopyRow(int x1, int x2, int srcY, int dstY);
+  template <typename TFormat> void packedDrawEllipse(Size const & size, Rect & updateRect);
+  template <typename TFormat> void packedVScroll(int scroll, Rect & updateRect);
+  template <typename TFormat> void packedHScroll(int scroll, Rect & updateRect);
+  template <typename TFormat> void packedDrawGlyph(Glyph const & glyph, GlyphOptions glyphOptions, RGB888 penColor, RGB888 brushColor, Rect & updateRect);
+  template <typename TFormat> void packedInvertRect(Rect const & rect, Rect & updateRect);
+  template <typename TFormat> void packedCopyRect(Rect const & source, Rect & updateRect);
+  template <typename TFormat> void packedSwapFGBG(Rect const & rect, Rect & updateRect);
+  template <typename TFormat> void packedReadScreen(Rect const & rect, RGB888 * destBuf);
+  template <typename TFormat> void packedReadScreen(Rect const & rect, RGB222 * destBuf);
+  template <typename TFormat> void packedWriteScreen(Rect const & rect, RGB222 * srcBuf);
+  template <typename TFormat> void packedRawDrawBitmap_Native(int destX, int destY, Bitmap const * bitmap, int X1, int Y1, int XCount, int YCount);
+  template <typename TFormat> void packedRawDrawBitmap_Mask(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+  template <typename TFormat> void packedRawDrawBitmap_RGBA2222(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+  template <typename TFormat> void packedRawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount);
+
+
+  int8_t                 m_bitsPerPixel;
+
+  RGB888                 m_palette[16];
+
+  // maps RGB222 colors (R | G << 2 | B << 4) to the nearest palette item
+  uint8_t                m_colorToIndex[64];
+
+  // expands packed bytes (or nibbles when 1 bit per pixel) to native pixels (with sync signals), already ordered as VGA_PIXELINROW
+  uint32_t               m_lineLUT[256];
+
+};
+
+
+
+} // end of namespace
+
+
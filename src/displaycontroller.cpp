@@ -25,9 +25,11 @@
 
 #include <string.h>
 #include <limits.h>
-#include <math.h>
 
 #include "freertos/task.h"
+#if FABGLIB_PRIMITIVES_PROFILER
+#include "rom/ets_sys.h"
+#endif
 
 #include "fabutils.h"
 #include "images/cursors.h"
@@ -83,6 +85,22 @@ const RGB888 COLOR2RGB888[16] = {
 };
 
 
+// Names of PrimitiveCmd values
+static char const * PRIMITIVECMD_NAMES[PRIMITIVECMD_COUNT] = {
+  "Flush", "Refresh", "SetPenColor", "SetBrushColor", "SetPixel", "SetPixelAt", "MoveTo", "LineTo",
+  "FillRect", "DrawRect", "FillEllipse", "DrawEllipse", "Clear", "VScroll", "HScroll", "DrawGlyph",
+  "SetGlyphOptions", "SetPaintOptions", "InvertRect", "CopyRect", "SetScrollingRegion", "SwapFGBG", "RenderGlyphsBuffer", "DrawBitmap",
+  "RefreshSprites", "SwapBuffers", "FillPath", "DrawPath", "SetOrigin", "SetClippingRect", "SetPenWidth", "SetLineEnds",
+  "DrawTileMap", "ScrollTileMap", "ExecuteRecording", "ExecuteBatch",
+};
+
+
+char const * primitiveCmdName(PrimitiveCmd cmd)
+{
+  return cmd < PRIMITIVECMD_COUNT ? PRIMITIVECMD_NAMES[cmd] : "Unknown";
+}
+
+
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////////////////////////
@@ -234,7 +252,8 @@ Bitmap::Bitmap(int width_, int height_, void const * data_, PixelFormat format_,
     format(format_),
     foregroundColor(foregroundColor_),
     data((uint8_t*)data_),
-    dataAllocated(false)
+    dataAllocated(false),
+    runs(nullptr)
 {
   if (copy) {
     allocate();
@@ -343,10 +362,260 @@ int Bitmap::getAlpha(int x, int y)
 }
 
 
+// allocated data is copied, runs aren't (the copy is not prepared)
+Bitmap::Bitmap(Bitmap const & bitmap)
+  : width(0),
+    height(0),
+    format(PixelFormat::Undefined),
+    data(nullptr),
+    dataAllocated(false),
+    runs(nullptr)
+{
+  *this = bitmap;
+}
+
+
 Bitmap::~Bitmap()
 {
   if (dataAllocated)
     free((void*)data);
+  free(runs);
+}
+
+
+// allocated data is copied, runs aren't (the copy is not prepared). Data and runs of this bitmap are released
+Bitmap & Bitmap::operator=(Bitmap const & bitmap)
+{
+  if (this != &bitmap) {
+    if (dataAllocated)
+      free((void*)data);
+    free(runs);
+    width           = bitmap.width;
+    height          = bitmap.height;
+    format          = bitmap.format;
+    foregroundColor = bitmap.foregroundColor;
+    data            = bitmap.data;
+    dataAllocated   = false;
+    runs            = nullptr;
+    if (bitmap.dataAllocated) {
+      allocate();
+      if (data)
+        copyFrom(bitmap.data);
+    }
+  }
+  return *this;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// DirtyRegion implementation
+
+
+static int rectArea(Rect const & rect)
+{
+  return rect.width() * rect.height();
+}
+
+
+void DirtyRegion::add(Rect const & rect)
+{
+  if (rect.X1 > rect.X2 || rect.Y1 > rect.Y2)
+    return;
+
+  Rect r = rect;
+
+  while (true) {
+
+    // merge with overlapping rectangles or when merging costs less than sending them separately
+    // restart after every merge because the merged rectangle may overlap already checked ones
+    for (int i = 0; i < m_count; ) {
+      Rect merged = m_rects[i].merge(r);
+      if (m_rects[i].intersects(r) || rectArea(merged) - rectArea(m_rects[i]) - rectArea(r) <= m_mergeCost) {
+        r = merged;
+        remove(i);
+        i = 0;
+      } else
+        ++i;
+    }
+
+    if (m_count < DIRTYREGION_MAX_RECTS)
+      break;
+
+    // list full, merge with the rectangle that produces the smallest waste
+    int best = 0, bestWaste = INT_MAX;
+    for (int i = 0; i < m_count; ++i) {
+      int waste = rectArea(m_rects[i].merge(r)) - rectArea(m_rects[i]) - rectArea(r);
+      if (waste < bestWaste) {
+        best      = i;
+        bestWaste = waste;
+      }
+    }
+    r = m_rects[best].merge(r);
+    remove(best);
+  }
+
+  m_rects[m_count++] = r;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////////////////////////
+// PrimitiveRecording implementation
+
+
+// state commands only change the paint state: when followed by the same command (without drawings in between) they have no effect
+static bool isStateCmd(PrimitiveCmd cmd)
+{
+  switch (cmd) {
+    case PrimitiveCmd::SetPenColor:
+    case PrimitiveCmd::SetBrushColor:
+    case PrimitiveCmd::SetGlyphOptions:
+    case PrimitiveCmd::SetPaintOptions:
+    case PrimitiveCmd::SetScrollingRegion:
+    case PrimitiveCmd::SetOrigin:
+    case PrimitiveCmd::SetClippingRect:
+    case PrimitiveCmd::SetPenWidth:
+    case PrimitiveCmd::SetLineEnds:
+      return true;
+    default:
+      return false;
+  }
+}
+
+
+// a and b must be the same state command
+static bool sameState(Primitive const & a, Primitive const & b)
+{
+  switch (a.cmd) {
+    case PrimitiveCmd::SetPenColor:
+    case PrimitiveCmd::SetBrushColor:
+      return a.color == b.color;
+    case PrimitiveCmd::SetGlyphOptions:
+      return a.glyphOptions.value == b.glyphOptions.value;
+    case PrimitiveCmd::SetPaintOptions:
+      return a.paintOptions.swapFGBG == b.paintOptions.swapFGBG && a.paintOptions.NOT == b.paintOptions.NOT;
+    case PrimitiveCmd::SetOrigin:
+      return a.position.X == b.position.X && a.position.Y == b.position.Y;
+    case PrimitiveCmd::SetScrollingRegion:
+    case PrimitiveCmd::SetClippingRect:
+      return a.rect.X1 == b.rect.X1 && a.rect.Y1 == b.rect.Y1 && a.rect.X2 == b.rect.X2 && a.rect.Y2 == b.rect.Y2;
+    case PrimitiveCmd::SetPenWidth:
+      return a.ivalue == b.ivalue;
+    case PrimitiveCmd::SetLineEnds:
+      return a.lineEnds == b.lineEnds;
+    default:
+      return false;
+  }
+}
+
+
+PrimitiveRecording::PrimitiveRecording()
+  : m_primitives(nullptr),
+    m_count(0),
+    m_capacity(0),
+    m_points(nullptr),
+    m_pointsCount(0),
+    m_maxFillPathPoints(0),
+    m_stateCmdsStart(0)
+{
+  for (int i = 0; i < PRIMITIVECMD_COUNT; ++i)
+    m_lastState[i] = -1;
+}
+
+
+PrimitiveRecording::~PrimitiveRecording()
+{
+  free(m_primitives);
+  free(m_points);
+}
+
+
+// returns false when memory is not enough
+bool PrimitiveRecording::add(Primitive const & primitive)
+{
+  const bool stateCmd = isStateCmd(primitive.cmd);
+
+  if (stateCmd) {
+    const int last = m_lastState[primitive.cmd];
+    // already the current value?
+    if (last >= 0 && sameState(m_primitives[last], primitive))
+      return true;
+    // previous value not used by any drawing?
+    if (last >= m_stateCmdsStart)
+      remove(last);
+  }
+
+  // Primitive is a union of plain data, so it can be moved as raw memory
+  if (m_count == m_capacity) {
+    const int capacity = m_capacity ? m_capacity * 2 : 16;
+    void * primitives = realloc((void*)m_primitives, capacity * sizeof(Primitive));
+    if (!primitives)
+      return false;
+    m_primitives = (Primitive *) primitives;
+    m_capacity   = capacity;
+  }
+
+  if (primitive.cmd == PrimitiveCmd::DrawPath || primitive.cmd == PrimitiveCmd::FillPath) {
+    void * points = realloc(m_points, (m_pointsCount + primitive.path.pointsCount) * sizeof(Point));
+    if (!points)
+      return false;
+    m_points = (Point *) points;
+  }
+
+  Primitive & p = m_primitives[m_count];
+  p = primitive;
+
+  if (p.cmd == PrimitiveCmd::DrawPath || p.cmd == PrimitiveCmd::FillPath) {
+    memcpy(m_points + m_pointsCount, p.path.points, p.path.pointsCount * sizeof(Point));
+    p.path.points     = (Point const *) (intptr_t) m_pointsCount;
+    p.path.freePoints = false;
+    m_pointsCount += p.path.pointsCount;
+  }
+
+  if (p.cmd == PrimitiveCmd::FillPath)
+    m_maxFillPathPoints = tmax(m_maxFillPathPoints, p.path.pointsCount);
+  else if (p.cmd == PrimitiveCmd::ExecuteRecording)
+    m_maxFillPathPoints = tmax(m_maxFillPathPoints, p.recordingPlayInfo.recording->m_maxFillPathPoints);
+
+  if (stateCmd)
+    m_lastState[p.cmd] = m_count;
+  else
+    m_stateCmdsStart = m_count + 1;
+  ++m_count;
+  return true;
+}
+
+
+// index must be a state command after m_stateCmdsStart
+void PrimitiveRecording::remove(int index)
+{
+  memmove((void*)(m_primitives + index), (void*)(m_primitives + index + 1), (m_count - index - 1) * sizeof(Primitive));
+  --m_count;
+  for (int i = 0; i < PRIMITIVECMD_COUNT; ++i)
+    if (m_lastState[i] > index)
+      --m_lastState[i];
+}
+
+
+// releases unused space and converts paths points offsets to pointers
+void PrimitiveRecording::finalize()
+{
+  if (m_count < m_capacity && m_count > 0) {
+    // shrinking can't fail, but keep the larger buffer if it does
+    void * primitives = realloc((void*)m_primitives, m_count * sizeof(Primitive));
+    if (primitives) {
+      m_primitives = (Primitive *) primitives;
+      m_capacity   = m_count;
+    }
+  }
+  for (int i = 0; i < m_count; ++i) {
+    Primitive & p = m_primitives[i];
+    if (p.cmd == PrimitiveCmd::DrawPath || p.cmd == PrimitiveCmd::FillPath)
+      p.path.points = m_points + (intptr_t) p.path.points;
+  }
 }
 
 
@@ -359,7 +628,17 @@ Bitmap::~Bitmap()
 DisplayController::DisplayController()
   : m_primDynMemPool(FABGLIB_PRIMITIVES_DYNBUFFERS_SIZE)
 {
+  #if FABGLIB_EXEC_QUEUE_LOCKFREE
+  m_execQueue                = (Primitive*) heap_caps_malloc((FABGLIB_EXEC_QUEUE_SIZE + 1) * sizeof(Primitive), MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+  m_execQueueHead            = 0;
+  m_execQueueTail            = 0;
+  m_execQueueProducerWaiting = false;
+  m_execQueueConsumerWaiting = false;
+  m_execQueueNotFull         = xSemaphoreCreateBinary();
+  m_execQueueNotEmpty        = xSemaphoreCreateBinary();
+  #else
   m_execQueue = xQueueCreate(FABGLIB_EXEC_QUEUE_SIZE, sizeof(Primitive));
+  #endif
 
   m_backgroundPrimitiveExecutionEnabled = true;
   m_sprites                             = nullptr;
@@ -368,12 +647,43 @@ DisplayController::DisplayController()
   m_mouseCursor.visible                 = false;
   m_backgroundPrimitiveTimeoutEnabled   = true;
   m_spritesHidden                       = true;
+  m_spritesHiddenRect                   = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+  m_batch                               = nullptr;
+  m_batchCount                          = 0;
+  m_batchLevel                          = 0;
+  m_batchMemPool                        = nullptr;
+  m_execBatch                           = nullptr;
+  m_execBatchCount                      = 0;
+  m_execBatchIndex                      = 0;
+  m_recording                           = nullptr;
+  m_recordingFailed                     = false;
+  m_playOrigin                          = Point(0, 0);
+  m_primitivesOptimizerEnabled          = false;
+  m_pendingFill                         = false;
+  m_fillPathEdges                       = (FillPathEdge *) heap_caps_malloc(FABGLIB_FILLPATH_MIN_EDGES * sizeof(FillPathEdge), MALLOC_CAP_32BIT | MALLOC_CAP_INTERNAL);
+  m_fillPathActive                      = (FillPathEdge * *) heap_caps_malloc(FABGLIB_FILLPATH_MIN_EDGES * sizeof(FillPathEdge *), MALLOC_CAP_32BIT | MALLOC_CAP_INTERNAL);
+  m_fillPathEdgesSize                   = m_fillPathEdges && m_fillPathActive ? FABGLIB_FILLPATH_MIN_EDGES : 0;
+
+  #if FABGLIB_PRIMITIVES_PROFILER
+  resetPrimitivesProfile();
+  #endif
 }
 
 
 DisplayController::~DisplayController()
 {
+  #if FABGLIB_EXEC_QUEUE_LOCKFREE
+  heap_caps_free(m_execQueue);
+  vSemaphoreDelete(m_execQueueNotFull);
+  vSemaphoreDelete(m_execQueueNotEmpty);
+  #else
   vQueueDelete(m_execQueue);
+  #endif
+  free(m_batch);
+  delete m_batchMemPool;
+  delete m_recording;
+  heap_caps_free(m_fillPathEdges);
+  heap_caps_free(m_fillPathActive);
 }
 
 
@@ -390,15 +700,28 @@ void DisplayController::resetPaintState()
   m_paintState.absClippingRect       = m_paintState.clippingRect;
   m_paintState.penWidth              = 1;
   m_paintState.lineEnds              = LineEnds::None;
+
+  m_pendingFill = false;
 }
 
 
 void DisplayController::addPrimitive(Primitive & primitive)
 {
+  if (m_recording) {
+    if (!m_recordingFailed && !m_recording->add(primitive))
+      m_recordingFailed = true;
+    return;
+  }
   if ((m_backgroundPrimitiveExecutionEnabled && m_doubleBuffered == false) || primitive.cmd == PrimitiveCmd::SwapBuffers) {
-    primitiveReplaceDynamicBuffers(primitive);
-    xQueueSendToBack(m_execQueue, &primitive, portMAX_DELAY);
+    if (m_batchLevel > 0 && primitive.cmd != PrimitiveCmd::SwapBuffers) {
+      addBatchPrimitive(primitive);
+    } else {
+      flushBatch();
+      primitiveReplaceDynamicBuffers(primitive);
+      execQueueSend(primitive);
+    }
   } else {
+    reserveFillPathEdges(primitive);
     Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
     execPrimitive(primitive, updateRect);
     showSprites(updateRect);
@@ -411,6 +734,7 @@ void DisplayController::addPrimitive(Primitive & primitive)
 // will be freed inside primitive drawing code.
 void DisplayController::primitiveReplaceDynamicBuffers(Primitive & primitive)
 {
+  reserveFillPathEdges(primitive);
   switch (primitive.cmd) {
     case PrimitiveCmd::DrawPath:
     case PrimitiveCmd::FillPath:
@@ -418,9 +742,11 @@ void DisplayController::primitiveReplaceDynamicBuffers(Primitive & primitive)
       int sz = primitive.path.pointsCount * sizeof(Point);
       if (sz < FABGLIB_PRIMITIVES_DYNBUFFERS_SIZE) {
         void * newbuf = nullptr;
-        // wait until we have enough free space
-        while ((newbuf = m_primDynMemPool.alloc(sz)) == nullptr)
+        // wait until we have enough free space (collected primitives may hold buffers, send them)
+        while ((newbuf = m_primDynMemPool.alloc(sz)) == nullptr) {
+          flushBatch();
           taskYIELD();
+        }
         memcpy(newbuf, primitive.path.points, sz);
         primitive.path.points = (Point*)newbuf;
         primitive.path.freePoints = true;
@@ -434,16 +760,263 @@ void DisplayController::primitiveReplaceDynamicBuffers(Primitive & primitive)
 }
 
 
+// grows the fillPath() edge table before the primitive is executed: fillPath() may run inside an interrupt, where it cannot allocate
+void DisplayController::reserveFillPathEdges(Primitive const & primitive)
+{
+  int pointsCount;
+  if (primitive.cmd == PrimitiveCmd::FillPath)
+    pointsCount = primitive.path.pointsCount;
+  else if (primitive.cmd == PrimitiveCmd::ExecuteRecording)
+    pointsCount = primitive.recordingPlayInfo.recording->m_maxFillPathPoints;
+  else
+    pointsCount = 0;
+  if (pointsCount <= m_fillPathEdgesSize)
+    return;
+
+  auto edges  = (FillPathEdge *) heap_caps_malloc(pointsCount * sizeof(FillPathEdge), MALLOC_CAP_32BIT | MALLOC_CAP_INTERNAL);
+  auto active = (FillPathEdge * *) heap_caps_malloc(pointsCount * sizeof(FillPathEdge *), MALLOC_CAP_32BIT | MALLOC_CAP_INTERNAL);
+  if (!edges || !active) {
+    // keep current table, larger paths aren't filled
+    heap_caps_free(edges);
+    heap_caps_free(active);
+    return;
+  }
+
+  // replace the table when no queued primitive may be using it
+  FillPathEdge *   oldEdges  = m_fillPathEdges;
+  FillPathEdge * * oldActive = m_fillPathActive;
+  primitivesExecutionWait();
+  suspendBackgroundPrimitiveExecution();
+  m_fillPathEdges     = edges;
+  m_fillPathActive    = active;
+  m_fillPathEdgesSize = pointsCount;
+  resumeBackgroundPrimitiveExecution();
+  heap_caps_free(oldEdges);
+  heap_caps_free(oldActive);
+}
+
+
+void DisplayController::addPrimitives(Primitive const * primitives, int count)
+{
+  if (m_recording) {
+    for (int i = 0; i < count && !m_recordingFailed; ++i)
+      if (!m_recording->add(primitives[i]))
+        m_recordingFailed = true;
+  } else if (m_backgroundPrimitiveExecutionEnabled && m_doubleBuffered == false) {
+    for (int i = 0; i < count; ++i) {
+      if (primitives[i].cmd == PrimitiveCmd::SwapBuffers) {
+        Primitive p;
+        p = primitives[i];
+        addPrimitive(p);
+      } else
+        addBatchPrimitive(primitives[i]);
+    }
+    if (m_batchLevel == 0)
+      flushBatch();
+  } else {
+    for (int i = 0; i < count; ++i) {
+      Primitive p;
+      p = primitives[i];
+      addPrimitive(p);
+    }
+  }
+}
+
+
+void DisplayController::beginRecording()
+{
+  if (m_recording == nullptr) {
+    m_recording       = new PrimitiveRecording;
+    m_recordingFailed = false;
+  }
+}
+
+
+PrimitiveRecording * DisplayController::endRecording()
+{
+  PrimitiveRecording * recording = m_recording;
+  if (recording) {
+    m_recording = nullptr;
+    if (m_recordingFailed) {
+      // an incomplete recording would paint something different
+      delete recording;
+      return nullptr;
+    }
+    recording->finalize();
+  }
+  return recording;
+}
+
+
+void DisplayController::beginBatch()
+{
+  ++m_batchLevel;
+}
+
+
+void DisplayController::submitBatch()
+{
+  if (m_batchLevel > 0 && --m_batchLevel == 0)
+    flushBatch();
+}
+
+
+// adds the primitive to the batch, sending it when full
+void DisplayController::addBatchPrimitive(Primitive const & primitive)
+{
+  if (m_batch == nullptr)
+    m_batch = (Primitive*) malloc(FABGLIB_PRIMITIVES_BATCH_SIZE * sizeof(Primitive));
+  // replace buffers on a copy: primitiveReplaceDynamicBuffers() may flush the batch, resetting m_batchCount
+  Primitive p;
+  p = primitive;
+  primitiveReplaceDynamicBuffers(p);
+  if (m_batch == nullptr) {
+    // no memory to collect primitives, send them one by one
+    execQueueSend(p);
+    return;
+  }
+  m_batch[m_batchCount] = p;
+  if (++m_batchCount == FABGLIB_PRIMITIVES_BATCH_SIZE)
+    flushBatch();
+}
+
+
+// copies collected primitives into a buffer (using LightMemoryPool allocator) that will be freed
+// after execution, and adds to the queue a single ExecuteBatch primitive
+void DisplayController::flushBatch()
+{
+  if (m_batchCount > 0) {
+    if (m_batchMemPool == nullptr)
+      m_batchMemPool = new LightMemoryPool(FABGLIB_PRIMITIVES_BATCHBUFFERS_SIZE);
+    int sz = m_batchCount * sizeof(Primitive);
+    void * newbuf = nullptr;
+    // wait until we have enough free space
+    while ((newbuf = m_batchMemPool->alloc(sz)) == nullptr)
+      taskYIELD();
+    memcpy(newbuf, m_batch, sz);
+    Primitive p(PrimitiveCmd::ExecuteBatch);
+    p.batch.primitives = (Primitive const *) newbuf;
+    p.batch.count      = m_batchCount;
+    m_batchCount = 0;
+    execQueueSend(p);
+  }
+}
+
+
+#if FABGLIB_EXEC_QUEUE_LOCKFREE
+
+
+// blocks while the queue is full
+void DisplayController::execQueueSend(Primitive const & primitive)
+{
+  #if FABGLIB_PRIMITIVES_PROFILER
+  profileQueueDepth();
+  #endif
+  int head = m_execQueueHead;
+  int next = head == FABGLIB_EXEC_QUEUE_SIZE ? 0 : head + 1;
+  while (next == m_execQueueTail) {
+    // full, wait for the consumer (rechecks after setting the flag, so a notify cannot be lost)
+    m_execQueueProducerWaiting = true;
+    if (next == m_execQueueTail)
+      xSemaphoreTake(m_execQueueNotFull, portMAX_DELAY);
+    m_execQueueProducerWaiting = false;
+  }
+  m_execQueue[head] = primitive;
+  m_execQueueHead = next;
+  if (m_execQueueConsumerWaiting)
+    xSemaphoreGive(m_execQueueNotEmpty);
+}
+
+
+// a batch partially executed is counted as one queued item
+int DisplayController::execQueueCount()
+{
+  int r = m_execQueueHead - m_execQueueTail;
+  return (r < 0 ? r + FABGLIB_EXEC_QUEUE_SIZE + 1 : r) + (m_execBatchCount > 0 ? 1 : 0);
+}
+
+
+// call this only inside an ISR
+bool IRAM_ATTR DisplayController::getPrimitiveISR(Primitive * primitive)
+{
+  if (getBatchPrimitive(primitive))
+    return true;
+  int tail = m_execQueueTail;
+  if (tail == m_execQueueHead)
+    return false;
+  *primitive = m_execQueue[tail];
+  m_execQueueTail = tail == FABGLIB_EXEC_QUEUE_SIZE ? 0 : tail + 1;
+  if (m_execQueueProducerWaiting)
+    xSemaphoreGiveFromISR(m_execQueueNotFull, nullptr);
+  return beginBatchExecution(primitive);
+}
+
+
+bool IRAM_ATTR DisplayController::getPrimitive(Primitive * primitive, int timeOutMS)
+{
+  if (getBatchPrimitive(primitive))
+    return true;
+  int tail = m_execQueueTail;
+  if (tail == m_execQueueHead) {
+    if (timeOutMS == 0)
+      return false;
+    // empty, wait for the producer (rechecks after setting the flag, so a notify cannot be lost)
+    m_execQueueConsumerWaiting = true;
+    if (tail == m_execQueueHead)
+      xSemaphoreTake(m_execQueueNotEmpty, msToTicks(timeOutMS));
+    m_execQueueConsumerWaiting = false;
+    if (tail == m_execQueueHead)
+      return false;
+  }
+  *primitive = m_execQueue[tail];
+  m_execQueueTail = tail == FABGLIB_EXEC_QUEUE_SIZE ? 0 : tail + 1;
+  if (m_execQueueProducerWaiting)
+    xSemaphoreGive(m_execQueueNotFull);
+  return beginBatchExecution(primitive);
+}
+
+
+// cannot be called inside an ISR
+void DisplayController::waitForPrimitives()
+{
+  while (m_execQueueTail == m_execQueueHead && m_execBatchCount == 0) {
+    m_execQueueConsumerWaiting = true;
+    if (m_execQueueTail == m_execQueueHead)
+      xSemaphoreTake(m_execQueueNotEmpty, portMAX_DELAY);
+    m_execQueueConsumerWaiting = false;
+  }
+}
+
+
+#else
+
+
+void DisplayController::execQueueSend(Primitive const & primitive)
+{
+  #if FABGLIB_PRIMITIVES_PROFILER
+  profileQueueDepth();
+  #endif
+  xQueueSendToBack(m_execQueue, &primitive, portMAX_DELAY);
+}
+
+
+// a batch partially executed is counted as one queued item
+int DisplayController::execQueueCount()
+{
+  return uxQueueMessagesWaiting(m_execQueue) + (m_execBatchCount > 0 ? 1 : 0);
+}
+
+
 // call this only inside an ISR
 bool IRAM_ATTR DisplayController::getPrimitiveISR(Primitive * primitive)
 {
-  return xQueueReceiveFromISR(m_execQueue, primitive, nullptr);
+  return getBatchPrimitive(primitive) || (xQueueReceiveFromISR(m_execQueue, primitive, nullptr) && beginBatchExecution(primitive));
 }
 
 
 bool DisplayController::getPrimitive(Primitive * primitive, int timeOutMS)
 {
-  return xQueueReceive(m_execQueue, primitive, msToTicks(timeOutMS));
+  return getBatchPrimitive(primitive) || (xQueueReceive(m_execQueue, primitive, msToTicks(timeOutMS)) && beginBatchExecution(primitive));
 }
 
 
@@ -451,14 +1024,47 @@ bool DisplayController::getPrimitive(Primitive * primitive, int timeOutMS)
 void DisplayController::waitForPrimitives()
 {
   Primitive p;
-  xQueuePeek(m_execQueue, &p, portMAX_DELAY);
+  if (m_execBatchCount == 0)
+    xQueuePeek(m_execQueue, &p, portMAX_DELAY);
+}
+
+
+#endif
+
+
+// ExecuteBatch items are unpacked by getPrimitive() and getPrimitiveISR(), which return one primitive of the batch at the time.
+// This allows consumers (ie VSync interrupt) to check their timeout after each primitive, resuming the batch on next call.
+// primitive is replaced by the first primitive of the batch, returns always true
+bool IRAM_ATTR DisplayController::beginBatchExecution(Primitive * primitive)
+{
+  if (primitive->cmd != PrimitiveCmd::ExecuteBatch)
+    return true;
+  m_execBatch      = primitive->batch.primitives;
+  m_execBatchIndex = 0;
+  m_execBatchCount = primitive->batch.count;
+  return getBatchPrimitive(primitive);
+}
+
+
+// gets next primitive of the batch being executed, releasing the batch after the last one
+bool IRAM_ATTR DisplayController::getBatchPrimitive(Primitive * primitive)
+{
+  if (m_execBatchCount == 0)
+    return false;
+  *primitive = m_execBatch[m_execBatchIndex];
+  if (++m_execBatchIndex == m_execBatchCount) {
+    m_batchMemPool->free((void*)m_execBatch);
+    m_execBatchCount = 0;
+  }
+  return true;
 }
 
 
 void DisplayController::primitivesExecutionWait()
 {
   if (m_backgroundPrimitiveExecutionEnabled) {
-    while (uxQueueMessagesWaiting(m_execQueue) > 0)
+    flushBatch();
+    while (execQueueCount() > 0)
       ;
   }
 }
@@ -488,8 +1094,12 @@ void IRAM_ATTR DisplayController::processPrimitives()
   suspendBackgroundPrimitiveExecution();
   Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
   Primitive prim;
-  while (xQueueReceive(m_execQueue, &prim, 0) == pdTRUE)
+  while (getPrimitive(&prim, 0))
     execPrimitive(prim, updateRect);
+  // collected primitives follow queued ones, execute them directly
+  for (int i = 0; i < m_batchCount; ++i)
+    execPrimitive(m_batch[i], updateRect);
+  m_batchCount = 0;
   showSprites(updateRect);
   resumeBackgroundPrimitiveExecution();
   Primitive p(PrimitiveCmd::Refresh, updateRect);
@@ -532,62 +1142,214 @@ void DisplayController::refreshSprites()
 }
 
 
-void IRAM_ATTR DisplayController::hideSprites(Rect & updateRect)
+bool DisplayController::prepareBitmap(Bitmap * bitmap)
 {
-  if (!m_spritesHidden) {
-    m_spritesHidden = true;
+  if (bitmap->format != PixelFormat::RGBA2222 && bitmap->format != PixelFormat::RGBA8888)
+    return false;
+
+  uint8_t nativePixel[4];
+  if (!rawColorToNative(RGB888(0, 0, 0), nativePixel))
+    return false;
+
+  const int width     = bitmap->width;
+  const int height    = bitmap->height;
+  const int pixelSize = getBitmapSavePixelSize();
+  const bool isRGBA2222 = bitmap->format == PixelFormat::RGBA2222;
+
+  auto isOpaque = [&] (int x, int y) {
+    return isRGBA2222 ? (bitmap->data[y * width + x] & 0xc0) != 0 : ((RGBA8888 const *) bitmap->data)[y * width + x].A != 0;
+  };
+
+  // calculate runs size: each run needs two uint16_t plus its pixels (padded to 16 bit), each row ends with an empty run
+  int dataSize = 0;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ) {
+      for (; x < width && !isOpaque(x, y); ++x)
+        ;
+      int count = 0;
+      for (; x < width && isOpaque(x, y); ++x, ++count)
+        ;
+      if (count > 0)
+        dataSize += 4 + ((count * pixelSize + 1) & ~1);
+    }
+    dataSize += 4;
+  }
 
-    // normal sprites
-    if (spritesCount() > 0 && !isDoubleBuffered()) {
-      // restore saved backgrounds
-      for (int i = spritesCount() - 1; i >= 0; --i) {
-        Sprite * sprite = getSprite(i);
-        if (sprite->allowDraw && sprite->savedBackgroundWidth > 0) {
-          int savedX = sprite->savedX;
-          int savedY = sprite->savedY;
-          int savedWidth  = sprite->savedBackgroundWidth;
-          int savedHeight = sprite->savedBackgroundHeight;
-          Bitmap bitmap(savedWidth, savedHeight, sprite->savedBackground, PixelFormat::Native);
-          absDrawBitmap(savedX, savedY, &bitmap, nullptr, true);
-          updateRect = updateRect.merge(Rect(savedX, savedY, savedX + savedWidth - 1, savedY + savedHeight - 1));
-          sprite->savedBackgroundWidth = sprite->savedBackgroundHeight = 0;
+  const int headerSize = (sizeof(BitmapRuns) + height * sizeof(uint32_t) + 3) & ~3;
+  auto runs = (BitmapRuns*) malloc(headerSize + dataSize);
+  if (!runs)
+    return false;
+  runs->displayController = this;
+  runs->format            = nativePixelFormat();
+  runs->pixelSize         = pixelSize;
+  runs->rowOffset         = (uint32_t*) (runs + 1);
+  runs->data              = (uint8_t*) runs + headerSize;
+
+  // convert opaque pixels to native format
+  uint8_t * dest = runs->data;
+  for (int y = 0; y < height; ++y) {
+    runs->rowOffset[y] = dest - runs->data;
+    for (int x = 0; x < width; ) {
+      int skip = 0;
+      for (; x < width && !isOpaque(x, y); ++x, ++skip)
+        ;
+      int count = 0;
+      uint8_t * px = dest + 4;
+      for (; x < width && isOpaque(x, y); ++x, ++count, px += pixelSize) {
+        if (isRGBA2222) {
+          uint8_t src = bitmap->data[y * width + x];
+          rawColorToNative(RGB888((src & 3) * 85, ((src >> 2) & 3) * 85, ((src >> 4) & 3) * 85), px);
+        } else {
+          RGBA8888 const & src = ((RGBA8888 const *) bitmap->data)[y * width + x];
+          rawColorToNative(RGB888(src.R, src.G, src.B), px);
         }
       }
+      if (count > 0) {
+        ((uint16_t*) dest)[0] = skip;
+        ((uint16_t*) dest)[1] = count;
+        dest += 4 + ((count * pixelSize + 1) & ~1);
+      }
     }
+    // end of row
+    ((uint16_t*) dest)[0] = 0;
+    ((uint16_t*) dest)[1] = 0;
+    dest += 4;
+  }
 
-    // mouse cursor sprite
-    Sprite * mouseSprite = mouseCursor();
-    if (mouseSprite->savedBackgroundWidth > 0) {
-      int savedX = mouseSprite->savedX;
-      int savedY = mouseSprite->savedY;
-      int savedWidth  = mouseSprite->savedBackgroundWidth;
-      int savedHeight = mouseSprite->savedBackgroundHeight;
-      Bitmap bitmap(savedWidth, savedHeight, mouseSprite->savedBackground, PixelFormat::Native);
-      absDrawBitmap(savedX, savedY, &bitmap, nullptr, true);
-      updateRect = updateRect.merge(Rect(savedX, savedY, savedX + savedWidth - 1, savedY + savedHeight - 1));
-      mouseSprite->savedBackgroundWidth = mouseSprite->savedBackgroundHeight = 0;
+  BitmapRuns * oldRuns = bitmap->runs;
+  if (oldRuns) {
+    // replace runs when no queued primitive or visible sprite may be using the old ones
+    DisplayController * owner = oldRuns->displayController;
+    owner->primitivesExecutionWait();
+    owner->suspendBackgroundPrimitiveExecution();
+    if (owner != this)
+      suspendBackgroundPrimitiveExecution();
+    bitmap->runs = runs;
+    if (owner != this)
+      resumeBackgroundPrimitiveExecution();
+    owner->resumeBackgroundPrimitiveExecution();
+    free(oldRuns);
+  } else
+    bitmap->runs = runs;
+
+  return true;
+}
+
+
+bool IRAM_ATTR DisplayController::isBitmapPrepared(Bitmap const * bitmap)
+{
+  auto runs = bitmap->runs;
+  return runs && runs->displayController == this && runs->format == nativePixelFormat() && runs->pixelSize == getBitmapSavePixelSize();
+}
+
+
+// area where the sprite background has been saved, empty when sprite is not on screen
+static Rect spriteSavedRect(Sprite const * sprite)
+{
+  if (sprite->savedBackgroundWidth == 0)
+    return Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+  return Rect(sprite->savedX, sprite->savedY, sprite->savedX + sprite->savedBackgroundWidth - 1, sprite->savedY + sprite->savedBackgroundHeight - 1);
+}
+
+
+// area where the sprite is going to be drawn, empty when sprite is not visible
+static Rect spriteDrawRect(Sprite * sprite)
+{
+  Bitmap const * bitmap = sprite->getFrame();
+  if (!sprite->visible || !bitmap)
+    return Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+  const int spriteX = sprite->x;
+  const int spriteY = sprite->y;
+  return Rect(spriteX, spriteY, spriteX + bitmap->width - 1, spriteY + bitmap->height - 1);
+}
+
+
+// Only sprites intersecting updateRect are hidden. Hidden area is then extended to include any sprite overlapping it (where it is and
+// where it is going to be drawn), so a sprite is never restored or drawn while an overlapping sprite is on the screen.
+// Can be called many times before showSprites(): sprites are hidden as the painted area grows.
+void IRAM_ATTR DisplayController::hideSprites(Rect & updateRect, bool allSprites)
+{
+  if (m_spritesHidden && !allSprites && m_spritesHiddenRect.contains(updateRect))
+    return;
+
+  #if FABGLIB_PRIMITIVES_PROFILER
+  const uint32_t startCycles = getCycleCount();
+  #endif
+
+  if (m_spritesHidden)
+    m_spritesHiddenRect = m_spritesHiddenRect.merge(updateRect);
+  else {
+    m_spritesHidden = true;
+    m_spritesHiddenRect = updateRect;
+  }
+
+  // in double buffered mode normal sprites are painted over each new frame, never hidden
+  const int normalSpritesCount = isDoubleBuffered() ? 0 : spritesCount();
+  Sprite * mouseSprite = mouseCursor();
+
+  // extend hidden area (last checked sprite is the mouse cursor)
+  for (bool extended = true; extended; ) {
+    extended = false;
+    for (int i = 0; i <= normalSpritesCount; ++i) {
+      Sprite * sprite = i < normalSpritesCount ? getSprite(i) : mouseSprite;
+      if (sprite != mouseSprite && !sprite->allowDraw)
+        continue;
+      Rect area = spriteSavedRect(sprite).merge(spriteDrawRect(sprite));
+      if (area.X1 <= area.X2 && (allSprites || area.intersects(m_spritesHiddenRect)) && !m_spritesHiddenRect.contains(area)) {
+        m_spritesHiddenRect = m_spritesHiddenRect.merge(area);
+        extended = true;
+      }
     }
+  }
 
+  // restore saved backgrounds, from top (mouse cursor) to bottom
+  for (int i = normalSpritesCount; i >= 0; --i) {
+    Sprite * sprite = i < normalSpritesCount ? getSprite(i) : mouseSprite;
+    if ((sprite == mouseSprite || sprite->allowDraw) && sprite->savedBackgroundWidth > 0) {
+      Rect savedRect = spriteSavedRect(sprite);
+      if (savedRect.intersects(m_spritesHiddenRect)) {
+        Bitmap bitmap(savedRect.width(), savedRect.height(), sprite->savedBackground, PixelFormat::Native);
+        absDrawBitmap(savedRect.X1, savedRect.Y1, &bitmap, nullptr, true);
+        updateRect = updateRect.merge(savedRect);
+        sprite->savedBackgroundWidth = sprite->savedBackgroundHeight = 0;
+      }
+    }
   }
+
+  #if FABGLIB_PRIMITIVES_PROFILER
+  m_profile.hideSpritesCount  += 1;
+  m_profile.hideSpritesCycles += getCycleCount() - startCycles;
+  #endif
 }
 
 
+// draws sprites hidden by hideSprites() and sprites to draw inside the hidden area
 void IRAM_ATTR DisplayController::showSprites(Rect & updateRect)
 {
+  // the filled rectangle held by the primitives optimizer is the last painted one
+  flushPendingFill(updateRect);
+
   if (m_spritesHidden) {
     m_spritesHidden = false;
 
+    #if FABGLIB_PRIMITIVES_PROFILER
+    const uint32_t startCycles = getCycleCount();
+    #endif
+
     // normal sprites
     // save backgrounds and draw sprites
     for (int i = 0; i < spritesCount(); ++i) {
       Sprite * sprite = getSprite(i);
-      if (sprite->visible && sprite->allowDraw && sprite->getFrame()) {
+      if (sprite->visible && sprite->allowDraw && sprite->getFrame() && (isDoubleBuffered() || sprite->savedBackgroundWidth == 0)) {
         // save sprite X and Y so other threads can change them without interferring
         int spriteX = sprite->x;
         int spriteY = sprite->y;
         Bitmap const * bitmap = sprite->getFrame();
         int bitmapWidth  = bitmap->width;
         int bitmapHeight = bitmap->height;
+        Rect spriteRect = Rect(spriteX, spriteY, spriteX + bitmapWidth - 1, spriteY + bitmapHeight - 1);
+        if (!isDoubleBuffered() && !spriteRect.intersects(m_spritesHiddenRect))
+          continue;
         absDrawBitmap(spriteX, spriteY, bitmap, sprite->savedBackground, true);
         sprite->savedX = spriteX;
         sprite->savedY = spriteY;
@@ -595,28 +1357,36 @@ void IRAM_ATTR DisplayController::showSprites(Rect & updateRect)
         sprite->savedBackgroundHeight = bitmapHeight;
         if (sprite->isStatic)
           sprite->allowDraw = false;
-        updateRect = updateRect.merge(Rect(spriteX, spriteY, spriteX + bitmapWidth - 1, spriteY + bitmapHeight - 1));
+        updateRect = updateRect.merge(spriteRect);
       }
     }
 
     // mouse cursor sprite
     // save backgrounds and draw mouse cursor
     Sprite * mouseSprite = mouseCursor();
-    if (mouseSprite->visible && mouseSprite->getFrame()) {
+    if (mouseSprite->visible && mouseSprite->getFrame() && mouseSprite->savedBackgroundWidth == 0) {
       // save sprite X and Y so other threads can change them without interferring
       int spriteX = mouseSprite->x;
       int spriteY = mouseSprite->y;
       Bitmap const * bitmap = mouseSprite->getFrame();
       int bitmapWidth  = bitmap->width;
       int bitmapHeight = bitmap->height;
-      absDrawBitmap(spriteX, spriteY, bitmap, mouseSprite->savedBackground, true);
-      mouseSprite->savedX = spriteX;
-      mouseSprite->savedY = spriteY;
-      mouseSprite->savedBackgroundWidth  = bitmapWidth;
-      mouseSprite->savedBackgroundHeight = bitmapHeight;
-      updateRect = updateRect.merge(Rect(spriteX, spriteY, spriteX + bitmapWidth - 1, spriteY + bitmapHeight - 1));
+      Rect spriteRect = Rect(spriteX, spriteY, spriteX + bitmapWidth - 1, spriteY + bitmapHeight - 1);
+      if (spriteRect.intersects(m_spritesHiddenRect)) {
+        absDrawBitmap(spriteX, spriteY, bitmap, mouseSprite->savedBackground, true);
+        mouseSprite->savedX = spriteX;
+        mouseSprite->savedY = spriteY;
+        mouseSprite->savedBackgroundWidth  = bitmapWidth;
+        mouseSprite->savedBackgroundHeight = bitmapHeight;
+        updateRect = updateRect.merge(spriteRect);
+      }
     }
 
+    #if FABGLIB_PRIMITIVES_PROFILER
+    m_profile.showSpritesCount  += 1;
+    m_profile.showSpritesCycles += getCycleCount() - startCycles;
+    #endif
+
   }
 }
 
@@ -636,6 +1406,8 @@ void DisplayController::setMouseCursor(Cursor * cursor)
       m_mouseCursor.moveBy(+m_mouseHotspotX, +m_mouseHotspotY);
       m_mouseHotspotX = cursor->hotspotX;
       m_mouseHotspotY = cursor->hotspotY;
+      if (!isBitmapPrepared(&cursor->bitmap))
+        prepareBitmap(&cursor->bitmap);
       m_mouseCursor.addBitmap(&cursor->bitmap);
       m_mouseCursor.visible = true;
       m_mouseCursor.moveBy(-m_mouseHotspotX, -m_mouseHotspotY);
@@ -660,7 +1432,78 @@ void DisplayController::setMouseCursorPos(int X, int Y)
 }
 
 
+// the area painted by each primitive is collected separately, so only sprites intersecting it are hidden
 void IRAM_ATTR DisplayController::execPrimitive(Primitive const & prim, Rect & updateRect)
+{
+  #if FABGLIB_PRIMITIVES_PROFILER
+  const uint32_t startCycles = getCycleCount();
+  #endif
+  Rect primitiveRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+  if (!m_primitivesOptimizerEnabled || !optimizePrimitive(prim, primitiveRect))
+    execPrimitiveCmd(prim, primitiveRect);
+  updateRect = updateRect.merge(primitiveRect);
+  #if FABGLIB_PRIMITIVES_PROFILER
+  profilePrimitive(prim.cmd, getCycleCount() - startCycles, primitiveRect);
+  #endif
+}
+
+
+#if FABGLIB_PRIMITIVES_PROFILER
+
+
+void IRAM_ATTR DisplayController::profilePrimitive(PrimitiveCmd cmd, uint32_t cycles, Rect const & updateRect)
+{
+  PrimitiveProfileStats & s = m_profile.primitives[cmd];
+  s.count       += 1;
+  s.totalCycles += cycles;
+  s.minCycles    = tmin(s.minCycles, cycles);
+  s.maxCycles    = tmax(s.maxCycles, cycles);
+  if (updateRect.X1 <= updateRect.X2 && updateRect.Y1 <= updateRect.Y2)
+    s.pixels += updateRect.width() * updateRect.height();
+}
+
+
+// called by the producer before a primitive is added to the queue
+void DisplayController::profileQueueDepth()
+{
+  const uint32_t depth = execQueueCount();
+  m_profile.queueSamples    += 1;
+  m_profile.queueDepthTotal += depth;
+  m_profile.queueDepthMax    = tmax(m_profile.queueDepthMax, depth);
+}
+
+
+void DisplayController::resetPrimitivesProfile()
+{
+  memset(&m_profile, 0, sizeof(m_profile));
+  for (int i = 0; i < PRIMITIVECMD_COUNT; ++i)
+    m_profile.primitives[i].minCycles = UINT32_MAX;
+}
+
+
+void DisplayController::printPrimitivesProfile(FILE * stream)
+{
+  const double cyclesPerUS = ets_get_cpu_frequency();
+  fprintf(stream, "%-19s %8s %10s %10s %10s %12s %12s\n", "Command", "Count", "Avg(us)", "Min(us)", "Max(us)", "Total(us)", "Pixels");
+  for (int cmd = 0; cmd < PRIMITIVECMD_COUNT; ++cmd) {
+    PrimitiveProfileStats const & s = m_profile.primitives[cmd];
+    if (s.count == 0)
+      continue;
+    fprintf(stream, "%-19s %8u %10.2f %10.2f %10.2f %12.0f %12llu\n",
+            primitiveCmdName((PrimitiveCmd)cmd), s.count, s.totalCycles / cyclesPerUS / s.count, s.minCycles / cyclesPerUS, s.maxCycles / cyclesPerUS,
+            s.totalCycles / cyclesPerUS, (unsigned long long) s.pixels);
+  }
+  fprintf(stream, "Hide sprites: %u times, %.0f us\n", m_profile.hideSpritesCount, m_profile.hideSpritesCycles / cyclesPerUS);
+  fprintf(stream, "Show sprites: %u times, %.0f us\n", m_profile.showSpritesCount, m_profile.showSpritesCycles / cyclesPerUS);
+  fprintf(stream, "Queue depth: avg %.1f, max %u (%u samples)\n",
+          m_profile.queueSamples ? (double) m_profile.queueDepthTotal / m_profile.queueSamples : 0.0, m_profile.queueDepthMax, m_profile.queueSamples);
+}
+
+
+#endif
+
+
+void IRAM_ATTR DisplayController::execPrimitiveCmd(Primitive const & prim, Rect & updateRect)
 {
   switch (prim.cmd) {
     case PrimitiveCmd::Flush:
@@ -738,7 +1581,8 @@ void IRAM_ATTR DisplayController::execPrimitive(Primitive const & prim, Rect & u
       drawBitmap(prim.bitmapDrawingInfo, updateRect);
       break;
     case PrimitiveCmd::RefreshSprites:
-      hideSprites(updateRect);
+      // sprites may have been moved or changed, hide all of them
+      hideSprites(updateRect, true);
       showSprites(updateRect);
       break;
     case PrimitiveCmd::SwapBuffers:
@@ -752,7 +1596,7 @@ void IRAM_ATTR DisplayController::execPrimitive(Primitive const & prim, Rect & u
       fillPath(prim.path, getActualBrushColor(), updateRect);
       break;
     case PrimitiveCmd::SetOrigin:
-      paintState().origin = prim.position;
+      paintState().origin = Point(prim.position.X + m_playOrigin.X, prim.position.Y + m_playOrigin.Y);
       updateAbsoluteClippingRect();
       break;
     case PrimitiveCmd::SetClippingRect:
@@ -765,7 +1609,197 @@ void IRAM_ATTR DisplayController::execPrimitive(Primitive const & prim, Rect & u
     case PrimitiveCmd::SetLineEnds:
       paintState().lineEnds = prim.lineEnds;
       break;
+    case PrimitiveCmd::DrawTileMap:
+      drawTileMap(prim.tileMapDrawingInfo, updateRect);
+      break;
+    case PrimitiveCmd::ScrollTileMap:
+      scrollTileMap(prim.tileMapDrawingInfo, updateRect);
+      break;
+    case PrimitiveCmd::ExecuteRecording:
+      execRecording(prim.recordingPlayInfo, updateRect);
+      break;
+    case PrimitiveCmd::ExecuteBatch:
+      for (int i = 0; i < prim.batch.count; ++i)
+        execPrimitive(prim.batch.primitives[i], updateRect);
+      m_batchMemPool->free((void*)prim.batch.primitives);
+      break;
+  }
+}
+
+
+// Returns true when the primitive doesn't need to be executed: it has no effects, it is outside of clipping rectangle or it is
+// a filled rectangle held in m_pendingFillRect. The pending rectangle is painted before any primitive which may read or paint the screen,
+// or by showSprites() at the end of primitives processing.
+bool IRAM_ATTR DisplayController::optimizePrimitive(Primitive const & prim, Rect & updateRect)
+{
+  Rect const & clip = paintState().absClippingRect;
+  Rect bounds;  // absolute area painted by the primitive (or larger)
+
+  switch (prim.cmd) {
+
+    // state changes: they don't paint, so the pending rectangle (whose color is already resolved) can be left pending
+
+    case PrimitiveCmd::SetPenColor:
+      return prim.color == paintState().penColor;
+
+    case PrimitiveCmd::SetBrushColor:
+      return prim.color == paintState().brushColor;
+
+    case PrimitiveCmd::SetGlyphOptions:
+      return prim.glyphOptions.value == paintState().glyphOptions.value;
+
+    case PrimitiveCmd::SetOrigin:
+      return paintState().origin == Point(prim.position.X + m_playOrigin.X, prim.position.Y + m_playOrigin.Y);
+
+    case PrimitiveCmd::SetClippingRect:
+      return paintState().clippingRect == prim.rect;
+
+    case PrimitiveCmd::Flush:
+    case PrimitiveCmd::Refresh:
+    case PrimitiveCmd::MoveTo:
+    case PrimitiveCmd::SetPaintOptions:
+    case PrimitiveCmd::SetScrollingRegion:
+    case PrimitiveCmd::SetPenWidth:
+    case PrimitiveCmd::SetLineEnds:
+      return false;
+
+    case PrimitiveCmd::FillRect:
+    {
+      const int x1 = tmax(tmin(prim.rect.X1, prim.rect.X2) + paintState().origin.X, (int)clip.X1);
+      const int y1 = tmax(tmin(prim.rect.Y1, prim.rect.Y2) + paintState().origin.Y, (int)clip.Y1);
+      const int x2 = tmin(tmax(prim.rect.X1, prim.rect.X2) + paintState().origin.X, (int)clip.X2);
+      const int y2 = tmin(tmax(prim.rect.Y1, prim.rect.Y2) + paintState().origin.Y, (int)clip.Y2);
+      if (x1 > x2 || y1 > y2)
+        return true;
+      const RGB888 color = getActualBrushColor();
+      if (m_pendingFill && color == m_pendingFillColor) {
+        Rect & r = m_pendingFillRect;
+        // the union of the two rectangles is a rectangle when they have the same columns and touching (or overlapping) rows, or vice versa
+        if (x1 == r.X1 && x2 == r.X2 && y1 <= r.Y2 + 1 && y2 >= r.Y1 - 1) {
+          r.Y1 = tmin((int)r.Y1, y1);
+          r.Y2 = tmax((int)r.Y2, y2);
+          return true;
+        }
+        if (y1 == r.Y1 && y2 == r.Y2 && x1 <= r.X2 + 1 && x2 >= r.X1 - 1) {
+          r.X1 = tmin((int)r.X1, x1);
+          r.X2 = tmax((int)r.X2, x2);
+          return true;
+        }
+      }
+      flushPendingFill(updateRect);
+      m_pendingFill      = true;
+      m_pendingFillRect  = Rect(x1, y1, x2, y2);
+      m_pendingFillColor = color;
+      return true;
+    }
+
+    // drawings whose painted area is known before execution
+
+    case PrimitiveCmd::DrawRect:
+    case PrimitiveCmd::InvertRect:
+    case PrimitiveCmd::SwapFGBG:
+    {
+      const int hw = prim.cmd == PrimitiveCmd::DrawRect ? paintState().penWidth / 2 : 0;
+      bounds = Rect(tmin(prim.rect.X1, prim.rect.X2) - hw, tmin(prim.rect.Y1, prim.rect.Y2) - hw,
+                    tmax(prim.rect.X1, prim.rect.X2) + hw, tmax(prim.rect.Y1, prim.rect.Y2) + hw).translate(paintState().origin);
+      break;
+    }
+
+    case PrimitiveCmd::FillEllipse:
+    case PrimitiveCmd::DrawEllipse:
+    {
+      Point const & center = paintState().position;
+      const int hw = paintState().penWidth;
+      bounds = Rect(center.X - prim.size.width / 2 - hw, center.Y - prim.size.height / 2 - hw,
+                    center.X + prim.size.width / 2 + hw, center.Y + prim.size.height / 2 + hw);
+      break;
+    }
+
+    case PrimitiveCmd::DrawGlyph:
+    {
+      // double width, double height and bold may enlarge the glyph
+      const int x = prim.glyph.X + paintState().origin.X;
+      const int y = prim.glyph.Y + paintState().origin.Y;
+      bounds = Rect(x, y, x + prim.glyph.width * 2, y + prim.glyph.height * 2);
+      break;
+    }
+
+    case PrimitiveCmd::DrawBitmap:
+    {
+      const int x = prim.bitmapDrawingInfo.X + paintState().origin.X;
+      const int y = prim.bitmapDrawingInfo.Y + paintState().origin.Y;
+      bounds = Rect(x, y, x + prim.bitmapDrawingInfo.bitmap->width - 1, y + prim.bitmapDrawingInfo.bitmap->height - 1);
+      break;
+    }
+
+    default:
+      flushPendingFill(updateRect);
+      return false;
+
   }
+
+  if (!bounds.intersects(clip))
+    return true;
+  flushPendingFill(updateRect);
+  return false;
+}
+
+
+void IRAM_ATTR DisplayController::flushPendingFill(Rect & updateRect)
+{
+  if (m_pendingFill) {
+    m_pendingFill = false;
+    Rect const & r = m_pendingFillRect;
+    Rect fillRect = r;
+    hideSprites(fillRect);
+    for (int y = r.Y1; y <= r.Y2; ++y)
+      rawFillRow(y, r.X1, r.X2, m_pendingFillColor);
+    updateRect = updateRect.merge(fillRect);
+  }
+}
+
+
+// executes recorded primitives with origin moved by the specified offset, then restores the paint state
+// TUpdate is Rect or DirtyRegion (see execPrimitive())
+template <typename TUpdate>
+void IRAM_ATTR DisplayController::execRecording(RecordingPlayInfo const & playInfo, TUpdate & update)
+{
+  const PaintState savedPaintState  = m_paintState;
+  const Point      savedPlayOrigin  = m_playOrigin;
+
+  m_playOrigin = Point(m_paintState.origin.X + playInfo.X, m_paintState.origin.Y + playInfo.Y);
+  m_paintState.origin = m_playOrigin;   // absolute clipping rectangle is not moved
+
+  PrimitiveRecording const * recording = playInfo.recording;
+  for (int i = 0; i < recording->count(); ++i)
+    execPrimitive(recording->primitives()[i], update);
+
+  m_paintState = savedPaintState;
+  m_playOrigin = savedPlayOrigin;
+}
+
+
+void DisplayController::execPrimitive(Primitive const & prim, DirtyRegion & dirtyRegion)
+{
+  if (prim.cmd == PrimitiveCmd::ExecuteBatch) {
+    for (int i = 0; i < prim.batch.count; ++i)
+      execPrimitive(prim.batch.primitives[i], dirtyRegion);
+    m_batchMemPool->free((void*)prim.batch.primitives);
+  } else if (prim.cmd == PrimitiveCmd::ExecuteRecording) {
+    execRecording(prim.recordingPlayInfo, dirtyRegion);
+  } else {
+    Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+    execPrimitive(prim, updateRect);
+    dirtyRegion.add(updateRect);
+  }
+}
+
+
+void DisplayController::showSprites(DirtyRegion & dirtyRegion)
+{
+  Rect updateRect = Rect(SHRT_MAX, SHRT_MAX, SHRT_MIN, SHRT_MIN);
+  showSprites(updateRect);
+  dirtyRegion.add(updateRect);
 }
 
 
@@ -795,7 +1829,7 @@ void IRAM_ATTR DisplayController::lineTo(Point const & position, Rect & updateRe
   int hw = paintState().penWidth / 2;
   updateRect = updateRect.merge(Rect(imin(x1, x2) - hw, imin(y1, y2) - hw, imax(x1, x2) + hw, imax(y1, y2) + hw));
   hideSprites(updateRect);
-  absDrawLine(x1, y1, x2, y2, color);
+  absDrawPenLine(x1, y1, x2, y2, color, updateRect);
 
   paintState().position = Point(x2, y2);
 }
@@ -823,10 +1857,16 @@ void IRAM_ATTR DisplayController::drawRect(Rect const & rect, Rect & updateRect)
   hideSprites(updateRect);
   RGB888 color = getActualPenColor();
 
-  absDrawLine(x1 + 1, y1,     x2, y1, color);
-  absDrawLine(x2,     y1 + 1, x2, y2, color);
-  absDrawLine(x2 - 1, y2,     x1, y2, color);
-  absDrawLine(x1,     y2 - 1, x1, y1, color);
+  // one pixel wide or high rectangles are just lines (sides would go outside the rectangle)
+  if (x1 == x2 || y1 == y2) {
+    absDrawPenLine(x1, y1, x2, y2, color, updateRect);
+    return;
+  }
+
+  absDrawPenLine(x1 + 1, y1,     x2, y1, color, updateRect);
+  absDrawPenLine(x2,     y1 + 1, x2, y2, color, updateRect);
+  absDrawPenLine(x2 - 1, y2,     x1, y2, color, updateRect);
+  absDrawPenLine(x1,     y2 - 1, x1, y1, color, updateRect);
 }
 
 
@@ -917,8 +1957,12 @@ void IRAM_ATTR DisplayController::fillEllipse(int centerX, int centerY, Size con
     }
   }
   // one line horizontal ellipse case
-  if (halfHeight == 0 && centerY >= clipY1 && centerY <= clipY2)
-    rawFillRow(centerY, iclamp(centerX - halfWidth, clipX1, clipX2), iclamp(centerX - halfWidth + 2 * halfWidth + 1, clipX1, clipX2), color);
+  if (halfHeight == 0 && centerY >= clipY1 && centerY <= clipY2) {
+    const int col1 = centerX - halfWidth;
+    const int col2 = centerX - halfWidth + 2 * halfWidth + 1;
+    if (col1 <= clipX2 && col2 >= clipX1)
+      rawFillRow(centerY, iclamp(col1, clipX1, clipX2), iclamp(col2, clipX1, clipX2), color);
+  }
 }
 
 
@@ -983,13 +2027,13 @@ void IRAM_ATTR DisplayController::drawPath(Path const & path, Rect & updateRect)
     const int y1 = path.points[i].Y + origY;
     const int x2 = path.points[i + 1].X + origX;
     const int y2 = path.points[i + 1].Y + origY;
-    absDrawLine(x1, y1, x2, y2, color);
+    absDrawPenLine(x1, y1, x2, y2, color, updateRect);
   }
   const int x1 = path.points[i].X + origX;
   const int y1 = path.points[i].Y + origY;
   const int x2 = path.points[0].X + origX;
   const int y2 = path.points[0].Y + origY;
-  absDrawLine(x1, y1, x2, y2, color);
+  absDrawPenLine(x1, y1, x2, y2, color, updateRect);
 
   if (path.freePoints)
     m_primDynMemPool.free((void*)path.points);
@@ -1006,71 +2050,174 @@ void IRAM_ATTR DisplayController::fillPath(Path const & path, RGB888 const & col
   const int origX = paintState().origin.X;
   const int origY = paintState().origin.Y;
 
-  int minX = clipX1;
-  int maxX = clipX2 + 1;
+  int minX = INT_MAX;
+  int maxX = INT_MIN;
   int minY = INT_MAX;
-  int maxY = 0;
+  int maxY = INT_MIN;
   for (int i = 0; i < path.pointsCount; ++i) {
+    int px = path.points[i].X + origX;
     int py = path.points[i].Y + origY;
-    if (py < minY)
-      minY = py;
-    if (py > maxY)
-      maxY = py;
+    minX = tmin(minX, px);
+    maxX = tmax(maxX, px);
+    minY = tmin(minY, py);
+    maxY = tmax(maxY, py);
   }
+  // filled pixels are from minX to maxX - 1
+  minX = tmax(clipX1, minX);
+  maxX = tmin(clipX2 + 1, maxX);
   minY = tmax(clipY1, minY);
   maxY = tmin(clipY2, maxY);
 
-  updateRect = updateRect.merge(Rect(minX, minY, maxX, maxY));
-  hideSprites(updateRect);
+  // a path larger than the edge table means that its allocation has failed
+  if (minX < maxX && minY <= maxY && path.pointsCount <= m_fillPathEdgesSize) {
+    updateRect = updateRect.merge(Rect(minX, minY, maxX - 1, maxY));
+    hideSprites(updateRect);
+    fillPathEdgeTable(path, color, minX, maxX, minY, maxY);
+  }
 
-  int16_t nodeX[path.pointsCount];
-
-  for (int pixelY = minY; pixelY <= maxY; ++pixelY) {
-
-    int nodes = 0;
-    int j = path.pointsCount - 1;
-    for (int i = 0; i < path.pointsCount; ++i) {
-      int piy = path.points[i].Y + origY;
-      int pjy = path.points[j].Y + origY;
-      if ((piy < pixelY && pjy >= pixelY) || (pjy < pixelY && piy >= pixelY)) {
-        int pjx = path.points[j].X + origX;
-        int pix = path.points[i].X + origX;
-        int a = (pixelY - piy) * (pjx - pix);
-        int b = (pjy - piy);
-        nodeX[nodes++] = pix + a / b + (((a < 0) ^ (b > 0)) && (a % b));
-      }
-      j = i;
+  if (path.freePoints)
+    m_primDynMemPool.free((void*)path.points);
+}
+
+
+// edge table/active edge list scanline filler, path.pointsCount must not exceed m_fillPathEdgesSize
+void IRAM_ATTR DisplayController::fillPathEdgeTable(Path const & path, RGB888 const & color, int minX, int maxX, int minY, int maxY)
+{
+  const int origX = paintState().origin.X;
+  const int origY = paintState().origin.Y;
+
+  // edge table: edges crossing at least one scanline of minY...maxY, sorted by first scanline
+  // an edge crosses scanline Y when Y is in (top, bottom], where it is filled from the ceiling of the exact intersection
+  FillPathEdge * edges = m_fillPathEdges;
+  int edgesCount = 0;
+  for (int i = 0, j = path.pointsCount - 1; i < path.pointsCount; j = i++) {
+    int topX = path.points[i].X + origX;
+    int topY = path.points[i].Y + origY;
+    int botX = path.points[j].X + origX;
+    int botY = path.points[j].Y + origY;
+    if (topY == botY)
+      continue;  // horizontal edges never cross scanlines
+    if (topY > botY) {
+      tswap(topX, botX);
+      tswap(topY, botY);
     }
+    const int startY = tmax(topY + 1, minY);
+    if (startY > tmin(botY, maxY))
+      continue;
+    FillPathEdge edge;
+    edge.startY = startY;
+    edge.endY   = botY;
+    edge.dy     = botY - topY;
+    // exact X at startY is topX + (startY - topY) * dx / dy, X is its ceiling and err = X * dy - exact X * dy (0 <= err < dy)
+    const int dx = botX - topX;
+    const int t  = (startY - topY) * dx;
+    int q = t / edge.dy, r = t % edge.dy;
+    if (r < 0) {
+      --q;
+      r += edge.dy;
+    }
+    edge.X   = topX + q + (r ? 1 : 0);
+    edge.err = r ? edge.dy - r : 0;
+    // per scanline increment of exact X is stepX + stepR / dy (0 <= stepR < dy)
+    edge.stepX = dx / edge.dy;
+    edge.stepR = dx % edge.dy;
+    if (edge.stepR < 0) {
+      --edge.stepX;
+      edge.stepR += edge.dy;
+    }
+    // insertion sort by startY
+    int k = edgesCount++;
+    for (; k > 0 && edges[k - 1].startY > startY; --k)
+      edges[k] = edges[k - 1];
+    edges[k] = edge;
+  }
 
-    int i = 0;
-    while (i < nodes - 1) {
-      if (nodeX[i] > nodeX[i + 1]) {
-        tswap(nodeX[i], nodeX[i + 1]);
-        if (i)
-          --i;
-      } else
-        ++i;
+  // active edges, sorted by X
+  FillPathEdge * * active = m_fillPathActive;
+  int activeCount = 0;
+  int nextEdge = 0;
+
+  for (int pixelY = minY; pixelY <= maxY && (activeCount > 0 || nextEdge < edgesCount); ++pixelY) {
+
+    // remove edges ended at previous scanline
+    int n = 0;
+    for (int i = 0; i < activeCount; ++i)
+      if (active[i]->endY >= pixelY)
+        active[n++] = active[i];
+    activeCount = n;
+
+    // add edges starting here
+    for (; nextEdge < edgesCount && edges[nextEdge].startY == pixelY; ++nextEdge)
+      active[activeCount++] = edges + nextEdge;
+
+    // sort by X (edges are almost sorted from previous scanline)
+    for (int i = 1; i < activeCount; ++i) {
+      FillPathEdge * edge = active[i];
+      int k = i;
+      for (; k > 0 && active[k - 1]->X > edge->X; --k)
+        active[k] = active[k - 1];
+      active[k] = edge;
     }
 
-    for (int i = 0; i < nodes; i += 2) {
-      if (nodeX[i] >= maxX)
+    for (int i = 0; i + 1 < activeCount; i += 2) {
+      int X1 = active[i]->X;
+      int X2 = active[i + 1]->X;
+      if (X1 >= maxX)
         break;
-      if (nodeX[i + 1] > minX) {
-        if (nodeX[i] < minX)
-          nodeX[i] = minX;
-        if (nodeX[i + 1] > maxX)
-          nodeX[i + 1] = maxX;
-        rawFillRow(pixelY, nodeX[i], nodeX[i + 1] - 1, color);
+      if (X2 > minX) {
+        if (X1 < minX)
+          X1 = minX;
+        if (X2 > maxX)
+          X2 = maxX;
+        rawFillRow(pixelY, X1, X2 - 1, color);
+      }
+    }
+
+    // step to next scanline
+    for (int i = 0; i < activeCount; ++i) {
+      FillPathEdge * edge = active[i];
+      edge->X   += edge->stepX;
+      edge->err -= edge->stepR;
+      if (edge->err < 0) {
+        edge->err += edge->dy;
+        ++edge->X;
       }
     }
   }
+}
 
-  if (path.freePoints)
-    m_primDynMemPool.free((void*)path.points);
+
+// returns a component of the thick line normal vector, rounded as lround(penWidth / 2 * v / sqrt(len2)), without using floating point
+// the result n satisfies (2n - 1)^2 * len2 <= (penWidth * v)^2 < (2n + 1)^2 * len2
+static int thickLineOffset(int penWidth, int v, int64_t len2)
+{
+  const int a = v < 0 ? -v : v;
+  const int64_t pa2 = (int64_t)penWidth * a * penWidth * a;
+  // estimate, then adjust
+  int n = 0;
+  if (len2 <= INT_MAX) {
+    const int len = isqrt(len2);
+    n = ((int64_t)penWidth * a + len) / (2 * len);
+  }
+  while (n > 0 && (int64_t)(2 * n - 1) * (2 * n - 1) * len2 > pa2)
+    --n;
+  while ((int64_t)(2 * n + 1) * (2 * n + 1) * len2 <= pa2)
+    ++n;
+  return v < 0 ? -n : n;
 }
 
 
-void IRAM_ATTR DisplayController::absDrawThickLine(int X1, int Y1, int X2, int Y2, int penWidth, RGB888 const & color)
+// draws a line using current pen width. Thick lines may exceed the line rectangle expanded by half pen width, so they merge their area into updateRect
+void IRAM_ATTR DisplayController::absDrawPenLine(int X1, int Y1, int X2, int Y2, RGB888 const & color, Rect & updateRect)
+{
+  if (paintState().penWidth > 1)
+    absDrawThickLine(X1, Y1, X2, Y2, paintState().penWidth, color, updateRect);
+  else
+    absDrawLine(X1, Y1, X2, Y2, color);
+}
+
+
+void IRAM_ATTR DisplayController::absDrawThickLine(int X1, int Y1, int X2, int Y2, int penWidth, RGB888 const & color, Rect & updateRect)
 {
   // just to "de-absolutize"
   const int origX = paintState().origin.X;
@@ -1082,12 +2229,16 @@ void IRAM_ATTR DisplayController::absDrawThickLine(int X1, int Y1, int X2, int Y
 
   Point pts[4];
 
-  const double angle = atan2(Y2 - Y1, X2 - X1);
-  const double pw = (double)penWidth / 2.0;
-  const int ofs1 = lround(pw * cos(angle + M_PI_2));
-  const int ofs2 = lround(pw * sin(angle + M_PI_2));
-  const int ofs3 = lround(pw * cos(angle - M_PI_2));
-  const int ofs4 = lround(pw * sin(angle - M_PI_2));
+  // (ofs1, ofs2) is the normal vector of the line, long penWidth / 2
+  int dx = X2 - X1;
+  int dy = Y2 - Y1;
+  if (dx == 0 && dy == 0)
+    dx = 1;
+  const int64_t len2 = (int64_t)dx * dx + (int64_t)dy * dy;
+  const int ofs1 = -thickLineOffset(penWidth, dy, len2);
+  const int ofs2 =  thickLineOffset(penWidth, dx, len2);
+  const int ofs3 = -ofs1;
+  const int ofs4 = -ofs2;
   pts[0].X = X1 + ofs1;
   pts[0].Y = Y1 + ofs2;
   pts[1].X = X1 + ofs3;
@@ -1097,7 +2248,6 @@ void IRAM_ATTR DisplayController::absDrawThickLine(int X1, int Y1, int X2, int Y
   pts[3].X = X2 + ofs1;
   pts[3].Y = Y2 + ofs2;
 
-  Rect updateRect;
   Path path = { pts, 4, false };
   fillPath(path, color, updateRect);
 
@@ -1124,6 +2274,89 @@ void IRAM_ATTR DisplayController::drawBitmap(BitmapDrawingInfo const & bitmapDra
 }
 
 
+void IRAM_ATTR DisplayController::drawTileMap(TileMapDrawingInfo const & tileMapDrawingInfo, Rect & updateRect)
+{
+  Rect const & region = paintState().scrollingRegion;
+  updateRect = updateRect.merge(region);
+  hideSprites(updateRect);
+  drawTileMapArea(tileMapDrawingInfo.tileMap, region);
+}
+
+
+// moves the view scrolling the screen content, so only tiles of exposed strips are drawn
+void IRAM_ATTR DisplayController::scrollTileMap(TileMapDrawingInfo const & tileMapDrawingInfo, Rect & updateRect)
+{
+  auto tileMap = tileMapDrawingInfo.tileMap;
+  const int dx = tileMapDrawingInfo.offsetX;
+  const int dy = tileMapDrawingInfo.offsetY;
+
+  const int mapWidth  = tileMap->tileWidth * tileMap->columns;
+  const int mapHeight = tileMap->tileHeight * tileMap->rows;
+
+  Rect const & region = paintState().scrollingRegion;
+  updateRect = updateRect.merge(region);
+  hideSprites(updateRect);
+
+  if (abs(dx) >= region.width() || abs(dy) >= region.height()) {
+    // nothing to reuse
+    tileMap->viewX = ((tileMap->viewX + dx) % mapWidth + mapWidth) % mapWidth;
+    tileMap->viewY = ((tileMap->viewY + dy) % mapHeight + mapHeight) % mapHeight;
+    drawTileMapArea(tileMap, region);
+    return;
+  }
+
+  // vertical and horizontal strips are drawn after their own scroll, so each one sees the view it exposes
+  if (dy) {
+    tileMap->viewY = ((tileMap->viewY + dy) % mapHeight + mapHeight) % mapHeight;
+    VScroll(-dy, updateRect);
+    drawTileMapArea(tileMap, dy > 0 ? Rect(region.X1, region.Y2 - dy + 1, region.X2, region.Y2) : Rect(region.X1, region.Y1, region.X2, region.Y1 - dy - 1));
+  }
+  if (dx) {
+    tileMap->viewX = ((tileMap->viewX + dx) % mapWidth + mapWidth) % mapWidth;
+    HScroll(-dx, updateRect);
+    drawTileMapArea(tileMap, dx > 0 ? Rect(region.X2 - dx + 1, region.Y1, region.X2, region.Y2) : Rect(region.X1, region.Y1, region.X1 - dx - 1, region.Y2));
+  }
+}
+
+
+// draws the tiles covering area (absolute coordinates inside the scrolling region)
+void IRAM_ATTR DisplayController::drawTileMapArea(TileMap const * tileMap, Rect const & area)
+{
+  Rect const & region = paintState().scrollingRegion;
+
+  // draw tiles clipped to the area
+  const Rect savedClippingRect = paintState().absClippingRect;
+  const Rect clip = area.intersection(savedClippingRect);
+  if (clip.X1 > clip.X2 || clip.Y1 > clip.Y2)
+    return;
+  paintState().absClippingRect = clip;
+
+  const int tileWidth  = tileMap->tileWidth;
+  const int tileHeight = tileMap->tileHeight;
+  const int mapWidth   = tileWidth * tileMap->columns;
+  const int mapHeight  = tileHeight * tileMap->rows;
+
+  // map position of the top-left clipped pixel
+  const int mapX = ((tileMap->viewX + clip.X1 - region.X1) % mapWidth + mapWidth) % mapWidth;
+  const int mapY = ((tileMap->viewY + clip.Y1 - region.Y1) % mapHeight + mapHeight) % mapHeight;
+
+  int row = mapY / tileHeight;
+  for (int y = clip.Y1 - mapY % tileHeight; y <= clip.Y2; y += tileHeight) {
+    uint8_t const * mapRow = tileMap->map + row * tileMap->columns;
+    int col = mapX / tileWidth;
+    for (int x = clip.X1 - mapX % tileWidth; x <= clip.X2; x += tileWidth) {
+      absDrawBitmap(x, y, tileMap->tiles[mapRow[col]], nullptr, false);
+      if (++col == tileMap->columns)
+        col = 0;
+    }
+    if (++row == tileMap->rows)
+      row = 0;
+  }
+
+  paintState().absClippingRect = savedClippingRect;
+}
+
+
 void IRAM_ATTR DisplayController::absDrawBitmap(int destX, int destY, Bitmap const * bitmap, void * saveBackground, bool ignoreClippingRect)
 {
   const int clipX1 = ignoreClippingRect ? 0 : paintState().absClippingRect.X1;
@@ -1167,6 +2400,11 @@ void IRAM_ATTR DisplayController::absDrawBitmap(int destX, int destY, Bitmap con
   if (Y1 + YCount > height)
     YCount = height - Y1;
 
+  if (isBitmapPrepared(bitmap)) {
+    rawDrawBitmap_Runs(destX, destY, bitmap, saveBackground, X1, Y1, XCount, YCount);
+    return;
+  }
+
   switch (bitmap->format) {
 
     case PixelFormat::Undefined:
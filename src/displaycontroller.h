@@ -34,6 +34,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdio.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
@@ -41,6 +42,11 @@
 #include "fabglconf.h"
 #include "fabutils.h"
 
+#if FABGLIB_EXEC_QUEUE_LOCKFREE
+#include <atomic>
+#include "freertos/semphr.h"
+#endif
+
 
 
 
@@ -180,9 +186,39 @@ enum PrimitiveCmd : uint8_t {
   // Set line ends
   // params: lineEnds
   SetLineEnds,
+
+  // Draw a tile map inside the scrolling region
+  // params: tileMapDrawingInfo
+  DrawTileMap,
+
+  // Move tile map view, scrolling the scrolling region and drawing only exposed tiles
+  // params: tileMapDrawingInfo
+  ScrollTileMap,
+
+  // Execute primitives recorded by DisplayController.beginRecording() and endRecording(), moved by an offset
+  // params: recordingPlayInfo
+  ExecuteRecording,
+
+  // Execute a block of primitives (generated by DisplayController.addPrimitives() and batches)
+  // params: batch
+  ExecuteBatch,
 };
 
 
+// number of primitive commands (ExecuteBatch must be kept as the last command)
+#define PRIMITIVECMD_COUNT (PrimitiveCmd::ExecuteBatch + 1)
+
+
+/**
+ * @brief Gets the name of a primitive command
+ *
+ * @param cmd Primitive command.
+ *
+ * @return Command name (ie "FillRect").
+ */
+char const * primitiveCmdName(PrimitiveCmd cmd);
+
+
 
 /** \ingroup Enumerations
  * @brief This enum defines named colors.
@@ -403,6 +439,10 @@ enum class NativePixelFormat : uint8_t {
   Mono,       /**< 1 bit per pixel. 0 = black, 1 = white */
   SBGR2222,   /**< 8 bit per pixel: VHBBGGRR (bit 7=VSync 6=HSync 5=B 4=B 3=G 2=G 1=R 0=R). Each color channel can have values from 0 to 3 (maxmum intensity). */
   RGB565BE,   /**< 16 bit per pixel: RGB565 big endian. */
+  RGB888,     /**< 24 bit per pixel: R, G and B bytes. Minimum value for each channel is 0, maximum is 255. */
+  Palette2,   /**< 1 bit per pixel, index of a 2 colors palette. Native bitmaps contain one index per byte. */
+  Palette4,   /**< 2 bits per pixel, index of a 4 colors palette. Native bitmaps contain one index per byte. */
+  Palette16,  /**< 4 bits per pixel, index of a 16 colors palette. Native bitmaps contain one index per byte. */
 };
 
 
@@ -427,8 +467,29 @@ enum class LineEnds : uint8_t {
 };
 
 
+class DisplayController;
+
+
+/**
+ * @brief Opaque pixels of a bitmap converted to the native format of a display controller (see DisplayController.prepareBitmap())
+ *
+ * Each row is a sequence of runs. A run begins with two uint16_t values: the number of transparent pixels to skip and the number of
+ * opaque pixels that follow, then the opaque pixels in native format (padded to an even number of bytes). A run with no opaque pixels ends the row.
+ */
+struct BitmapRuns {
+  DisplayController * displayController; /**< Display controller whose native format is used */
+  NativePixelFormat   format;            /**< Native format of the display controller when the runs have been created */
+  int8_t              pixelSize;         /**< Size in bytes of each pixel (DisplayController.getBitmapSavePixelSize()) */
+  uint32_t *          rowOffset;         /**< Offset in data of the first run of each row */
+  uint8_t *           data;              /**< Runs */
+};
+
+
 /**
  * @brief Represents an image
+ *
+ * Native runs created by DisplayController.prepareBitmap() are owned by the bitmap and released when it is destroyed. Copies
+ * get their own copy of allocated data (otherwise they point to the same data) and no runs, so a copy has to be prepared again.
  */
 struct Bitmap {
   int16_t         width;           /**< Bitmap horizontal size */
@@ -437,12 +498,16 @@ struct Bitmap {
   RGB888          foregroundColor; /**< Foreground color when format is PixelFormat::Mask */
   uint8_t *       data;            /**< Bitmap binary data */
   bool            dataAllocated;   /**< If true data is released when bitmap is destroyed */
+  BitmapRuns *    runs;            /**< Native runs created by DisplayController.prepareBitmap() and owned by this bitmap, nullptr if the bitmap has not been prepared */
 
-  Bitmap() : width(0), height(0), format(PixelFormat::Undefined), foregroundColor(RGB888(255, 255, 255)), data(nullptr), dataAllocated(false) { }
+  Bitmap() : width(0), height(0), format(PixelFormat::Undefined), foregroundColor(RGB888(255, 255, 255)), data(nullptr), dataAllocated(false), runs(nullptr) { }
   Bitmap(int width_, int height_, void const * data_, PixelFormat format_, bool copy = false);
   Bitmap(int width_, int height_, void const * data_, PixelFormat format_, RGB888 foregroundColor_, bool copy = false);
+  Bitmap(Bitmap const & bitmap);
   ~Bitmap();
 
+  Bitmap & operator=(Bitmap const & bitmap);
+
   void setPixel(int x, int y, int value);       // use with PixelFormat::Mask. value can be 0 or not 0
   void setPixel(int x, int y, RGBA2222 value);  // use with PixelFormat::RGBA2222
   void setPixel(int x, int y, RGBA8888 value);  // use with PixelFormat::RGBA8888
@@ -464,6 +529,36 @@ struct BitmapDrawingInfo {
 } __attribute__ ((packed));
 
 
+/**
+ * @brief Represents a map of tiles, drawn inside the scrolling region using Canvas.drawTileMap() and Canvas.scrollTileMap()
+ *
+ * All tiles must have the same size. The map wraps around horizontally and vertically.
+ */
+struct TileMap {
+  int16_t    tileWidth;   /**< Tile horizontal size, in pixels */
+  int16_t    tileHeight;  /**< Tile vertical size, in pixels */
+  int16_t    columns;     /**< Map horizontal size, in tiles */
+  int16_t    rows;        /**< Map vertical size, in tiles */
+  Bitmap * * tiles;       /**< Tile set. Native bitmaps and prepared bitmaps (see DisplayController.prepareBitmap()) are the fastest to draw */
+  uint8_t *  map;         /**< Indexes in tiles, columns x rows items */
+  int16_t    viewX;       /**< Map horizontal position (in pixels) shown at the left side of scrolling region. Updated when Canvas.scrollTileMap() is executed */
+  int16_t    viewY;       /**< Map vertical position (in pixels) shown at the top side of scrolling region. Updated when Canvas.scrollTileMap() is executed */
+
+  TileMap() : tileWidth(0), tileHeight(0), columns(0), rows(0), tiles(nullptr), map(nullptr), viewX(0), viewY(0) { }
+  TileMap(int tileWidth_, int tileHeight_, int columns_, int rows_, Bitmap * * tiles_, uint8_t * map_)
+    : tileWidth(tileWidth_), tileHeight(tileHeight_), columns(columns_), rows(rows_), tiles(tiles_), map(map_), viewX(0), viewY(0) { }
+};
+
+
+struct TileMapDrawingInfo {
+  TileMap * tileMap;
+  int16_t   offsetX;  // view movement (ScrollTileMap only)
+  int16_t   offsetY;
+
+  TileMapDrawingInfo(TileMap * tileMap_, int offsetX_, int offsetY_) : tileMap(tileMap_), offsetX(offsetX_), offsetY(offsetY_) { }
+} __attribute__ ((packed));
+
+
 /** \ingroup Enumerations
  * @brief This enum defines a set of predefined mouse cursors.
  */
@@ -556,6 +651,37 @@ struct Path {
 } __attribute__ ((packed));
 
 
+// fillPath() edge table entry
+struct FillPathEdge {
+  int startY; // first crossed scanline
+  int endY;   // last crossed scanline
+  int X;      // ceiling of the intersection with current scanline
+  int err;    // X * dy - exact intersection * dy
+  int dy;
+  int stepX;
+  int stepR;
+};
+
+
+struct Primitive;
+
+struct PrimitiveBatch {
+  Primitive const * primitives; // allocated by DisplayController, deallocated after execution
+  int16_t           count;
+} __attribute__ ((packed));
+
+
+class PrimitiveRecording;
+
+struct RecordingPlayInfo {
+  int16_t                    X;  // offset added to current origin
+  int16_t                    Y;
+  PrimitiveRecording const * recording;
+
+  RecordingPlayInfo(int X_, int Y_, PrimitiveRecording const * recording_) : X(X_), Y(Y_), recording(recording_) { }
+} __attribute__ ((packed));
+
+
 /**
  * @brief Specifies general paint options.
  */
@@ -586,9 +712,12 @@ struct Primitive {
     PaintOptions           paintOptions;
     GlyphsBufferRenderInfo glyphsBufferRenderInfo;
     BitmapDrawingInfo      bitmapDrawingInfo;
+    TileMapDrawingInfo     tileMapDrawingInfo;
     Path                   path;
     PixelDesc              pixelDesc;
     LineEnds               lineEnds;
+    PrimitiveBatch         batch;
+    RecordingPlayInfo      recordingPlayInfo;
   } __attribute__ ((packed));
 
   Primitive() { }
@@ -597,6 +726,105 @@ struct Primitive {
 } __attribute__ ((packed));
 
 
+/**
+ * @brief Represents a block of primitives recorded by Canvas.beginRecord() and Canvas.endRecord()
+ *
+ * A recording can be replayed many times using Canvas.playRecord(), moved to a different position.<br>
+ * Points of paths are copied into the recording. Other data referenced by primitives (glyphs, bitmaps, glyphs buffers, tile maps...)
+ * is not copied, so it must remain valid while the recording is used.<br>
+ * State changes without effects (ie a pen color set again before drawing anything, or set to the same color) are not recorded.
+ */
+class PrimitiveRecording {
+
+public:
+
+  PrimitiveRecording();
+
+  ~PrimitiveRecording();
+
+  // unwanted methods
+  PrimitiveRecording(PrimitiveRecording const&) = delete;
+  void operator=(PrimitiveRecording const&)     = delete;
+
+  /**
+   * @brief Determines the number of recorded primitives
+   *
+   * @return Number of recorded primitives.
+   */
+  int count() const                     { return m_count; }
+
+  /**
+   * @brief Gets recorded primitives
+   *
+   * @return Array of count() primitives.
+   */
+  Primitive const * primitives() const  { return m_primitives; }
+
+private:
+
+  friend class DisplayController;
+
+  bool add(Primitive const & primitive);
+
+  void remove(int index);
+
+  void finalize();
+
+
+  Primitive *  m_primitives;
+  int          m_count;
+  int          m_capacity;
+
+  // points of all recorded paths. While recording Path.points contains the offset inside m_points, replaced by finalize()
+  Point *      m_points;
+  int          m_pointsCount;
+
+  // number of points of the largest filled path, also of played recordings
+  int          m_maxFillPathPoints;
+
+  // index of the last recorded command for each state command (-1 = never recorded)
+  int16_t      m_lastState[PRIMITIVECMD_COUNT];
+
+  // index of the first of the state commands at the end of recorded primitives
+  int          m_stateCmdsStart;
+};
+
+
+#if FABGLIB_PRIMITIVES_PROFILER
+
+/**
+ * @brief Execution statistics of a primitive command, collected by DisplayController when FABGLIB_PRIMITIVES_PROFILER is 1
+ */
+struct PrimitiveProfileStats {
+  uint32_t count;        /**< Number of executed primitives */
+  uint64_t totalCycles;  /**< Total execution time in CPU cycles */
+  uint32_t minCycles;    /**< Minimum execution time in CPU cycles */
+  uint32_t maxCycles;    /**< Maximum execution time in CPU cycles */
+  uint64_t pixels;       /**< Sum of the areas updated by the primitives */
+};
+
+
+/**
+ * @brief Execution statistics collected by DisplayController when FABGLIB_PRIMITIVES_PROFILER is 1
+ *
+ * Execution time of ExecuteRecording includes the primitives it contains, which are also counted separately. Queued batches are
+ * executed one primitive at the time, so ExecuteBatch is not counted.
+ * Execution time of a primitive includes the time spent hiding sprites.
+ */
+struct PrimitivesProfile {
+  PrimitiveProfileStats primitives[PRIMITIVECMD_COUNT];  /**< Statistics of each primitive command */
+  uint32_t              hideSpritesCount;               /**< Number of times sprites have been hidden */
+  uint64_t              hideSpritesCycles;              /**< CPU cycles spent hiding sprites */
+  uint32_t              showSpritesCount;               /**< Number of times sprites have been shown */
+  uint64_t              showSpritesCycles;              /**< CPU cycles spent showing sprites */
+  uint32_t              queueSamples;                   /**< Number of primitives queue depth samples (one for each item added to the queue) */
+  uint64_t              queueDepthTotal;                /**< Sum of sampled queue depths (average depth = queueDepthTotal / queueSamples) */
+  uint32_t              queueDepthMax;                  /**< Maximum sampled queue depth */
+};
+
+#endif
+
+
 struct PaintState {
   RGB888       penColor;
   RGB888       brushColor;
@@ -612,6 +840,42 @@ struct PaintState {
 };
 
 
+// max number of rectangles stored by DirtyRegion
+#define DIRTYREGION_MAX_RECTS 8
+
+
+/**
+ * @brief Bounded list of non overlapping rectangles that need to be sent to the display
+ *
+ * Rectangles added to the region are merged with the ones they overlap. Not overlapping rectangles are merged when the merged rectangle
+ * contains no more than mergeCost pixels more than the two rectangles (the cost of sending a rectangle to the display, in pixels).<br>
+ * When the list is full the new rectangle is merged with the one that produces the smallest merged area.
+ */
+class DirtyRegion {
+
+public:
+
+  DirtyRegion(int mergeCost = 0) : m_count(0), m_mergeCost(mergeCost) { }
+
+  void clear()                             { m_count = 0; }
+
+  // empty rectangles (X1 > X2 or Y1 > Y2) are ignored
+  void add(Rect const & rect);
+
+  int count()                              { return m_count; }
+
+  Rect const & operator[](int index) const { return m_rects[index]; }
+
+private:
+
+  void remove(int index)                   { m_rects[index] = m_rects[--m_count]; }
+
+  Rect m_rects[DIRTYREGION_MAX_RECTS];
+  int  m_count;
+  int  m_mergeCost;
+};
+
+
 
 
 /**
@@ -664,8 +928,59 @@ public:
 
   void addPrimitive(Primitive & primitive);
 
+  /**
+   * @brief Adds a block of primitives.
+   *
+   * When primitives are executed in background the whole block is copied and added to the queue using a single
+   * queue item (PrimitiveCmd::ExecuteBatch), so the queue is locked only once every FABGLIB_PRIMITIVES_BATCH_SIZE primitives.<br>
+   * Otherwise primitives are executed immediately, as with addPrimitive().<br>
+   * Data referenced by the primitives (glyphs, bitmaps...) must remain valid until primitives are executed, while paths are copied.
+   *
+   * @param primitives Array of primitives to add.
+   * @param count Number of primitives in the array.
+   */
+  void addPrimitives(Primitive const * primitives, int count);
+
+  /**
+   * @brief Starts collecting primitives into a batch.
+   *
+   * Primitives added after beginBatch() are not sent to the queue one by one, but collected and sent in blocks
+   * of FABGLIB_PRIMITIVES_BATCH_SIZE primitives. Remaining primitives are sent calling submitBatch().<br>
+   * This method maintains a counter so can be nested.
+   */
+  void beginBatch();
+
+  /**
+   * @brief Sends primitives collected after beginBatch().
+   *
+   * Collected primitives are sent when the counter incremented by beginBatch() reaches zero.
+   */
+  void submitBatch();
+
   void primitivesExecutionWait();
 
+  /**
+   * @brief Starts recording primitives.
+   *
+   * Primitives added after beginRecording() are not executed, but stored in a PrimitiveRecording, returned by endRecording().<br>
+   * Recordings cannot be nested.
+   */
+  void beginRecording();
+
+  /**
+   * @brief Stops recording primitives.
+   *
+   * @return The recording, or nullptr if beginRecording() has not been called or memory was not enough. Delete it when not needed anymore.
+   */
+  PrimitiveRecording * endRecording();
+
+  /**
+   * @brief Determines whether primitives are being recorded.
+   *
+   * @return True between beginRecording() and endRecording().
+   */
+  bool isRecording()                                { return m_recording != nullptr; }
+
   /**
    * @brief Enables or disables drawings inside vertical retracing time.
    *
@@ -679,6 +994,13 @@ public:
    */
   void enableBackgroundPrimitiveExecution(bool value);
 
+  /**
+   * @brief Determines whether primitives are executed in background.
+   *
+   * @return True if primitives are added to the queue and executed in background, False if they are executed immediately.
+   */
+  bool backgroundPrimitiveExecutionEnabled()        { return m_backgroundPrimitiveExecutionEnabled; }
+
   /**
    * @brief Enables or disables execution time limitation inside vertical retracing interrupt
    *
@@ -690,6 +1012,56 @@ public:
 
   bool backgroundPrimitiveTimeoutEnabled()          { return m_backgroundPrimitiveTimeoutEnabled; }
 
+  /**
+   * @brief Enables or disables the optimization of executed primitives
+   *
+   * When enabled, before primitives are executed:
+   *   - state changes which don't change current state (ie setting the current pen color) are skipped
+   *   - consecutive filled rectangles of the same color which form a rectangle are painted as one rectangle
+   *   - drawings outside of the clipping rectangle are skipped before sprites are hidden
+   *
+   * Useful when drawings are generated by many independent paint handlers (ie fabgl::uiApp) which repeat state changes.
+   *
+   * @param value True enables optimization, False disables optimization (default)
+   */
+  void enablePrimitivesOptimizer(bool value)         { m_primitivesOptimizerEnabled = value; }
+
+  bool primitivesOptimizerEnabled()                  { return m_primitivesOptimizerEnabled; }
+
+#if FABGLIB_PRIMITIVES_PROFILER
+
+  /**
+   * @brief Gets statistics of executed primitives
+   *
+   * Available only when FABGLIB_PRIMITIVES_PROFILER is 1. Statistics are updated while primitives are executed.
+   *
+   * Example:
+   *
+   *     DisplayController.resetPrimitivesProfile();
+   *     // ...paint some frames...
+   *     DisplayController.printPrimitivesProfile();
+   *
+   * @return Collected statistics.
+   */
+  PrimitivesProfile const & primitivesProfile()      { return m_profile; }
+
+  /**
+   * @brief Clears statistics of executed primitives
+   */
+  void resetPrimitivesProfile();
+
+  /**
+   * @brief Prints statistics of executed primitives
+   *
+   * For each executed command prints count, average/min/max time in microseconds, total time and painted pixels,
+   * followed by sprites and queue statistics.
+   *
+   * @param stream Where to print statistics.
+   */
+  void printPrimitivesProfile(FILE * stream = stdout);
+
+#endif
+
   /**
    * @brief Suspends drawings.
    *
@@ -760,6 +1132,27 @@ public:
    */
   void refreshSprites();
 
+  /**
+   * @brief Prepares a bitmap to be drawn faster by this display controller.
+   *
+   * Opaque pixels of RGBA2222 and RGBA8888 bitmaps are converted to the native format and grouped in horizontal runs, so drawing
+   * copies whole runs and skips transparent pixels without testing alpha and converting each pixel.<br>
+   * Call this method before the bitmap is drawn (for example before it is assigned to a sprite). When bitmap pixels change
+   * the bitmap must be prepared again. Prepared bitmaps are ignored by other display controllers, and when the native format
+   * of this display controller changes (ie FramebufferController.setResolution()).<br>
+   * When the bitmap was already prepared, waits for pending primitives before replacing its runs.
+   *
+   * @param bitmap The bitmap to prepare.
+   *
+   * @return True if the bitmap has been prepared. False if bitmap format or display controller doesn't support prepared bitmaps, or there is not enough memory.
+   *
+   * Example:
+   *
+   *     static Bitmap ship = Bitmap(16, 16, &ship_data[0], PixelFormat::RGBA2222);
+   *     DisplayController.prepareBitmap(&ship);
+   */
+  bool prepareBitmap(Bitmap * bitmap);
+
   /**
    * @brief Determines whether DisplayController is on double buffered mode.
    *
@@ -833,10 +1226,41 @@ protected:
 
   virtual void rawDrawBitmap_RGBA8888(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount) = 0;
 
+  //// overridable methods
+
+  // Converts color to native format (getBitmapSavePixelSize() bytes) for prepareBitmap().
+  // Returns false when the display controller cannot draw prepared bitmaps.
+  virtual bool rawColorToNative(RGB888 const & color, void * dest) { return false; }
+
+  // draws a bitmap prepared by prepareBitmap()
+  virtual void rawDrawBitmap_Runs(int destX, int destY, Bitmap const * bitmap, void * saveBackground, int X1, int Y1, int XCount, int YCount) { }
+
   //// implemented methods
 
+  // true when bitmap runs have been prepared by this display controller, using its current native format
+  bool isBitmapPrepared(Bitmap const * bitmap);
+
   void execPrimitive(Primitive const & prim, Rect & updateRect);
 
+  void execPrimitiveCmd(Primitive const & prim, Rect & updateRect);
+
+  bool optimizePrimitive(Primitive const & prim, Rect & updateRect);
+
+#if FABGLIB_PRIMITIVES_PROFILER
+  void profilePrimitive(PrimitiveCmd cmd, uint32_t cycles, Rect const & updateRect);
+  void profileQueueDepth();
+#endif
+
+  void flushPendingFill(Rect & updateRect);
+
+  // executes the primitive adding updated area to dirtyRegion (batches are split in the single primitives)
+  void execPrimitive(Primitive const & prim, DirtyRegion & dirtyRegion);
+
+  template <typename TUpdate>
+  void execRecording(RecordingPlayInfo const & playInfo, TUpdate & update);
+
+  void showSprites(DirtyRegion & dirtyRegion);
+
   void updateAbsoluteClippingRect();
 
   RGB888 getActualPenColor();
@@ -849,7 +1273,9 @@ protected:
 
   void drawPath(Path const & path, Rect & updateRect);
 
-  void absDrawThickLine(int X1, int Y1, int X2, int Y2, int penWidth, RGB888 const & color);
+  void absDrawPenLine(int X1, int Y1, int X2, int Y2, RGB888 const & color, Rect & updateRect);
+
+  void absDrawThickLine(int X1, int Y1, int X2, int Y2, int penWidth, RGB888 const & color, Rect & updateRect);
 
   void fillRect(Rect const & rect, RGB888 const & color, Rect & updateRect);
 
@@ -865,12 +1291,19 @@ protected:
 
   int spritesCount() { return m_spritesCount; }
 
-  void hideSprites(Rect & updateRect);
+  // hides sprites intersecting updateRect (or all sprites), updateRect must already include the area going to be painted
+  void hideSprites(Rect & updateRect, bool allSprites = false);
 
   void showSprites(Rect & updateRect);
 
   void drawBitmap(BitmapDrawingInfo const & bitmapDrawingInfo, Rect & updateRect);
 
+  void drawTileMap(TileMapDrawingInfo const & tileMapDrawingInfo, Rect & updateRect);
+
+  void scrollTileMap(TileMapDrawingInfo const & tileMapDrawingInfo, Rect & updateRect);
+
+  void drawTileMapArea(TileMap const * tileMap, Rect const & area);
+
   void absDrawBitmap(int destX, int destY, Bitmap const * bitmap, void * saveBackground, bool ignoreClippingRect);
 
   void setDoubleBuffered(bool value) { m_doubleBuffered = value; }
@@ -881,6 +1314,9 @@ protected:
 
   void waitForPrimitives();
 
+  // number of primitives waiting in the queue
+  int execQueueCount();
+
   Sprite * mouseCursor() { return &m_mouseCursor; }
 
   void resetPaintState();
@@ -889,11 +1325,37 @@ private:
 
   void primitiveReplaceDynamicBuffers(Primitive & primitive);
 
+  void addBatchPrimitive(Primitive const & primitive);
+
+  void execQueueSend(Primitive const & primitive);
+
+  void flushBatch();
+
+  bool beginBatchExecution(Primitive * primitive);
+
+  bool getBatchPrimitive(Primitive * primitive);
+
+  void reserveFillPathEdges(Primitive const & primitive);
+
+  void fillPathEdgeTable(Path const & path, RGB888 const & color, int minX, int maxX, int minY, int maxY);
+
 
   PaintState             m_paintState;
 
   volatile bool          m_doubleBuffered;
+#if FABGLIB_EXEC_QUEUE_LOCKFREE
+  // single producer (addPrimitive) / single consumer (getPrimitive, getPrimitiveISR, processPrimitives) ring buffer,
+  // with FABGLIB_EXEC_QUEUE_SIZE + 1 slots (one is always empty)
+  Primitive *            m_execQueue;
+  std::atomic<int>       m_execQueueHead;            // next slot to write, written only by producer
+  std::atomic<int>       m_execQueueTail;            // next slot to read, written only by consumer
+  std::atomic<bool>      m_execQueueProducerWaiting; // producer is waiting for m_execQueueNotFull
+  std::atomic<bool>      m_execQueueConsumerWaiting; // consumer is waiting for m_execQueueNotEmpty
+  SemaphoreHandle_t      m_execQueueNotFull;
+  SemaphoreHandle_t      m_execQueueNotEmpty;
+#else
   volatile QueueHandle_t m_execQueue;
+#endif
 
   bool                   m_backgroundPrimitiveExecutionEnabled; // when False primitives are execute immediately
   volatile bool          m_backgroundPrimitiveTimeoutEnabled;   // when False VSyncInterrupt() has not timeout
@@ -902,6 +1364,7 @@ private:
   int                    m_spriteSize;    // size of sprite structure
   int                    m_spritesCount;  // number of sprites in m_sprites array
   bool                   m_spritesHidden; // true between hideSprites() and showSprites()
+  Rect                   m_spritesHiddenRect; // area where sprites have been hidden, valid when m_spritesHidden is true
 
   // mouse cursor (mouse pointer) support
   Sprite                 m_mouseCursor;
@@ -911,6 +1374,35 @@ private:
   // memory pool used to allocate buffers of primitives
   LightMemoryPool        m_primDynMemPool;
 
+  // fillPath() edge table and active edges, grown by reserveFillPathEdges() because fillPath() may run inside an interrupt
+  FillPathEdge *         m_fillPathEdges;
+  FillPathEdge * *       m_fillPathActive;
+  int                    m_fillPathEdgesSize;  // number of points of largest fillable path
+
+  // batches support
+  Primitive *            m_batch;         // primitives collected and not yet sent (up to FABGLIB_PRIMITIVES_BATCH_SIZE)
+  int                    m_batchCount;    // number of primitives in m_batch
+  int                    m_batchLevel;    // >0 between beginBatch() and submitBatch()
+  LightMemoryPool *      m_batchMemPool;  // memory pool used to allocate sent batches (allocated on first use)
+  Primitive const *      m_execBatch;     // batch being executed by the consumer, see getBatchPrimitive()
+  volatile int16_t       m_execBatchCount; // number of primitives of m_execBatch, 0 when no batch is being executed
+  int16_t                m_execBatchIndex; // next primitive of m_execBatch to execute
+
+  // recordings support
+  PrimitiveRecording *   m_recording;     // not nullptr between beginRecording() and endRecording()
+  bool                   m_recordingFailed; // a primitive couldn't be recorded because memory is not enough
+  Point                  m_playOrigin;    // origin of the recording being executed, SetOrigin of recorded primitives is relative to it
+
+  // primitives optimizer
+  volatile bool          m_primitivesOptimizerEnabled;
+  bool                   m_pendingFill;       // true when m_pendingFillRect has not been painted yet
+  Rect                   m_pendingFillRect;   // absolute and clipped
+  RGB888                 m_pendingFillColor;
+
+#if FABGLIB_PRIMITIVES_PROFILER
+  PrimitivesProfile      m_profile;
+#endif
+
 };
 
 
@@ -947,13 +1439,10 @@ protected:
 
   // coordinates are absolute values (not relative to origin)
   // line clipped on current absolute clipping rectangle
+  // one pixel wide line, pen width is applied by absDrawPenLine()
   template <typename TPreparePixel, typename TRawFillRow, typename TRawInvertRow, typename TRawSetPixel, typename TRawInvertPixel>
   void genericAbsDrawLine(int X1, int Y1, int X2, int Y2, RGB888 const & color, TPreparePixel preparePixel, TRawFillRow rawFillRow, TRawInvertRow rawInvertRow, TRawSetPixel rawSetPixel, TRawInvertPixel rawInvertPixel)
   {
-    if (paintState().penWidth > 1) {
-      absDrawThickLine(X1, Y1, X2, Y2, paintState().penWidth, color);
-      return;
-    }
     auto pattern = preparePixel(color);
     if (Y1 == Y2) {
       // horizontal line
@@ -1343,6 +1832,27 @@ protected:
     auto penPattern   = preparePixel(penColor);
     auto brushPattern = preparePixel(brushColor);
 
+    // common font widths, not horizontally clipped
+    if (XCount == glyphWidth) {
+      switch (glyphWidth) {
+        case 6:
+          genericDrawGlyphRows<6>(glyphData, Y1, YCount, destX, destY, fillBackground, penPattern, brushPattern, rawGetRow, rawSetPixelInRow);
+          return;
+        case 8:
+          genericDrawGlyphRows<8>(glyphData, Y1, YCount, destX, destY, fillBackground, penPattern, brushPattern, rawGetRow, rawSetPixelInRow);
+          return;
+        case 9:
+          genericDrawGlyphRows<9>(glyphData, Y1, YCount, destX, destY, fillBackground, penPattern, brushPattern, rawGetRow, rawSetPixelInRow);
+          return;
+        case 10:
+          genericDrawGlyphRows<10>(glyphData, Y1, YCount, destX, destY, fillBackground, penPattern, brushPattern, rawGetRow, rawSetPixelInRow);
+          return;
+        case 16:
+          genericDrawGlyphRows<16>(glyphData, Y1, YCount, destX, destY, fillBackground, penPattern, brushPattern, rawGetRow, rawSetPixelInRow);
+          return;
+      }
+    }
+
     for (int y = Y1; y < Y1 + YCount; ++y, ++destY) {
       auto dstrow = rawGetRow(destY);
       uint8_t const * srcrow = glyphData + y * glyphWidthByte;
@@ -1363,6 +1873,31 @@ protected:
   }
 
 
+  // draws rows Y1...Y1+YCount-1 of a glyph WIDTH pixels wide (max 16), starting at destX, destY
+  // the glyph must not be horizontally clipped. Rows loops have fixed length, so the compiler can unroll them.
+  template <int WIDTH, typename TPattern, typename TRawGetRow, typename TRawSetPixelInRow>
+  void genericDrawGlyphRows(uint8_t const * glyphData, int Y1, int YCount, int destX, int destY, bool fillBackground, TPattern penPattern, TPattern brushPattern, TRawGetRow rawGetRow, TRawSetPixelInRow rawSetPixelInRow)
+  {
+    const int glyphWidthByte = (WIDTH + 7) / 8;
+    uint8_t const * srcrow = glyphData + Y1 * glyphWidthByte;
+    for (int y = 0; y < YCount; ++y, ++destY, srcrow += glyphWidthByte) {
+      auto dstrow = rawGetRow(destY);
+      // leftmost pixel at bit 15
+      uint32_t src = glyphWidthByte == 1 ? (srcrow[0] << 8) : ((srcrow[0] << 8) | srcrow[1]);
+      if (fillBackground) {
+        // filled background
+        for (int x = 0; x < WIDTH; ++x, src <<= 1)
+          rawSetPixelInRow(dstrow, destX + x, src & 0x8000 ? penPattern : brushPattern);
+      } else if (src) {
+        // transparent background
+        for (int x = 0; x < WIDTH; ++x, src <<= 1)
+          if (src & 0x8000)
+            rawSetPixelInRow(dstrow, destX + x, penPattern);
+      }
+    }
+  }
+
+
   template <typename TRawInvertRow>
   void genericInvertRect(Rect const & rect, Rect & updateRect, TRawInvertRow rawInvertRow)
   {
@@ -1422,6 +1957,34 @@ protected:
   }
 
 
+  // swap is done by rows, rawSwapFGBGRow(y, x1, x2, penPattern, brushPattern)
+  template <typename TPreparePixel, typename TRawSwapFGBGRow>
+  void genericSwapFGBG(Rect const & rect, Rect & updateRect, TPreparePixel preparePixel, TRawSwapFGBGRow rawSwapFGBGRow)
+  {
+    auto penPattern   = preparePixel(paintState().penColor);
+    auto brushPattern = preparePixel(paintState().brushColor);
+
+    const int origX = paintState().origin.X;
+    const int origY = paintState().origin.Y;
+
+    const int clipX1 = paintState().absClippingRect.X1;
+    const int clipY1 = paintState().absClippingRect.Y1;
+    const int clipX2 = paintState().absClippingRect.X2;
+    const int clipY2 = paintState().absClippingRect.Y2;
+
+    const int x1 = iclamp(rect.X1 + origX, clipX1, clipX2);
+    const int y1 = iclamp(rect.Y1 + origY, clipY1, clipY2);
+    const int x2 = iclamp(rect.X2 + origX, clipX1, clipX2);
+    const int y2 = iclamp(rect.Y2 + origY, clipY1, clipY2);
+
+    updateRect = updateRect.merge(Rect(x1, y1, x2, y2));
+    hideSprites(updateRect);
+
+    for (int y = y1; y <= y2; ++y)
+      rawSwapFGBGRow(y, x1, x2, penPattern, brushPattern);
+  }
+
+
   template <typename TRawGetRow, typename TRawGetPixelInRow, typename TRawSetPixelInRow>
   void genericCopyRect(Rect const & source, Rect & updateRect, TRawGetRow rawGetRow, TRawGetPixelInRow rawGetPixelInRow, TRawSetPixelInRow rawSetPixelInRow)
   {
@@ -1599,6 +2162,42 @@ protected:
   }
 
 
+  // draws a bitmap prepared by prepareBitmap(): runs of opaque pixels are copied with rawCopyToRow(), transparent pixels are skipped
+  // rawCopyFromRow(row, x, dest, count) saves count pixels of background
+  // rawCopyToRow(row, x, src, count) copies count native pixels
+  template <typename TPixel, typename TRawGetRow, typename TRawCopyFromRow, typename TRawCopyToRow>
+  void genericRawDrawBitmap_Runs(int destX, int destY, Bitmap const * bitmap, TPixel * saveBackground, int X1, int Y1, int XCount, int YCount,
+                                 TRawGetRow rawGetRow, TRawCopyFromRow rawCopyFromRow, TRawCopyToRow rawCopyToRow)
+  {
+    const int width = bitmap->width;
+    const int yEnd  = Y1 + YCount;
+    const int xEnd  = X1 + XCount;
+    auto runs = bitmap->runs;
+
+    for (int y = Y1; y < yEnd; ++y, ++destY) {
+      auto dstrow = rawGetRow(destY);
+      if (saveBackground)
+        rawCopyFromRow(dstrow, destX, saveBackground + y * width + X1, XCount);
+      auto run = runs->data + runs->rowOffset[y];
+      for (int x = 0; x < xEnd; ) {
+        const int skip  = ((uint16_t const *) run)[0];
+        const int count = ((uint16_t const *) run)[1];
+        if (count == 0)
+          break;
+        auto src = (TPixel const *) (run + 4);
+        run += 4 + ((count * sizeof(TPixel) + 1) & ~1);
+        x += skip;
+        // clip run to X1...xEnd
+        const int rx1 = tmax(x, X1);
+        const int rx2 = tmin(x + count, xEnd);
+        if (rx1 < rx2)
+          rawCopyToRow(dstrow, destX + rx1 - X1, src + rx1 - x, rx2 - rx1);
+        x += count;
+      }
+    }
+  }
+
+
   // Scroll is done copying and filling rows
   // scroll < 0 -> scroll UP
   // scroll > 0 -> scroll DOWN
@@ -73,6 +73,7 @@
  *    * fabgl::VGAController, device driver for VGA output.
  *    * fabgl::SSD1306Controller, device driver for SSD1306 based OLED displays.
  *    * fabgl::ST7789Controller, device driver for ST7789 based TFT displays.
+ *    * fabgl::FramebufferController, device driver that paints into a memory buffer (no display hardware).
  *    * fabgl::Canvas, that provides a set of drawing primitives (lines, rectangles, text...).
  *    * fabgl::Terminal, that emulates an ANSI/VT100/VT102 and up terminal (look at @ref vttest "vttest score").
  *    * fabgl::Keyboard, that controls a PS2 keyboard and translates scancodes to virtual keys or ASCII/ANSI codes.
@@ -275,8 +276,11 @@
 #include "terminal.h"
 #include "displaycontroller.h"
 #include "dispdrivers/vgacontroller.h"
+#include "dispdrivers/vgapackedcontroller.h"
+#include "dispdrivers/vgadisplaylistcontroller.h"
 #include "dispdrivers/SSD1306Controller.h"
 #include "dispdrivers/ST7789Controller.h"
+#include "dispdrivers/FramebufferController.h"
 #include "comdrivers/ps2controller.h"
 #include "comdrivers/tsi2c.h"
 #include "devdrivers/keyboard.h"
@@ -284,6 +288,7 @@
 #include "devdrivers/DS3231.h"
 #include "scene.h"
 #include "collisiondetector.h"
+#include "primitivebenchmark.h"
 #include "devdrivers/soundgen.h"
 
 
@@ -39,6 +39,13 @@
 #define FABGLIB_XTAL 40000000
 
 
+/** If 1 only the hardware independent parts of FabGL (DisplayController, Canvas, fonts, FramebufferController, PrimitiveBenchmark...) can be built,
+ * on a host machine, using the FreeRTOS shim in tools/hostshim. Usually defined on the host compiler command line (-DFABGLIB_HOST_BUILD=1). */
+#ifndef FABGLIB_HOST_BUILD
+#define FABGLIB_HOST_BUILD 0
+#endif
+
+
 /** Blink (cursor, text blink, ...) period in ms. */
 #define FABGLIB_DEFAULT_BLINK_PERIOD_MS 500
 
@@ -47,11 +54,34 @@
 #define FABGLIB_EXEC_QUEUE_SIZE 1024
 
 
+/** If 1 the primitives queue is implemented as a lock-free single producer/single consumer ring buffer instead of a FreeRTOS queue.
+ * Primitives can be added by a single task only, but executors (ie VGA vertical sync interrupt) don't enter critical sections. */
+#define FABGLIB_EXEC_QUEUE_LOCKFREE 0
+
+
 /** Size (in bytes) of primitives dynamic buffers. Used by primitives like drawPath and fillPath to contain path points. */
 #define FABGLIB_PRIMITIVES_DYNBUFFERS_SIZE 512
 
 
-/** Number of characters the terminal can "write" without pause (increase if you have loss of characters in serial port). */
+/** Number of points of the fillPath edge table initially allocated by DisplayController (each point takes 32 bytes). The table is
+ * grown when a larger path is sent. */
+#define FABGLIB_FILLPATH_MIN_EDGES 16
+
+
+/** Maximum number of primitives sent to the primitives queue as a single item by DisplayController.addPrimitives() and batches. */
+#define FABGLIB_PRIMITIVES_BATCH_SIZE 64
+
+
+/** If 1 DisplayController measures execution cycles and painted area of each primitive command, sprites hiding and showing cycles and
+ * primitives queue depth (see DisplayController.primitivesProfile()). Adds a small overhead to every executed primitive. */
+#define FABGLIB_PRIMITIVES_PROFILER 0
+
+
+/** Size (in bytes) of the buffers containing batches waiting to be executed. */
+#define FABGLIB_PRIMITIVES_BATCHBUFFERS_SIZE 4096
+
+
+/** Number of characters the terminal can "write" without pause (increase if you have loss of characters in serial port). Rounded up to a power of two. */
 #define FABGLIB_TERMINAL_INPUT_QUEUE_SIZE 1024
 
 
@@ -63,6 +93,14 @@
 #define FABGLIB_TERMINAL_XON_THRESHOLD  (FABGLIB_TERMINAL_INPUT_QUEUE_SIZE / 4)
 
 
+/** Period (in milliseconds) of terminal screen updates when deferred rendering is enabled. Also maximum delay of coalesced scrolls. */
+#define FABGLIB_TERMINAL_RENDER_PERIOD_MS 20
+
+
+/** Average size (in bytes) of a compressed row of terminal scrollback buffer. Used to size the buffer when only the number of rows is specified. */
+#define FABGLIB_TERMINAL_SCROLLBACK_ROW_SIZE 40
+
+
 /** Stack size of the task that processes Terminal input stream. */
 #define FABGLIB_CHARS_CONSUMER_TASK_STACK_SIZE 2048
 
@@ -115,6 +153,10 @@
 #define FABGLIB_VIEWPORT_MEMORY_POOL_COUNT 10
 
 
+/** Number of DMA line buffers used by VGAPackedController and VGADisplayListController. Half of them are filled on each I2S interrupt. Must be even and at least 4. */
+#define FABGLIB_VGA_LINEBUFFERS 4
+
+
 /** Size of virtualkey queue */
 #define FABGLIB_KEYBOARD_VIRTUALKEY_QUEUE_SIZE 32
 
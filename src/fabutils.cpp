@@ -22,6 +22,11 @@
 
 #include <string.h>
 #include <stdlib.h>
+
+#include "fabglconf.h"
+
+#if !FABGLIB_HOST_BUILD
+
 #include <dirent.h>
 #include <unistd.h>
 #include <sys/stat.h>
@@ -35,9 +40,16 @@
 #include "esp_spiffs.h"
 #include "soc/efuse_reg.h"
 
+#endif
+
+#include "esp_timer.h"
+
 #include "fabutils.h"
+
+#if !FABGLIB_HOST_BUILD
 #include "dispdrivers/vgacontroller.h"
 #include "comdrivers/ps2controller.h"
+#endif
 
 
 
@@ -121,6 +133,8 @@ void free32(void * ptr)
 
 
 
+#if !FABGLIB_HOST_BUILD
+
 ////////////////////////////////////////////////////////////////////////////////////////////
 // suspendInterrupts
 // resumeInterrupts
@@ -142,6 +156,8 @@ void resumeInterrupts()
     VGAController::instance()->resumeBackgroundPrimitiveExecution();
 }
 
+#endif
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // msToTicks
@@ -152,6 +168,8 @@ uint32_t msToTicks(int ms)
 }
 
 
+#if !FABGLIB_HOST_BUILD
+
 ////////////////////////////////////////////////////////////////////////////////////////////
 // getChipPackage
 
@@ -173,6 +191,8 @@ ChipPackage getChipPackage()
   }
 }
 
+#endif
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // Sutherland-Cohen line clipping algorithm
@@ -417,6 +437,8 @@ void StringList::select(int index, bool value)
 
 
 
+#if !FABGLIB_HOST_BUILD
+
 ///////////////////////////////////////////////////////////////////////////////////
 // FileBrowser
 
@@ -778,6 +800,8 @@ bool FileBrowser::getFSInfo(DriveType driveType, int drive, int64_t * total, int
 // FileBrowser
 ///////////////////////////////////////////////////////////////////////////////////
 
+#endif
+
 
 
 
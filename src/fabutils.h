@@ -33,6 +33,7 @@
 
 
 #include "freertos/FreeRTOS.h"
+#include "xtensa/hal.h"
 
 
 namespace fabgl {
@@ -672,6 +673,13 @@ inline gpio_num_t int2gpio(int gpio)
 uint32_t msToTicks(int ms);
 
 
+// CPU clock cycles counter of current core (wraps around every few seconds, use differences only)
+inline uint32_t getCycleCount()
+{
+  return xthal_get_ccount();
+}
+
+
 enum class ChipPackage {
   Unknown,
   ESP32D0WDQ6,
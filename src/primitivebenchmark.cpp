@@ -0,0 +1,489 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "rom/ets_sys.h"
+
+#include "fabutils.h"
+#include "fabfonts.h"
+#include "primitivebenchmark.h"
+
+
+
+namespace fabgl {
+
+
+
+// synthetic bitmaps size
+#define PRIMITIVEBENCHMARK_BITMAP_SIZE 32
+
+
+
+PrimitiveBenchmark::PrimitiveBenchmark(DisplayController * displayController)
+  : m_displayController(displayController),
+    m_bitmapsData(nullptr)
+{
+  m_glyphsBuffer.map = nullptr;
+  setClock(nullptr, 0);
+  reset();
+}
+
+
+PrimitiveBenchmark::~PrimitiveBenchmark()
+{
+  free(m_glyphsBuffer.map);
+  free(m_bitmapsData);
+}
+
+
+void PrimitiveBenchmark::reset()
+{
+  memset(m_stats, 0, sizeof(m_stats));
+  for (int i = 0; i < PRIMITIVECMD_COUNT; ++i)
+    m_stats[i].minTime = UINT32_MAX;
+}
+
+
+void PrimitiveBenchmark::setClock(PrimitiveBenchmarkClock clock, uint32_t ticksPerSecond)
+{
+  if (clock) {
+    m_clock               = clock;
+    m_clockTicksPerSecond = ticksPerSecond;
+  } else {
+    m_clock               = getCycleCount;
+    m_clockTicksPerSecond = ets_get_cpu_frequency() * 1000000;
+  }
+}
+
+
+char const * PrimitiveBenchmark::commandName(PrimitiveCmd cmd)
+{
+  return primitiveCmdName(cmd);
+}
+
+
+void PrimitiveBenchmark::execute(Primitive & primitive)
+{
+  int pixels = estimatePixels(primitive);
+
+  uint32_t t1 = m_clock();
+  m_displayController->addPrimitive(primitive);
+  uint32_t t2 = m_clock();
+
+  // unsigned difference is correct also when the counter wraps around
+  uint32_t elapsed = (uint32_t) ((uint64_t) (t2 - t1) * 1000000000ULL / m_clockTicksPerSecond);
+
+  PrimitiveStats & s = m_stats[primitive.cmd];
+  s.count     += 1;
+  s.totalTime += elapsed;
+  s.minTime    = tmin(s.minTime, elapsed);
+  s.maxTime    = tmax(s.maxTime, elapsed);
+  s.pixels    += pixels;
+
+  int bucket = 0;
+  elapsed >>= 7;
+  while (elapsed && bucket < PRIMITIVEBENCHMARK_HISTOGRAM_BUCKETS - 1) {
+    elapsed >>= 1;
+    ++bucket;
+  }
+  ++s.histogram[bucket];
+}
+
+
+// estimates the number of pixels painted by the primitive (clipping not considered)
+int PrimitiveBenchmark::estimatePixels(Primitive const & primitive)
+{
+  auto const & paintState = m_displayController->paintState();
+  switch (primitive.cmd) {
+    case PrimitiveCmd::SetPixel:
+    case PrimitiveCmd::SetPixelAt:
+      return 1;
+    case PrimitiveCmd::MoveTo:
+      m_position = primitive.position;
+      return 0;
+    case PrimitiveCmd::LineTo:
+    {
+      int r = (imax(abs(primitive.position.X - m_position.X), abs(primitive.position.Y - m_position.Y)) + 1) * paintState.penWidth;
+      m_position = primitive.position;
+      return r;
+    }
+    case PrimitiveCmd::FillRect:
+    case PrimitiveCmd::InvertRect:
+    case PrimitiveCmd::CopyRect:
+    case PrimitiveCmd::SwapFGBG:
+      return primitive.rect.width() * primitive.rect.height();
+    case PrimitiveCmd::DrawRect:
+      return 2 * (primitive.rect.width() + primitive.rect.height());
+    case PrimitiveCmd::FillEllipse:
+      return primitive.size.width * primitive.size.height * 785 / 1000;  // PI / 4
+    case PrimitiveCmd::DrawEllipse:
+      return (primitive.size.width + primitive.size.height) * 157 / 100; // PI / 2
+    case PrimitiveCmd::Clear:
+      return m_displayController->getViewPortWidth() * m_displayController->getViewPortHeight();
+    case PrimitiveCmd::VScroll:
+    case PrimitiveCmd::HScroll:
+      return paintState.scrollingRegion.width() * paintState.scrollingRegion.height();
+    case PrimitiveCmd::DrawGlyph:
+      return primitive.glyph.width * primitive.glyph.height;
+    case PrimitiveCmd::RenderGlyphsBuffer:
+      return primitive.glyphsBufferRenderInfo.glyphsBuffer->glyphsWidth * primitive.glyphsBufferRenderInfo.glyphsBuffer->glyphsHeight;
+    case PrimitiveCmd::DrawBitmap:
+      return primitive.bitmapDrawingInfo.bitmap->width * primitive.bitmapDrawingInfo.bitmap->height;
+    case PrimitiveCmd::DrawTileMap:
+    case PrimitiveCmd::ScrollTileMap:
+      return paintState.scrollingRegion.width() * paintState.scrollingRegion.height();
+    case PrimitiveCmd::FillPath:
+    case PrimitiveCmd::DrawPath:
+    {
+      // bounding box for FillPath, perimeter for DrawPath
+      auto const & path = primitive.path;
+      int minX = path.points[0].X, maxX = minX, minY = path.points[0].Y, maxY = minY, perimeter = 0;
+      for (int i = 0; i < path.pointsCount; ++i) {
+        auto const & a = path.points[i];
+        auto const & b = path.points[(i + 1) % path.pointsCount];
+        minX = imin(minX, a.X);
+        maxX = imax(maxX, a.X);
+        minY = imin(minY, a.Y);
+        maxY = imax(maxY, a.Y);
+        perimeter += imax(abs(b.X - a.X), abs(b.Y - a.Y));
+      }
+      return primitive.cmd == PrimitiveCmd::FillPath ? (maxX - minX + 1) * (maxY - minY + 1) : perimeter * paintState.penWidth;
+    }
+    default:
+      return 0;
+  }
+}
+
+
+void PrimitiveBenchmark::run(Primitive const * primitives, int count, int repeat)
+{
+  const bool backgroundExecution = m_displayController->backgroundPrimitiveExecutionEnabled();
+  m_displayController->enableBackgroundPrimitiveExecution(false);
+  for (int r = 0; r < repeat; ++r) {
+    for (int i = 0; i < count; ++i) {
+      Primitive p;
+      p = primitives[i];
+      execute(p);
+    }
+  }
+  m_displayController->enableBackgroundPrimitiveExecution(backgroundExecution);
+}
+
+
+void PrimitiveBenchmark::runSynthetic(PrimitiveCmd cmd, int count)
+{
+  // batches are generated only by DisplayController, recordings require recorded primitives
+  if ((cmd == PrimitiveCmd::SwapBuffers && !m_displayController->isDoubleBuffered()) || cmd == PrimitiveCmd::ExecuteBatch || cmd == PrimitiveCmd::ExecuteRecording)
+    return;
+
+  allocResources();
+
+  const bool backgroundExecution = m_displayController->backgroundPrimitiveExecutionEnabled();
+  m_displayController->enableBackgroundPrimitiveExecution(false);
+
+  m_seed = 1 + cmd;
+  resetState();
+  for (int i = 0; i < count; ++i) {
+    Primitive p;
+    generate(cmd, i, p);
+    execute(p);
+  }
+  resetState();
+
+  m_displayController->enableBackgroundPrimitiveExecution(backgroundExecution);
+}
+
+
+void PrimitiveBenchmark::runSynthetic(int count)
+{
+  for (int cmd = 0; cmd < PRIMITIVECMD_COUNT; ++cmd)
+    runSynthetic((PrimitiveCmd)cmd, count);
+}
+
+
+// simple linear congruential generator, results are the same on every platform
+int PrimitiveBenchmark::random(int maxValue)
+{
+  m_seed = m_seed * 1103515245 + 12345;
+  return (int) ((m_seed >> 16) % (maxValue + 1));
+}
+
+
+// restores the paint state used by synthetic streams (these primitives are not measured)
+void PrimitiveBenchmark::resetState()
+{
+  const int width  = m_displayController->getViewPortWidth();
+  const int height = m_displayController->getViewPortHeight();
+  Primitive p;
+
+  p.cmd = PrimitiveCmd::SetOrigin;
+  p.position = Point(0, 0);
+  m_displayController->addPrimitive(p);
+
+  p.cmd = PrimitiveCmd::SetClippingRect;
+  p.rect = Rect(0, 0, width - 1, height - 1);
+  m_displayController->addPrimitive(p);
+
+  p.cmd = PrimitiveCmd::SetScrollingRegion;
+  p.rect = Rect(0, 0, width - 1, height - 1);
+  m_displayController->addPrimitive(p);
+
+  p.cmd = PrimitiveCmd::SetGlyphOptions;
+  p.glyphOptions = GlyphOptions().FillBackground(true);
+  m_displayController->addPrimitive(p);
+
+  p.cmd = PrimitiveCmd::SetPaintOptions;
+  p.paintOptions = PaintOptions();
+  m_displayController->addPrimitive(p);
+
+  p.cmd = PrimitiveCmd::SetPenWidth;
+  p.ivalue = 1;
+  m_displayController->addPrimitive(p);
+
+  p.cmd = PrimitiveCmd::SetLineEnds;
+  p.lineEnds = LineEnds::None;
+  m_displayController->addPrimitive(p);
+
+  p.cmd = PrimitiveCmd::MoveTo;
+  p.position = Point(0, 0);
+  m_displayController->addPrimitive(p);
+  m_position = p.position;
+}
+
+
+void PrimitiveBenchmark::allocResources()
+{
+  if (m_glyphsBuffer.map)
+    return;
+
+  // 80x25 glyphs buffer using 8x8 font
+  m_glyphsBuffer.glyphsWidth  = FONT_8x8.width;
+  m_glyphsBuffer.glyphsHeight = FONT_8x8.height;
+  m_glyphsBuffer.glyphsData   = FONT_8x8.data;
+  m_glyphsBuffer.columns      = 80;
+  m_glyphsBuffer.rows         = 25;
+  m_glyphsBuffer.map          = (uint32_t*) malloc(sizeof(uint32_t) * m_glyphsBuffer.columns * m_glyphsBuffer.rows);
+  for (int i = 0; i < m_glyphsBuffer.columns * m_glyphsBuffer.rows; ++i)
+    m_glyphsBuffer.map[i] = GLYPHMAP_ITEM_MAKE(32 + i % 95, (Color)(i % 8), (Color)(8 + i % 8), GlyphOptions().FillBackground(true));
+
+  // mask, RGBA2222 and RGBA8888 bitmaps, with a transparent border
+  const int sz = PRIMITIVEBENCHMARK_BITMAP_SIZE;
+  m_bitmapsData = (uint8_t*) calloc((sz + 7) / 8 * sz + sz * sz + sz * sz * 4, 1);
+  m_bitmaps[0] = Bitmap(sz, sz, m_bitmapsData, PixelFormat::Mask, RGB888(255, 255, 0));
+  m_bitmaps[1] = Bitmap(sz, sz, m_bitmaps[0].data + (sz + 7) / 8 * sz, PixelFormat::RGBA2222);
+  m_bitmaps[2] = Bitmap(sz, sz, m_bitmaps[1].data + sz * sz, PixelFormat::RGBA8888);
+  for (int y = 0; y < sz; ++y)
+    for (int x = 0; x < sz; ++x) {
+      bool opaque = x > 1 && y > 1 && x < sz - 2 && y < sz - 2;
+      m_bitmaps[0].setPixel(x, y, opaque && ((x ^ y) & 1));
+      m_bitmaps[1].setPixel(x, y, RGBA2222(x & 3, y & 3, (x + y) & 3, opaque ? 3 : 0));
+      m_bitmaps[2].setPixel(x, y, RGBA8888(x * 8, y * 8, (x + y) * 4, opaque ? 255 : 0));
+    }
+
+  // 16x16 tile map using the bitmaps as tiles
+  m_tiles[0] = &m_bitmaps[0];
+  m_tiles[1] = &m_bitmaps[1];
+  m_tiles[2] = &m_bitmaps[2];
+  for (int i = 0; i < 16 * 16; ++i)
+    m_tileMapData[i] = random(2);
+  m_tileMap = TileMap(sz, sz, 16, 16, m_tiles, m_tileMapData);
+}
+
+
+// generates the index-th primitive of a synthetic stream
+void PrimitiveBenchmark::generate(PrimitiveCmd cmd, int index, Primitive & p)
+{
+  const int width  = m_displayController->getViewPortWidth();
+  const int height = m_displayController->getViewPortHeight();
+
+  p.cmd = cmd;
+
+  switch (cmd) {
+
+    case PrimitiveCmd::Flush:
+    case PrimitiveCmd::Clear:
+    case PrimitiveCmd::RefreshSprites:
+    case PrimitiveCmd::SwapBuffers:
+    case PrimitiveCmd::ExecuteRecording:
+    case PrimitiveCmd::ExecuteBatch:
+      break;
+
+    case PrimitiveCmd::Refresh:
+    case PrimitiveCmd::SetScrollingRegion:
+    case PrimitiveCmd::SetClippingRect:
+      p.rect = Rect(random(width / 2), random(height / 2), width / 2 + random(width / 2 - 1), height / 2 + random(height / 2 - 1));
+      break;
+
+    case PrimitiveCmd::SetPenColor:
+    case PrimitiveCmd::SetBrushColor:
+      p.color = RGB888(random(255), random(255), random(255));
+      break;
+
+    case PrimitiveCmd::SetPixel:
+    case PrimitiveCmd::MoveTo:
+    case PrimitiveCmd::LineTo:
+      p.position = Point(random(width - 1), random(height - 1));
+      break;
+
+    case PrimitiveCmd::SetOrigin:
+      p.position = Point(random(16), random(16));
+      break;
+
+    case PrimitiveCmd::SetPixelAt:
+      p.pixelDesc.pos   = Point(random(width - 1), random(height - 1));
+      p.pixelDesc.color = RGB888(random(255), random(255), random(255));
+      break;
+
+    case PrimitiveCmd::FillRect:
+    case PrimitiveCmd::DrawRect:
+    case PrimitiveCmd::InvertRect:
+    case PrimitiveCmd::SwapFGBG:
+    {
+      int x = random(width - 1), y = random(height - 1);
+      p.rect = Rect(x, y, x + random(width / 4), y + random(height / 4));
+      break;
+    }
+
+    case PrimitiveCmd::CopyRect:
+    {
+      // source rectangle, destination is the current position
+      int x = random(width / 2), y = random(height / 2);
+      p.rect = Rect(x, y, x + random(width / 4), y + random(height / 4));
+      Primitive m;
+      m.cmd = PrimitiveCmd::MoveTo;
+      m.position = Point(random(width / 2), random(height / 2));
+      m_displayController->addPrimitive(m);
+      break;
+    }
+
+    case PrimitiveCmd::FillEllipse:
+    case PrimitiveCmd::DrawEllipse:
+    {
+      Primitive m;
+      m.cmd = PrimitiveCmd::MoveTo;
+      m.position = Point(random(width - 1), random(height - 1));
+      m_displayController->addPrimitive(m);
+      p.size = Size(2 + random(width / 4), 2 + random(height / 4));
+      break;
+    }
+
+    case PrimitiveCmd::VScroll:
+      p.ivalue = (index & 1 ? 1 : -1) * (1 + random(7));
+      break;
+
+    case PrimitiveCmd::HScroll:
+      p.ivalue = (index & 1 ? 1 : -1) * (1 + random(7));
+      break;
+
+    case PrimitiveCmd::DrawGlyph:
+    {
+      const int gw = FONT_8x8.width, gh = FONT_8x8.height;
+      p.glyph = Glyph(random(width / gw - 1) * gw, random(height / gh - 1) * gh, gw, gh, FONT_8x8.data + (32 + random(94)) * gh);
+      break;
+    }
+
+    case PrimitiveCmd::SetGlyphOptions:
+      p.glyphOptions.value = random(0xffff) & 0x7f;  // no doubleWidth
+      break;
+
+    case PrimitiveCmd::SetPaintOptions:
+      p.paintOptions.swapFGBG = random(1);
+      p.paintOptions.NOT      = random(1);
+      break;
+
+    case PrimitiveCmd::RenderGlyphsBuffer:
+      p.glyphsBufferRenderInfo = GlyphsBufferRenderInfo(random(imin(m_glyphsBuffer.columns, width / m_glyphsBuffer.glyphsWidth) - 1),
+                                                        random(imin(m_glyphsBuffer.rows, height / m_glyphsBuffer.glyphsHeight) - 1),
+                                                        &m_glyphsBuffer);
+      break;
+
+    case PrimitiveCmd::DrawBitmap:
+      p.bitmapDrawingInfo = BitmapDrawingInfo(random(width - 1) - PRIMITIVEBENCHMARK_BITMAP_SIZE / 2,
+                                              random(height - 1) - PRIMITIVEBENCHMARK_BITMAP_SIZE / 2,
+                                              &m_bitmaps[index % 3]);
+      break;
+
+    case PrimitiveCmd::FillPath:
+    case PrimitiveCmd::DrawPath:
+    {
+      const int cx = random(width - 1), cy = random(height - 1);
+      const int count = 3 + random(3);
+      for (int i = 0; i < count; ++i)
+        m_pathPoints[i] = Point(cx - width / 8 + random(width / 4), cy - height / 8 + random(height / 4));
+      p.path.points      = m_pathPoints;
+      p.path.pointsCount = count;
+      p.path.freePoints  = false;
+      break;
+    }
+
+    case PrimitiveCmd::SetPenWidth:
+      p.ivalue = 1 + random(5);
+      break;
+
+    case PrimitiveCmd::SetLineEnds:
+      p.lineEnds = random(1) ? LineEnds::Circle : LineEnds::None;
+      break;
+
+    case PrimitiveCmd::DrawTileMap:
+      p.tileMapDrawingInfo = TileMapDrawingInfo(&m_tileMap, 0, 0);
+      break;
+
+    case PrimitiveCmd::ScrollTileMap:
+      p.tileMapDrawingInfo = TileMapDrawingInfo(&m_tileMap, (index & 1 ? 1 : -1) * (1 + random(7)), 0);
+      break;
+
+  }
+}
+
+
+void PrimitiveBenchmark::printReport(FILE * stream)
+{
+  fprintf(stream, "%-19s %8s %10s %12s %8s %8s %8s  histogram (<0.125us, <0.25us, <0.5us...)\n", "Command", "Count", "Prims/s", "Pixels/s", "Avg(us)", "Min(us)", "Max(us)");
+  uint32_t totCount = 0;
+  uint64_t totTime = 0, totPixels = 0;
+  for (int cmd = 0; cmd < PRIMITIVECMD_COUNT; ++cmd) {
+    PrimitiveStats const & s = m_stats[cmd];
+    if (s.count == 0)
+      continue;
+    totCount  += s.count;
+    totTime   += s.totalTime;
+    totPixels += s.pixels;
+    const uint64_t t = s.totalTime ? s.totalTime : 1;
+    fprintf(stream, "%-19s %8u %10llu %12llu %8.3f %8.3f %8.3f ",
+            commandName((PrimitiveCmd)cmd), s.count, (unsigned long long) (s.count * 1000000000ULL / t), (unsigned long long) (s.pixels * 1000000000.0 / t),
+            s.totalTime / 1000.0 / s.count, s.minTime / 1000.0, s.maxTime / 1000.0);
+    int lastBucket = PRIMITIVEBENCHMARK_HISTOGRAM_BUCKETS - 1;
+    while (lastBucket > 0 && s.histogram[lastBucket] == 0)
+      --lastBucket;
+    for (int i = 0; i <= lastBucket; ++i)
+      fprintf(stream, " %u", s.histogram[i]);
+    fprintf(stream, "\n");
+  }
+  const uint64_t t = totTime ? totTime : 1;
+  fprintf(stream, "%-19s %8u %10llu %12llu\n", "Total", totCount, (unsigned long long) (totCount * 1000000000ULL / t), (unsigned long long) (totPixels * 1000000000.0 / t));
+}
+
+
+
+} // end of namespace
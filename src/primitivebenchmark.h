@@ -0,0 +1,206 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+
+/**
+ * @file
+ *
+ * @brief This file contains fabgl::PrimitiveBenchmark class definition
+ */
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "fabglconf.h"
+#include "displaycontroller.h"
+
+
+
+namespace fabgl {
+
+
+
+// latency histogram: bucket 0 counts executions faster than 128ns, bucket N counts
+// executions between 128 * 2^(N-1) and 128 * 2^N - 1 ns, last bucket counts all slower executions
+#define PRIMITIVEBENCHMARK_HISTOGRAM_BUCKETS 20
+
+
+/**
+ * @brief Execution statistics of a single primitive command
+ */
+struct PrimitiveStats {
+  uint32_t count;                                          /**< Number of executed primitives */
+  uint64_t totalTime;                                      /**< Total execution time in nanoseconds */
+  uint32_t minTime;                                        /**< Minimum execution time in nanoseconds */
+  uint32_t maxTime;                                        /**< Maximum execution time in nanoseconds */
+  uint64_t pixels;                                         /**< Estimated number of painted pixels */
+  uint32_t histogram[PRIMITIVEBENCHMARK_HISTOGRAM_BUCKETS]; /**< Latency histogram (see PRIMITIVEBENCHMARK_HISTOGRAM_BUCKETS) */
+};
+
+
+/** @brief Function returning a free running counter (wrapping around at 2^32), used by PrimitiveBenchmark to time primitives */
+typedef uint32_t (*PrimitiveBenchmarkClock)();
+
+
+/**
+ * @brief Measures the primitives execution speed of a display controller
+ *
+ * PrimitiveBenchmark executes streams of primitives (synthetic or recorded by the application) and collects, for each
+ * primitive command, number of executions, execution time, estimated painted pixels and a latency histogram.<br>
+ * Background primitive execution is disabled while a stream runs, so each primitive is executed (and timed) as soon as it is added.<br>
+ * Using fabgl::FramebufferController results don't depend on display timings, so they can be compared across builds.<br>
+ * Time is read from the CPU cycles counter (see getCycleCount(), emulated by tools/hostshim on host builds), or from the clock set by setClock().
+ * Timing a single primitive in cycles keeps sub-microsecond primitives (state changes, pixels, glyphs) measurable.
+ *
+ * Example:
+ *
+ *     fabgl::FramebufferController DisplayController;
+ *     DisplayController.setResolution(320, 240);
+ *
+ *     fabgl::PrimitiveBenchmark bench(&DisplayController);
+ *     bench.runSynthetic(200);
+ *     bench.printReport();
+ */
+class PrimitiveBenchmark {
+
+public:
+
+  PrimitiveBenchmark(DisplayController * displayController);
+
+  ~PrimitiveBenchmark();
+
+  /**
+   * @brief Clears all collected statistics
+   */
+  void reset();
+
+  /**
+   * @brief Sets the function used to read current time
+   *
+   * @param clock Function returning a free running counter. nullptr restores the CPU cycles counter.
+   * @param ticksPerSecond Counter frequency. Ignored when clock is nullptr.
+   *
+   * Example:
+   *
+   *     // host build: measure process CPU time instead of wall time
+   *     bench.setClock([]() { return (uint32_t) clock(); }, CLOCKS_PER_SEC);
+   */
+  void setClock(PrimitiveBenchmarkClock clock, uint32_t ticksPerSecond);
+
+  /**
+   * @brief Executes a stream of primitives
+   *
+   * Primitives are executed in order, so state changes (colors, origin, clipping...) affect following primitives.
+   * All data referenced by the primitives (glyphs, bitmaps, paths...) must remain valid during the call.
+   *
+   * @param primitives Array of primitives to execute.
+   * @param count Number of primitives in the array.
+   * @param repeat Number of times the whole stream is executed.
+   */
+  void run(Primitive const * primitives, int count, int repeat = 1);
+
+  /**
+   * @brief Executes a synthetic stream of primitives of the specified command
+   *
+   * Primitive parameters (positions, sizes, colors...) are generated using a fixed seed, so the same stream is produced on every run.
+   * PrimitiveCmd::SwapBuffers is executed only when the display controller is double buffered.
+   *
+   * @param cmd Command to measure.
+   * @param count Number of primitives to execute.
+   */
+  void runSynthetic(PrimitiveCmd cmd, int count);
+
+  /**
+   * @brief Executes a synthetic stream for every primitive command
+   *
+   * @param count Number of primitives to execute for each command.
+   */
+  void runSynthetic(int count);
+
+  /**
+   * @brief Gets statistics of the specified command
+   *
+   * @param cmd Primitive command.
+   *
+   * @return Collected statistics.
+   */
+  PrimitiveStats const & stats(PrimitiveCmd cmd) { return m_stats[cmd]; }
+
+  /**
+   * @brief Prints collected statistics
+   *
+   * For each executed command prints count, primitives per second, pixels per second, average/min/max time and the latency histogram.
+   *
+   * @param stream Where to print the report.
+   */
+  void printReport(FILE * stream = stdout);
+
+  /**
+   * @brief Gets the name of a primitive command
+   *
+   * @param cmd Primitive command.
+   *
+   * @return Command name (ie "FillRect").
+   */
+  static char const * commandName(PrimitiveCmd cmd);
+
+private:
+
+  void execute(Primitive & primitive);
+  int estimatePixels(Primitive const & primitive);
+  void generate(PrimitiveCmd cmd, int index, Primitive & primitive);
+  int random(int maxValue);
+  void allocResources();
+  void resetState();
+
+
+  DisplayController * m_displayController;
+
+  PrimitiveBenchmarkClock m_clock;
+  uint32_t                m_clockTicksPerSecond;
+
+  PrimitiveStats      m_stats[PRIMITIVECMD_COUNT];
+
+  // current position, used to estimate LineTo pixels
+  Point               m_position;
+
+  uint32_t            m_seed;
+
+  // resources referenced by synthetic primitives
+  GlyphsBuffer        m_glyphsBuffer;
+  Bitmap              m_bitmaps[3];
+  uint8_t *           m_bitmapsData;
+  Point               m_pathPoints[6];
+  Bitmap *            m_tiles[3];
+  uint8_t             m_tileMapData[16 * 16];
+  TileMap             m_tileMap;
+
+};
+
+
+
+} // end of namespace
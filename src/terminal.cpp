@@ -38,6 +38,7 @@
 #include "soc/dport_reg.h"
 #include "soc/rtc.h"
 #include "esp_intr_alloc.h"
+#include "esp_timer.h"
 
 
 #include "fabutils.h"
@@ -126,6 +127,18 @@ void Terminal::begin(DisplayController * displayController, Keyboard * keyboard)
   m_emuState.tabStop = nullptr;
   m_font.data = nullptr;
 
+  m_deferredRendering = false;
+  m_shadowMap = nullptr;
+  m_renderPending = false;
+  m_nextRenderTime = 0;
+
+  m_pendingScrollRows = 0;
+  m_pendingScrollDeadline = 0;
+  m_dirtyRows = 0;
+
+  m_scrollbackView = 0;
+  m_scrollbackViewBuffer.map = nullptr;
+
   set132ColumnMode(false);
 
   m_savedCursorStateList = nullptr;
@@ -151,7 +164,7 @@ void Terminal::begin(DisplayController * displayController, Keyboard * keyboard)
   xTimerStart(m_blinkTimer, portMAX_DELAY);
 
   // queue and task to consume input characters
-  m_inputQueue = xQueueCreate(FABGLIB_TERMINAL_INPUT_QUEUE_SIZE, sizeof(uint8_t));
+  m_inputQueue.alloc(FABGLIB_TERMINAL_INPUT_QUEUE_SIZE);
   xTaskCreate(&charsConsumerTask, "", FABGLIB_CHARS_CONSUMER_TASK_STACK_SIZE, this, FABGLIB_CHARS_CONSUMER_TASK_PRIORITY, &m_charsConsumerTaskHandle);
 
   m_defaultBackgroundColor = Color::Black;
@@ -213,18 +226,17 @@ static void uartFlushRXFIFO()
 }
 
 
-// look into input queue (m_inputQueue): if there is space for new incoming bytes send XON and reenable uart RX interrupts
+// look into input queue (m_inputQueue): if it is below XON threshold send XON and reenable uart RX interrupts
 void Terminal::uartCheckInputQueueForFlowControl()
 {
-  if (m_autoXONOFF) {
+  if (m_autoXONOFF && m_inputQueue.count() < FABGLIB_TERMINAL_XON_THRESHOLD) {
     uart_dev_t * uart = (volatile uart_dev_t *)(DR_REG_UART2_BASE);
-    if (uxQueueMessagesWaiting(m_inputQueue) == 0 && uart->int_ena.rxfifo_full == 0) {
-      if (m_XOFF) {
-        m_XOFF = false;
-        uart->flow_conf.send_xon = 1; // send XON
-      }
-      uart->int_ena.rxfifo_full = 1;
+    if (m_XOFF) {
+      m_XOFF = false;
+      uart->flow_conf.send_xon = 1; // send XON
     }
+    if (uart->int_ena.rxfifo_full == 0)
+      uart->int_ena.rxfifo_full = 1;
   }
 }
 
@@ -373,6 +385,10 @@ void Terminal::freeGlyphsMap()
     free((void*) m_alternateMap);
     m_alternateMap = nullptr;
   }
+  if (m_shadowMap) {
+    free((void*) m_shadowMap);
+    m_shadowMap = nullptr;
+  }
 }
 
 
@@ -386,13 +402,17 @@ void Terminal::end()
   clearSavedCursorStates();
 
   vTaskDelete(m_charsConsumerTaskHandle);
-  vQueueDelete(m_inputQueue);
+  m_inputQueue.free();
 
   vQueueDelete(m_outputQueue);
 
   freeFont();
   freeTabStops();
   freeGlyphsMap();
+
+  m_scrollback.free();
+  free((void*) m_scrollbackViewBuffer.map);
+  m_scrollbackViewBuffer.map = nullptr;
 }
 
 
@@ -475,6 +495,9 @@ void Terminal::loadFont(FontInfo const * font)
   log("loadFont()\n");
   #endif
 
+  // scrollback view has the old geometry
+  int_setScrollbackView(0);
+
   freeFont();
 
   m_font = *font;
@@ -503,6 +526,17 @@ void Terminal::loadFont(FontInfo const * font)
   m_alternateMap = nullptr;
   m_alternateScreenBuffer = false;
 
+  m_pendingScrollRows = 0;
+  m_dirtyRows = 0;
+
+  if (m_deferredRendering) {
+    m_shadowMap = (uint32_t*) heap_caps_malloc(sizeof(uint32_t) * m_columns * m_rows, MALLOC_CAP_32BIT);
+    if (m_shadowMap)
+      invalidateShadowMap(0, 0, m_columns - 1, m_rows - 1);
+    else
+      m_deferredRendering = false;  // no memory for the new size, back to immediate rendering
+  }
+
   setScrollingRegion(1, m_rows);
 }
 
@@ -513,7 +547,7 @@ void Terminal::flush(bool waitVSync)
   log("flush()\n");
   #endif
 
-  while (uxQueueMessagesWaiting(m_inputQueue) > 0)
+  while (m_inputQueue.count() > 0 || m_renderPending)
     ;
   m_canvas->waitCompletion(waitVSync);
 }
@@ -564,6 +598,8 @@ void Terminal::int_setForegroundColor(Color color)
 void Terminal::reverseVideo(bool value)
 {
   if (m_paintOptions.swapFGBG != value) {
+    flushPendingScroll();
+
     m_paintOptions.swapFGBG = value;
     m_canvas->setPaintOptions(m_paintOptions);
 
@@ -586,8 +622,26 @@ void Terminal::int_clear()
   log("int_clear()\n");
   #endif
 
+  // the whole screen is going to be cleared, pending scrolls don't matter anymore
+  m_pendingScrollRows = 0;
+  m_dirtyRows = 0;
+
   m_canvas->clear();
   clearMap(m_glyphsBuffer.map);
+  if (m_deferredRendering) {
+    uint32_t itemValue = backgroundMapItem();
+    for (int i = 0; i < m_columns * m_rows; ++i)
+      m_shadowMap[i] = itemValue;
+  }
+}
+
+
+// map item of a cell just filled with background color (ie by canvas clear or scroll)
+uint32_t Terminal::backgroundMapItem()
+{
+  GlyphOptions glyphOptions = {.value = 0};
+  glyphOptions.fillBackground = 1;
+  return GLYPHMAP_ITEM_MAKE(ASCII_SPC, m_emuState.backgroundColor, m_emuState.foregroundColor, glyphOptions);
 }
 
 
@@ -680,13 +734,125 @@ void Terminal::enableCursor(bool value)
 }
 
 
+bool Terminal::enableDeferredRendering(bool value)
+{
+  xSemaphoreTake(m_mutex, portMAX_DELAY);
+  bool ret = true;
+  if (m_deferredRendering != value) {
+    flushPendingScroll();
+    if (value) {
+      m_shadowMap = (uint32_t*) heap_caps_malloc(sizeof(uint32_t) * m_columns * m_rows, MALLOC_CAP_32BIT);
+      if (m_shadowMap) {
+        // screen already shows the glyphs map
+        memcpy(m_shadowMap, m_glyphsBuffer.map, sizeof(uint32_t) * m_columns * m_rows);
+        m_renderPending = false;
+        m_deferredRendering = true;
+      } else
+        ret = false;
+    } else {
+      bool prevCursorEnabled = int_enableCursor(false);
+      renderDeferred();
+      m_deferredRendering = false;
+      free((void*) m_shadowMap);
+      m_shadowMap = nullptr;
+      int_enableCursor(prevCursorEnabled);
+    }
+  }
+  xSemaphoreGive(m_mutex);
+  return ret;
+}
+
+
+bool Terminal::enableScrollback(int maxRows, int bufferSize)
+{
+  xSemaphoreTake(m_mutex, portMAX_DELAY);
+  int_setScrollbackView(0);
+  bool ret = true;
+  if (maxRows > 0)
+    ret = m_scrollback.alloc(maxRows, bufferSize < 0 ? maxRows * FABGLIB_TERMINAL_SCROLLBACK_ROW_SIZE : bufferSize);
+  else
+    m_scrollback.free();
+  xSemaphoreGive(m_mutex);
+  return ret;
+}
+
+
+void Terminal::setScrollbackView(int rows)
+{
+  xSemaphoreTake(m_mutex, portMAX_DELAY);
+  int_setScrollbackView(rows);
+  xSemaphoreGive(m_mutex);
+}
+
+
+void Terminal::int_setScrollbackView(int rows)
+{
+  rows = tclamp(rows, 0, m_scrollback.count());
+  if (rows == m_scrollbackView)
+    return;
+
+  if (m_scrollbackView == 0) {
+    // hold the screen
+    m_scrollbackViewBuffer     = m_glyphsBuffer;
+    m_scrollbackViewBuffer.map = (uint32_t*) heap_caps_malloc(sizeof(uint32_t) * m_columns * m_rows, MALLOC_CAP_32BIT);
+    if (m_scrollbackViewBuffer.map == nullptr)
+      return;
+    m_scrollbackViewPrevCursorEnabled = int_enableCursor(false);
+  }
+
+  m_scrollbackView = rows;
+
+  if (rows > 0)
+    renderScrollbackView();
+  else {
+    // back to current screen, then process characters received meanwhile
+    free((void*) m_scrollbackViewBuffer.map);
+    m_scrollbackViewBuffer.map = nullptr;
+    refresh();
+    int_enableCursor(m_scrollbackViewPrevCursorEnabled);
+    xTaskNotifyGive(m_charsConsumerTaskHandle);
+  }
+}
+
+
+// draws scrollback rows followed by screen rows. Rows are decoded into m_scrollbackViewBuffer.map and drawn by the glyphs renderer.
+void Terminal::renderScrollbackView()
+{
+  const int historyRows = m_scrollback.count();
+  uint32_t * mapRow = m_scrollbackViewBuffer.map;
+  for (int y = 0, row = historyRows - m_scrollbackView; y < m_rows; ++y, ++row, mapRow += m_columns) {
+    if (row < historyRows) {
+      m_scrollback.get(row, mapRow, m_columns);
+      // blinking characters may have been stored while hidden
+      for (int x = 0; x < m_columns; ++x) {
+        GlyphOptions glyphOptions = glyphMapItem_getOptions(mapRow + x);
+        if (glyphOptions.userOpt1) {
+          glyphOptions.blank = 0;
+          glyphMapItem_setOptions(mapRow + x, glyphOptions);
+        }
+      }
+    } else
+      memcpy(mapRow, m_glyphsBuffer.map + (row - historyRows) * m_columns, sizeof(uint32_t) * m_columns);
+  }
+
+  m_canvas->beginBatch();
+  for (int y = 0; y < m_rows; ++y)
+    for (int x = 0; x < m_columns; ++x)
+      m_canvas->renderGlyphsBuffer(x, y, &m_scrollbackViewBuffer);
+  m_canvas->submitBatch();
+
+  // glyphs are rendered reading the map, which must not change before they have been drawn
+  m_canvas->waitCompletion(false);
+}
+
+
 bool Terminal::int_enableCursor(bool value)
 {
   bool prev = m_emuState.cursorEnabled;
   if (m_emuState.cursorEnabled != value) {
     m_emuState.cursorEnabled = value;
     if (m_emuState.cursorEnabled) {
-      if (uxQueueMessagesWaiting(m_inputQueue) == 0)
+      if (m_inputQueue.count() == 0)
         blinkCursor();  // just to show the cursor immediately
     } else {
       if (m_cursorState)
@@ -716,8 +882,8 @@ void Terminal::blinkTimerFunc(TimerHandle_t xTimer)
     if (term->m_emuState.cursorEnabled && term->m_emuState.cursorBlinkingEnabled)
       term->blinkCursor();
 
-    // text blink
-    if (term->m_blinkingTextEnabled)
+    // text blink (not while scrollback view holds the screen)
+    if (term->m_blinkingTextEnabled && term->m_scrollbackView == 0)
       term->blinkText();
 
     xSemaphoreGive(term->m_mutex);
@@ -728,6 +894,8 @@ void Terminal::blinkTimerFunc(TimerHandle_t xTimer)
 
 void Terminal::blinkCursor()
 {
+  flushPendingScroll();
+
   m_cursorState = !m_cursorState;
   int X = (m_emuState.cursorX - 1) * m_font.width;
   int Y = (m_emuState.cursorY - 1) * m_font.height;
@@ -821,6 +989,12 @@ void Terminal::scrollDown()
   log("scrollDown\n");
   #endif
 
+  // empty scrolling region (ie insert line below the region)
+  if (m_emuState.scrollingRegionTop > m_emuState.scrollingRegionDown)
+    return;
+
+  flushPendingScroll();
+
   // scroll down using canvas
   if (m_emuState.smoothScroll) {
     for (int i = 0; i < m_font.height; ++i)
@@ -828,16 +1002,25 @@ void Terminal::scrollDown()
   } else
     m_canvas->scroll(0, m_font.height);
 
+  // new row contains what canvas scroll draws, so it can be redrawn from the map
+  scrollMapDown(m_glyphsBuffer.map, backgroundMapItem());
+
+  // screen content has been scrolled, shadow map too
+  if (m_deferredRendering)
+    scrollMapDown(m_shadowMap, backgroundMapItem());
+}
+
+
+void Terminal::scrollMapDown(uint32_t * map, uint32_t blankItem)
+{
   // move down scren buffer
   for (int y = m_emuState.scrollingRegionDown - 1; y > m_emuState.scrollingRegionTop - 1; --y)
-    memcpy(m_glyphsBuffer.map + y * m_columns, m_glyphsBuffer.map + (y - 1) * m_columns, m_columns * sizeof(uint32_t));
+    memcpy(map + y * m_columns, map + (y - 1) * m_columns, m_columns * sizeof(uint32_t));
 
   // insert a blank line in the screen buffer
-  uint32_t itemValue = GLYPHMAP_ITEM_MAKE(ASCII_SPC, m_emuState.backgroundColor, m_emuState.foregroundColor, m_glyphOptions);
-  uint32_t * itemPtr = m_glyphsBuffer.map + (m_emuState.scrollingRegionTop - 1) * m_columns;
+  uint32_t * itemPtr = map + (m_emuState.scrollingRegionTop - 1) * m_columns;
   for (int x = 0; x < m_columns; ++x, ++itemPtr)
-    *itemPtr = itemValue;
-
+    *itemPtr = blankItem;
 }
 
 
@@ -859,22 +1042,55 @@ void Terminal::scrollUp()
   log("scrollUp\n");
   #endif
 
+  const int top  = m_emuState.scrollingRegionTop;
+  const int down = m_emuState.scrollingRegionDown;
+
+  // empty scrolling region (ie delete line below the region)
+  if (top > down)
+    return;
+
   // scroll up using canvas
   if (m_emuState.smoothScroll) {
+    flushPendingScroll();
     for (int i = 0; i < m_font.height; ++i)
       m_canvas->scroll(0, -1);
-  } else
-    m_canvas->scroll(0, -m_font.height);
+  } else {
+    // canvas scroll is delayed, so a flood of line feeds moves the screen just once (see flushPendingScroll())
+    if (m_pendingScrollRows == 0)
+      m_pendingScrollDeadline = esp_timer_get_time() + FABGLIB_TERMINAL_RENDER_PERIOD_MS * 1000;
+    ++m_pendingScrollRows;
+    // rows to redraw move up with scrolling region, and the new last row must be drawn
+    uint32_t regionMask = ((1 << (down - top + 1)) - 1) << (top - 1);
+    m_dirtyRows = (m_dirtyRows & ~regionMask) | ((m_dirtyRows >> 1) & regionMask) | (1 << (down - 1));
+  }
+
+  // row leaving the top of the screen goes into scrollback buffer (rows of the alternate screen are not kept)
+  if (top == 1 && !m_alternateScreenBuffer)
+    m_scrollback.push(m_glyphsBuffer.map, m_columns);
+
+  // new row contains what canvas scroll draws, so it can be redrawn from the map
+  scrollMapUp(m_glyphsBuffer.map, backgroundMapItem());
+
+  // screen content has been scrolled (or will be by flushPendingScroll()), shadow map too
+  if (m_deferredRendering)
+    scrollMapUp(m_shadowMap, backgroundMapItem());
+
+  // whole scrolling region scrolled out: just redraw it
+  if (m_pendingScrollRows == down - top + 1)
+    flushPendingScroll();
+}
+
 
+void Terminal::scrollMapUp(uint32_t * map, uint32_t blankItem)
+{
   // move up screen buffer
   for (int y = m_emuState.scrollingRegionTop - 1; y < m_emuState.scrollingRegionDown - 1; ++y)
-    memcpy(m_glyphsBuffer.map + y * m_columns, m_glyphsBuffer.map + (y + 1) * m_columns, m_columns * sizeof(uint32_t));
+    memcpy(map + y * m_columns, map + (y + 1) * m_columns, m_columns * sizeof(uint32_t));
 
   // insert a blank line in the screen buffer
-  uint32_t itemValue = GLYPHMAP_ITEM_MAKE(ASCII_SPC, m_emuState.backgroundColor, m_emuState.foregroundColor, m_glyphOptions);
-  uint32_t * itemPtr = m_glyphsBuffer.map + (m_emuState.scrollingRegionDown - 1) * m_columns;
+  uint32_t * itemPtr = map + (m_emuState.scrollingRegionDown - 1) * m_columns;
   for (int x = 0; x < m_columns; ++x, ++itemPtr)
-    *itemPtr = itemValue;
+    *itemPtr = blankItem;
 }
 
 
@@ -891,6 +1107,9 @@ void Terminal::scrollUpAt(int startingRow)
 
 void Terminal::setScrollingRegion(int top, int down, bool resetCursorPos)
 {
+  // pending scrolls refer to current scrolling region
+  flushPendingScroll();
+
   m_emuState.scrollingRegionTop  = tclamp(top, 1, (int)m_rows);
   m_emuState.scrollingRegionDown = tclamp(down, 1, (int)m_rows);
   updateCanvasScrollingRegion();
@@ -954,13 +1173,16 @@ void Terminal::insertAt(int column, int row, int count)
   logFmt("insertAt(%d, %d, %d)\n", column, row, count);
   #endif
 
-  count = tmin((int)m_columns, count);
+  count = imin(m_columns - column + 1, count);
 
-  // move characters on the right using canvas
-  int charWidth = getCharWidthAt(row);
-  m_canvas->setScrollingRegion((column - 1) * charWidth, (row - 1) * m_font.height, charWidth * getColumnsAt(row) - 1, row * m_font.height - 1);
-  m_canvas->scroll(count * charWidth, 0);
-  updateCanvasScrollingRegion();  // restore original scrolling region
+  // move characters on the right using canvas (deferred rendering will just draw changed characters)
+  if (!m_deferredRendering) {
+    flushPendingScroll();
+    int charWidth = getCharWidthAt(row);
+    m_canvas->setScrollingRegion((column - 1) * charWidth, (row - 1) * m_font.height, charWidth * getColumnsAt(row) - 1, row * m_font.height - 1);
+    m_canvas->scroll(count * charWidth, 0);
+    updateCanvasScrollingRegion();  // restore original scrolling region
+  }
 
   // move characters in the screen buffer
   uint32_t * rowPtr = m_glyphsBuffer.map + (row - 1) * m_columns;
@@ -1014,11 +1236,14 @@ void Terminal::deleteAt(int column, int row, int count)
 
   count = imin(m_columns - column + 1, count);
 
-  // move characters on the right using canvas
-  int charWidth = getCharWidthAt(row);
-  m_canvas->setScrollingRegion((column - 1) * charWidth, (row - 1) * m_font.height, charWidth * getColumnsAt(row) - 1, row * m_font.height - 1);
-  m_canvas->scroll(-count * charWidth, 0);
-  updateCanvasScrollingRegion();  // restore original scrolling region
+  // move characters on the left using canvas (deferred rendering will just draw changed characters)
+  if (!m_deferredRendering) {
+    flushPendingScroll();
+    int charWidth = getCharWidthAt(row);
+    m_canvas->setScrollingRegion((column - 1) * charWidth, (row - 1) * m_font.height, charWidth * getColumnsAt(row) - 1, row * m_font.height - 1);
+    m_canvas->scroll(-count * charWidth, 0);
+    updateCanvasScrollingRegion();  // restore original scrolling region
+  }
 
   // move characters in the screen buffer
   uint32_t * rowPtr = m_glyphsBuffer.map + (row - 1) * m_columns;
@@ -1049,9 +1274,14 @@ void Terminal::erase(int X1, int Y1, int X2, int Y2, char c, bool maintainDouble
   X2 = tclamp(X2 - 1, 0, (int)m_columns - 1);
   Y2 = tclamp(Y2 - 1, 0, (int)m_rows - 1);
 
-  if (c == ASCII_SPC && !selective) {
-    int charWidth = getCharWidthAt(m_emuState.cursorY);
-    m_canvas->fillRectangle(X1 * charWidth, Y1 * m_font.height, (X2 + 1) * charWidth - 1, (Y2 + 1) * m_font.height - 1);
+  if (c == ASCII_SPC && !selective && !m_deferredRendering) {
+    if (m_pendingScrollRows > 0) {
+      // erased rows will be drawn by flushPendingScroll()
+      m_dirtyRows |= ((1 << (Y2 - Y1 + 1)) - 1) << Y1;
+    } else {
+      int charWidth = getCharWidthAt(m_emuState.cursorY);
+      m_canvas->fillRectangle(X1 * charWidth, Y1 * m_font.height, (X2 + 1) * charWidth - 1, (Y2 + 1) * m_font.height - 1);
+    }
   }
 
   GlyphOptions glyphOptions = {.value = 0};
@@ -1267,7 +1497,8 @@ void Terminal::pollSerialPort()
     if (!avail)
       break;
 
-    write( m_serialPort->read() );
+    uint8_t buf[32];
+    write(buf, m_serialPort->readBytes(buf, tmin(avail, (int) sizeof(buf))));
   }
 }
 
@@ -1290,12 +1521,13 @@ void IRAM_ATTR Terminal::uart_isr(void *arg)
 
   // software flow control?
   if (term->m_autoXONOFF) {
-    // send XOFF/XON looking at RX FIFO occupation
+    // send XOFF/XON looking at RX FIFO and input queue occupation
     int count = uartGetRXFIFOCount();
-    if (count > 300 && !term->m_XOFF) {
+    int queued = term->m_inputQueue.count();
+    if ((count > 300 || queued >= FABGLIB_TERMINAL_XOFF_THRESHOLD) && !term->m_XOFF) {
       uart->flow_conf.send_xoff = 1; // send XOFF
       term->m_XOFF = true;
-    } else if (count < 20 && term->m_XOFF) {
+    } else if (count < 20 && queued < FABGLIB_TERMINAL_XON_THRESHOLD && term->m_XOFF) {
       uart->flow_conf.send_xon = 1;  // send XON
       term->m_XOFF = false;
     }
@@ -1304,7 +1536,8 @@ void IRAM_ATTR Terminal::uart_isr(void *arg)
   // main receive loop
   while (uartGetRXFIFOCount() != 0 || uart->mem_rx_status.wr_addr != uart->mem_rx_status.rd_addr) {
     // look for enough room in input queue
-    if (term->m_autoXONOFF && xQueueIsQueueFullFromISR(term->m_inputQueue)) {
+    int spaces = term->m_inputQueue.spaces();
+    if (term->m_autoXONOFF && spaces == 0) {
       if (!term->m_XOFF) {
         uart->flow_conf.send_xoff = 1;  // send XOFF
         term->m_XOFF = true;
@@ -1313,8 +1546,12 @@ void IRAM_ATTR Terminal::uart_isr(void *arg)
       uart->int_ena.rxfifo_full = 0;
       break;
     }
-    // add to input queue
-    term->addToInputQueue(uart->fifo.rw_byte, true);
+    // add a block of bytes to input queue (without flow control bytes exceeding queue space are lost)
+    uint8_t buf[32];
+    int count = 0;
+    while (count < (int) sizeof(buf) && (count < spaces || !term->m_autoXONOFF) && (uartGetRXFIFOCount() != 0 || uart->mem_rx_status.wr_addr != uart->mem_rx_status.rd_addr))
+      buf[count++] = uart->fifo.rw_byte;
+    term->addToInputQueue(buf, count, true);
   }
 
   // clear interrupt flag
@@ -1396,16 +1633,43 @@ void Terminal::sendSS3()
 
 int Terminal::availableForWrite()
 {
-  return uxQueueSpacesAvailable(m_inputQueue);
+  return m_inputQueue.spaces();
 }
 
 
-bool Terminal::addToInputQueue(char c, bool fromISR)
+// blocks until all bytes have been queued. When fromISR is true doesn't block and returns false if some bytes have been lost.
+// The consumer task is notified only when the queue was empty, because that is the only case it may be waiting.
+bool IRAM_ATTR Terminal::addToInputQueue(uint8_t const * data, int size, bool fromISR)
 {
-  if (fromISR)
-    return xQueueSendToBackFromISR(m_inputQueue, &c, nullptr);
-  else
-    return xQueueSendToBack(m_inputQueue, &c, portMAX_DELAY);
+  while (true) {
+    bool wasEmpty;
+    int count = m_inputQueue.write(data, size, fromISR, &wasEmpty);
+    if (wasEmpty) {
+      if (fromISR) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(m_charsConsumerTaskHandle, &woken);
+        if (woken)
+          portYIELD_FROM_ISR();
+      } else
+        xTaskNotifyGive(m_charsConsumerTaskHandle);
+    }
+    data += count;
+    size -= count;
+    if (size == 0)
+      return true;
+    if (fromISR)
+      return false;
+    // queue is full, give time to the consumer task
+    vTaskDelay(1);
+  }
+}
+
+
+// waits for input queue to be not empty (called by the consumer task)
+void Terminal::waitInputQueue()
+{
+  while (m_inputQueue.count() == 0)
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
 }
 
 
@@ -1431,12 +1695,23 @@ size_t Terminal::write(uint8_t c)
 
 int Terminal::write(const uint8_t * buffer, int size)
 {
-  for (int i = 0; i < size; ++i)
-    write(*(buffer++));
+  if (m_termInfo == nullptr && !FABGLIB_TERMINAL_DEBUG_REPORT_IN_CODES) {
+    // send unprocessed, all at once
+    addToInputQueue(buffer, size, false);
+  } else {
+    for (int i = 0; i < size; ++i)
+      write(*(buffer++));
+  }
   return size;
 }
 
 
+size_t Terminal::write(const uint8_t * buffer, size_t size)
+{
+  return write(buffer, (int) size);
+}
+
+
 void Terminal::setTerminalType(TermInfo const * value)
 {
   m_termInfo = nullptr;
@@ -1613,14 +1888,10 @@ void Terminal::convSendCtrl(ConvCtrl ctrl, bool fromISR)
 // queue m_termMatchedChars[] or specified string
 void Terminal::convQueue(const char * str, bool fromISR)
 {
-  if (str) {
-    for (; *str; ++str)
-      addToInputQueue(*str, fromISR);
-  } else {
-    for (int i = 0; i <= m_convMatchedCount; ++i) {
-      addToInputQueue(m_convMatchedChars[i], fromISR);
-    }
-  }
+  if (str)
+    addToInputQueue((uint8_t const *) str, strlen(str), fromISR);
+  else
+    addToInputQueue((uint8_t const *) m_convMatchedChars, m_convMatchedCount + 1, fromISR);
   m_convMatchedCount = 0;
   m_convMatchedItem = nullptr;
 }
@@ -1652,15 +1923,20 @@ bool Terminal::setChar(char c)
   glyphOptions.doubleWidth = glyphMapItem_getOptions(mapItemPtr).doubleWidth;
   *mapItemPtr = GLYPHMAP_ITEM_MAKE(c, m_emuState.backgroundColor, m_emuState.foregroundColor, glyphOptions);
 
-  if (glyphOptions.value != m_glyphOptions.value)
-    m_canvas->setGlyphOptions(glyphOptions);
+  if (m_pendingScrollRows > 0) {
+    // row will be drawn by flushPendingScroll()
+    m_dirtyRows |= 1 << (m_emuState.cursorY - 1);
+  } else if (!m_deferredRendering) {
+    if (glyphOptions.value != m_glyphOptions.value)
+      m_canvas->setGlyphOptions(glyphOptions);
 
-  int x = (m_emuState.cursorX - 1) * m_font.width * (glyphOptions.doubleWidth ? 2 : 1);
-  int y = (m_emuState.cursorY - 1) * m_font.height;
-  m_canvas->drawGlyph(x, y, m_font.width, m_font.height, m_font.data, c);
+    int x = (m_emuState.cursorX - 1) * m_font.width * (glyphOptions.doubleWidth ? 2 : 1);
+    int y = (m_emuState.cursorY - 1) * m_font.height;
+    m_canvas->drawGlyph(x, y, m_font.width, m_font.height, m_font.data, c);
 
-  if (glyphOptions.value != m_glyphOptions.value)
-    m_canvas->setGlyphOptions(m_glyphOptions);
+    if (glyphOptions.value != m_glyphOptions.value)
+      m_canvas->setGlyphOptions(m_glyphOptions);
+  }
 
   // blinking text?
   if (m_glyphOptions.userOpt1)
@@ -1676,6 +1952,59 @@ bool Terminal::setChar(char c)
 }
 
 
+// prints printable characters already in the input queue, up to the end of current row.
+// Glyphs map is updated directly and glyphs are sent to the display controller as a single batch (or left to deferred
+// rendering or to flushPendingScroll()), so cursor, blinking and mutex handling of consumeInputQueue() is done once per
+// run instead of once per character.
+void Terminal::setQueuedChars()
+{
+  if (m_emuState.insertMode || m_emuState.cursorPastLastCol || m_glyphOptions.doubleWidth)
+    return;
+
+  const bool draw = !m_deferredRendering && m_pendingScrollRows == 0;
+  const int y = (m_emuState.cursorY - 1) * m_font.height;
+  int X = m_emuState.cursorX;
+  uint32_t * mapItemPtr = m_glyphsBuffer.map + (X - 1) + (m_emuState.cursorY - 1) * m_columns;
+
+  char c;
+  bool printed = false;
+  while (X <= m_columns && glyphMapItem_getOptions(mapItemPtr).doubleWidth == 0 && m_inputQueue.peek((uint8_t *) &c) && !ISCTRLCHAR(c)) {
+    m_inputQueue.read((uint8_t *) &c, 1);
+    if (!printed && draw)
+      m_canvas->beginBatch();
+    printed = true;
+    c = translateChar(c);
+    *mapItemPtr++ = GLYPHMAP_ITEM_MAKE(c, m_emuState.backgroundColor, m_emuState.foregroundColor, m_glyphOptions);
+    if (draw)
+      m_canvas->drawGlyph((X - 1) * m_font.width, y, m_font.width, m_font.height, m_font.data, c);
+    ++X;
+  }
+
+  if (printed) {
+    if (draw)
+      m_canvas->submitBatch();
+    else if (m_pendingScrollRows > 0)
+      m_dirtyRows |= 1 << (m_emuState.cursorY - 1);
+    if (X > m_columns) {
+      m_emuState.cursorX = m_columns;
+      m_emuState.cursorPastLastCol = true;
+    } else
+      setCursorPos(X, m_emuState.cursorY);
+    if (m_uart)
+      uartCheckInputQueueForFlowControl();
+  }
+}
+
+
+// translates c when DEC special graphics character set is selected
+char Terminal::translateChar(char c)
+{
+  if (m_emuState.characterSet[m_emuState.characterSetIndex] == 0 || (!m_emuState.ANSIMode && m_emuState.VT52GraphicsMode))
+    c = DECGRAPH_TO_CP437[(uint8_t)c];
+  return c;
+}
+
+
 void Terminal::refresh()
 {
   #if FABGLIB_TERMINAL_DEBUG_REPORT_DESCS
@@ -1693,7 +2022,12 @@ void Terminal::refresh(int X, int Y)
   logFmt("refresh(%d, %d)\n", X, Y);
   #endif
 
-  m_canvas->renderGlyphsBuffer(X - 1, Y - 1, &m_glyphsBuffer);
+  if (m_deferredRendering)
+    invalidateShadowMap(X - 1, Y - 1, X - 1, Y - 1);
+  else {
+    flushPendingScroll();
+    m_canvas->renderGlyphsBuffer(X - 1, Y - 1, &m_glyphsBuffer);
+  }
 }
 
 
@@ -1703,6 +2037,13 @@ void Terminal::refresh(int X1, int Y1, int X2, int Y2)
   logFmt("refresh(%d, %d, %d, %d)\n", X1, Y1, X2, Y2);
   #endif
 
+  if (m_deferredRendering) {
+    invalidateShadowMap(X1 - 1, Y1 - 1, X2 - 1, Y2 - 1);
+    return;
+  }
+
+  flushPendingScroll();
+
   for (int y = Y1 - 1; y < Y2; ++y) {
     for (int x = X1 - 1; x < X2; ++x)
       m_canvas->renderGlyphsBuffer(x, y, &m_glyphsBuffer);
@@ -1711,6 +2052,109 @@ void Terminal::refresh(int X1, int Y1, int X2, int Y2)
 }
 
 
+// deferred rendering: forces redraw of specified cells (0 based, inclusive coordinates) and wakes up the consumer task
+void Terminal::invalidateShadowMap(int X1, int Y1, int X2, int Y2)
+{
+  for (int y = Y1; y <= Y2; ++y) {
+    uint32_t * mapItemPtr    = m_glyphsBuffer.map + X1 + y * m_columns;
+    uint32_t * shadowItemPtr = m_shadowMap + X1 + y * m_columns;
+    for (int x = X1; x <= X2; ++x)
+      *shadowItemPtr++ = ~(*mapItemPtr++);
+  }
+  m_renderPending = true;
+  xTaskNotifyGive(m_charsConsumerTaskHandle);
+}
+
+
+// deferred rendering: draws cells of glyphs map which differ from shadow map (what is on screen).
+// Must be called with m_mutex taken and cursor disabled.
+void Terminal::renderDeferred()
+{
+  flushPendingScroll();
+
+  m_renderPending  = false;
+  m_nextRenderTime = esp_timer_get_time() + FABGLIB_TERMINAL_RENDER_PERIOD_MS * 1000;
+
+  m_canvas->beginBatch();
+  uint32_t * mapItemPtr    = m_glyphsBuffer.map;
+  uint32_t * shadowItemPtr = m_shadowMap;
+  for (int y = 0; y < m_rows; ++y)
+    for (int x = 0; x < m_columns; ++x, ++mapItemPtr, ++shadowItemPtr)
+      if (*mapItemPtr != *shadowItemPtr) {
+        *shadowItemPtr = *mapItemPtr;
+        m_canvas->renderGlyphsBuffer(x, y, &m_glyphsBuffer);
+      }
+  m_canvas->submitBatch();
+
+  // glyphs are rendered reading the map, which must not change before they have been drawn
+  m_canvas->waitCompletion(false);
+}
+
+
+// Performs scrolls delayed by scrollUp() with a single canvas scroll, then draws new rows and rows changed in the meantime.
+// When the whole scrolling region has been scrolled out the canvas scroll is skipped. Must be called before any other drawing.
+void Terminal::flushPendingScroll()
+{
+  if (m_pendingScrollRows == 0)
+    return;
+
+  const int down       = m_emuState.scrollingRegionDown;
+  const int regionRows = down - m_emuState.scrollingRegionTop + 1;
+  const bool scrolled  = m_pendingScrollRows < regionRows;
+  if (scrolled)
+    m_canvas->scroll(0, -m_pendingScrollRows * m_font.height);
+
+  if (m_deferredRendering) {
+    // new rows have been filled with current brush color, which may differ from what shadow map reports
+    invalidateShadowMap(0, down - imin(m_pendingScrollRows, regionRows), m_columns - 1, down - 1);
+  } else {
+    // rows just filled by canvas scroll (0 based, from firstNewRow to down - 1) don't need blank cells to be drawn
+    const int firstNewRow  = scrolled ? down - m_pendingScrollRows : down;
+    const uint32_t blankItem = backgroundMapItem();
+    m_canvas->beginBatch();
+    for (int y = 0; y < m_rows; ++y) {
+      if (m_dirtyRows & (1 << y)) {
+        const bool newRow = y >= firstNewRow && y < down;
+        uint32_t * mapItemPtr = m_glyphsBuffer.map + y * m_columns;
+        for (int x = 0; x < m_columns; ++x, ++mapItemPtr)
+          if (!newRow || *mapItemPtr != blankItem)
+            m_canvas->renderGlyphsBuffer(x, y, &m_glyphsBuffer);
+      }
+    }
+    m_canvas->submitBatch();
+    // glyphs are rendered reading the map, which must not change before they have been drawn
+    m_canvas->waitCompletion(false);
+  }
+
+  m_pendingScrollRows = 0;
+  m_dirtyRows = 0;
+}
+
+
+// deferred rendering: waits for input queue to be not empty, rendering pending changes when render period expires
+void Terminal::waitInputQueueRendering()
+{
+  while (m_inputQueue.count() == 0) {
+    if (m_renderPending) {
+      int ms = (m_nextRenderTime - esp_timer_get_time()) / 1000;
+      if (ms > 0) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms) + 1);
+      } else {
+        xSemaphoreTake(m_mutex, portMAX_DELAY);
+        if (m_deferredRendering && m_scrollbackView == 0) {
+          bool prevCursorEnabled = int_enableCursor(false);
+          renderDeferred();
+          int_enableCursor(prevCursorEnabled);
+        } else
+          m_renderPending = false;
+        xSemaphoreGive(m_mutex);
+      }
+    } else
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+
 // value: 0 = normal, 1 = double width, 2 = double width - double height top, 3 = double width - double height bottom
 void Terminal::setLineDoubleWidth(int row, int value)
 {
@@ -1752,7 +2196,8 @@ char Terminal::getNextCode(bool processCtrlCodes)
 {
   while (true) {
     char c;
-    xQueueReceive(m_inputQueue, &c, portMAX_DELAY);
+    waitInputQueue();
+    m_inputQueue.read((uint8_t *) &c, 1);
 
     if (m_uart)
       uartCheckInputQueueForFlowControl();
@@ -1777,6 +2222,13 @@ void Terminal::charsConsumerTask(void * pvParameters)
 
 void Terminal::consumeInputQueue()
 {
+  // scrollback view holds the screen: received characters stay in the input queue until current screen is shown again
+  while (m_scrollbackView > 0)
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+  if (m_deferredRendering)
+    waitInputQueueRendering();
+
   char c = getNextCode(false);  // blocking call. false: do not process ctrl chars
 
   xSemaphoreTake(m_mutex, portMAX_DELAY);
@@ -1793,9 +2245,20 @@ void Terminal::consumeInputQueue()
     execCtrlCode(c);
 
   else {
-    if (m_emuState.characterSet[m_emuState.characterSetIndex] == 0 || (!m_emuState.ANSIMode && m_emuState.VT52GraphicsMode))
-      c = DECGRAPH_TO_CP437[(uint8_t)c];
-    setChar(c);
+    setChar(translateChar(c));
+    setQueuedChars();
+  }
+
+  if (m_scrollbackView > 0) {
+    // scrollback view has been opened while these characters were received, so it has been overwritten
+    renderScrollbackView();
+  } else if (m_deferredRendering) {
+    m_renderPending = true;
+    if (esp_timer_get_time() >= m_nextRenderTime)
+      renderDeferred();
+  } else if (m_pendingScrollRows > 0 && (m_inputQueue.count() == 0 || esp_timer_get_time() >= m_pendingScrollDeadline)) {
+    // show coalesced scrolls when no more chars are going to be processed or they have been delayed too much
+    flushPendingScroll();
   }
 
   enableBlinkingText(m_prevBlinkingTextEnabled);
@@ -2172,6 +2635,7 @@ void Terminal::consumeCSI()
     // Ps = 0 : from cursor to end of display (default)
     // Ps = 1 : erase from start to cursor
     // Ps = 2 : erase whole display
+    // Ps = 3 : erase scrollback buffer (xterm)
     // Erase also doubleWidth attributes
     case 'J':
       switch (params[0]) {
@@ -2186,6 +2650,10 @@ void Terminal::consumeCSI()
         case 2:
           erase(1, 1, m_columns, m_rows, ASCII_SPC, false, questionMarkFound);
           break;
+        case 3:
+          int_setScrollbackView(0);
+          m_scrollback.clear();
+          break;
       }
       break;
 
@@ -3090,13 +3558,15 @@ void Terminal::keyboardReaderTask(void * pvParameters)
 
       xSemaphoreTake(term->m_mutex, portMAX_DELAY);
 
-      if (term->m_termInfo == nullptr) {
-        if (term->m_emuState.ANSIMode)
-          term->ANSIDecodeVirtualKey(vk);
-        else
-          term->VT52DecodeVirtualKey(vk);
-      } else
-        term->TermDecodeVirtualKey(vk);
+      if (!term->scrollbackDecodeVirtualKey(vk)) {
+        if (term->m_termInfo == nullptr) {
+          if (term->m_emuState.ANSIMode)
+            term->ANSIDecodeVirtualKey(vk);
+          else
+            term->VT52DecodeVirtualKey(vk);
+        } else
+          term->TermDecodeVirtualKey(vk);
+      }
 
       xSemaphoreGive(term->m_mutex);
 
@@ -3109,6 +3579,36 @@ void Terminal::keyboardReaderTask(void * pvParameters)
 }
 
 
+// SHIFT-PAGEUP and SHIFT-PAGEDOWN move the scrollback view by half screen, other keys (but modifiers) show current screen.
+// Returns true when the key has been consumed.
+bool Terminal::scrollbackDecodeVirtualKey(VirtualKey vk)
+{
+  if (m_scrollback.maxRows() == 0)
+    return false;
+
+  if ((vk == VK_PAGEUP || vk == VK_PAGEDOWN) && (m_keyboard->isVKDown(VK_LSHIFT) || m_keyboard->isVKDown(VK_RSHIFT))) {
+    int_setScrollbackView(m_scrollbackView + (vk == VK_PAGEUP ? 1 : -1) * m_rows / 2);
+    return true;
+  }
+
+  switch (vk) {
+    case VK_LSHIFT:
+    case VK_RSHIFT:
+    case VK_LALT:
+    case VK_RALT:
+    case VK_LCTRL:
+    case VK_RCTRL:
+    case VK_LGUI:
+    case VK_RGUI:
+      break;
+    default:
+      int_setScrollbackView(0);
+      break;
+  }
+  return false;
+}
+
+
 void Terminal::sendCursorKeyCode(char c)
 {
   if (m_emuState.cursorKeysMode)
@@ -3439,6 +3939,255 @@ void Terminal::TermDecodeVirtualKey(VirtualKey vk)
 
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// TerminalInputQueue
+
+
+TerminalInputQueue::TerminalInputQueue()
+  : m_buffer(nullptr),
+    m_mask(0),
+    m_head(0),
+    m_tail(0)
+{
+}
+
+
+void TerminalInputQueue::alloc(int size)
+{
+  int capacity = 1;
+  while (capacity < size)
+    capacity <<= 1;
+  // written by UART interrupt, so it must be in internal memory
+  m_buffer = (uint8_t *) heap_caps_malloc(capacity, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+  m_mask   = capacity - 1;
+  m_head   = 0;
+  m_tail   = 0;
+  vPortCPUInitializeMutex(&m_producersLock);
+}
+
+
+void TerminalInputQueue::free()
+{
+  heap_caps_free(m_buffer);
+  m_buffer = nullptr;
+  m_mask   = 0;
+  m_head   = 0;
+  m_tail   = 0;
+}
+
+
+int IRAM_ATTR TerminalInputQueue::write(uint8_t const * data, int size, bool fromISR, bool * wasEmpty)
+{
+  if (fromISR)
+    portENTER_CRITICAL_ISR(&m_producersLock);
+  else
+    portENTER_CRITICAL(&m_producersLock);
+
+  const uint32_t head = m_head;
+  size = tmin(size, capacity() - (int)(head - m_tail));
+  const int pos   = head & m_mask;
+  const int first = tmin(size, capacity() - pos);
+  memcpy(m_buffer + pos, data, first);
+  memcpy(m_buffer, data + first, size - first);
+  m_head = head + size;
+
+  // tail is read after head has been updated: if the consumer hasn't read past the old head it may be waiting, otherwise
+  // it has already seen new bytes
+  *wasEmpty = (size > 0 && m_tail == head);
+
+  if (fromISR)
+    portEXIT_CRITICAL_ISR(&m_producersLock);
+  else
+    portEXIT_CRITICAL(&m_producersLock);
+
+  return size;
+}
+
+
+int TerminalInputQueue::read(uint8_t * dest, int size)
+{
+  const uint32_t tail = m_tail;
+  size = tmin(size, (int)(m_head - tail));
+  const int pos   = tail & m_mask;
+  const int first = tmin(size, capacity() - pos);
+  memcpy(dest, m_buffer + pos, first);
+  memcpy(dest + first, m_buffer, size - first);
+  m_tail = tail + size;
+  return size;
+}
+
+
+bool TerminalInputQueue::peek(uint8_t * c)
+{
+  const uint32_t tail = m_tail;
+  if (m_head == tail)
+    return false;
+  *c = m_buffer[tail & m_mask];
+  return true;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// TerminalScrollback
+
+
+// allocates in PSRAM when available
+static void * scrollbackAlloc(size_t size)
+{
+  void * ptr = heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+  return ptr ? ptr : heap_caps_malloc(size, MALLOC_CAP_8BIT);
+}
+
+
+TerminalScrollback::TerminalScrollback()
+  : m_buffer(nullptr),
+    m_bufferSize(0),
+    m_bufferHead(0),
+    m_rows(nullptr),
+    m_maxRows(0),
+    m_first(0),
+    m_count(0)
+{
+}
+
+
+bool TerminalScrollback::alloc(int maxRows, int bufferSize)
+{
+  free();
+  m_buffer = (uint8_t *) scrollbackAlloc(bufferSize);
+  m_rows   = (RowDesc *) scrollbackAlloc(sizeof(RowDesc) * maxRows);
+  if (m_buffer == nullptr || m_rows == nullptr) {
+    free();
+    return false;
+  }
+  m_bufferSize = bufferSize;
+  m_maxRows    = maxRows;
+  clear();
+  return true;
+}
+
+
+void TerminalScrollback::free()
+{
+  heap_caps_free(m_buffer);
+  heap_caps_free(m_rows);
+  m_buffer     = nullptr;
+  m_rows       = nullptr;
+  m_bufferSize = 0;
+  m_maxRows    = 0;
+  clear();
+}
+
+
+void TerminalScrollback::clear()
+{
+  m_bufferHead = 0;
+  m_first      = 0;
+  m_count      = 0;
+}
+
+
+void TerminalScrollback::discardOldest()
+{
+  m_first = (m_first + 1) % m_maxRows;
+  --m_count;
+}
+
+
+void TerminalScrollback::push(uint32_t const * mapRow, int columns)
+{
+  if (m_maxRows == 0)
+    return;
+
+  // trailing spaces with attributes of last item are not stored
+  const uint32_t lastAttrs = mapRow[columns - 1] >> 8;
+  int len = columns;
+  while (len > 0 && mapRow[len - 1] == ((lastAttrs << 8) | ASCII_SPC))
+    --len;
+  // an empty run keeps attributes of trailing spaces when they differ from previous run
+  const bool emptyRun = len < columns && (len == 0 || (mapRow[len - 1] >> 8) != lastAttrs);
+
+  // calculate size
+  int size = emptyRun ? 4 : 0;
+  for (int x = 0, runLen = 0; x < len; ++x, ++runLen) {
+    if (x == 0 || runLen == 255 || (mapRow[x] >> 8) != (mapRow[x - 1] >> 8)) {
+      size  += 4;
+      runLen = 0;
+    }
+    ++size;
+  }
+  if (size > m_bufferSize)
+    return;
+
+  // make room
+  if (m_count == m_maxRows)
+    discardOldest();
+  int offset = m_bufferHead;
+  if (offset + size > m_bufferSize) {
+    // restart from the beginning of the buffer, rows between current head and the end are the oldest ones
+    while (m_count > 0 && m_rows[m_first].offset >= m_bufferHead)
+      discardOldest();
+    offset = 0;
+  }
+  while (m_count > 0 && m_rows[m_first].offset >= offset && m_rows[m_first].offset < offset + size)
+    discardOldest();
+
+  // store runs
+  uint8_t * dest = m_buffer + offset;
+  uint8_t * runHeader = nullptr;
+  for (int x = 0; x < len; ++x) {
+    const uint32_t attrs = mapRow[x] >> 8;
+    if (x == 0 || runHeader[3] == 255 || attrs != (mapRow[x - 1] >> 8)) {
+      runHeader = dest;
+      runHeader[0] = attrs & 0xff;
+      runHeader[1] = (attrs >> 8) & 0xff;
+      runHeader[2] = attrs >> 16;
+      runHeader[3] = 0;
+      dest += 4;
+    }
+    *dest++ = mapRow[x] & 0xff;
+    ++runHeader[3];
+  }
+  if (emptyRun) {
+    dest[0] = lastAttrs & 0xff;
+    dest[1] = (lastAttrs >> 8) & 0xff;
+    dest[2] = lastAttrs >> 16;
+    dest[3] = 0;
+  }
+
+  RowDesc * rowDesc = m_rows + (m_first + m_count) % m_maxRows;
+  rowDesc->offset = offset;
+  rowDesc->size   = size;
+  ++m_count;
+  m_bufferHead = offset + size;
+}
+
+
+void TerminalScrollback::get(int index, uint32_t * mapRow, int columns)
+{
+  RowDesc const * rowDesc = m_rows + (m_first + index) % m_maxRows;
+  uint8_t const * src = m_buffer + rowDesc->offset;
+  uint8_t const * end = src + rowDesc->size;
+  uint32_t attrs = 0;
+  int x = 0;
+  while (src < end) {
+    attrs = src[0] | (src[1] << 8) | (src[2] << 16);
+    const int runLen = src[3];
+    src += 4;
+    for (int i = 0; i < runLen; ++i, ++src)
+      if (x < columns)
+        mapRow[x++] = (attrs << 8) | *src;
+  }
+  // trailing spaces
+  while (x < columns)
+    mapRow[x++] = (attrs << 8) | ASCII_SPC;
+}
+
+
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // TerminalController
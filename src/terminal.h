@@ -32,6 +32,8 @@
 
 
 
+#include <atomic>
+
 #include "Arduino.h"
 
 #include "freertos/FreeRTOS.h"
@@ -255,6 +257,89 @@ struct TerminalCursorState {
 };
 
 
+// Terminal input queue: bytes ring with one consumer (the chars consumer task) and many producers (tasks calling
+// write() and the UART interrupt).
+// The consumer side is lock-free. Producers are serialized by a spinlock, held just while bytes are copied.
+// Indexes run freely and are masked by the capacity, which is a power of two.
+class TerminalInputQueue {
+
+public:
+
+  TerminalInputQueue();
+
+  void alloc(int size);
+  void free();
+
+  int capacity()  { return m_mask + 1; }
+  int count()     { return m_head - m_tail; }
+  int spaces()    { return capacity() - count(); }
+
+  // producer side. Copies up to "size" bytes, returns the number of copied bytes.
+  // "wasEmpty" is set to true when the consumer may be waiting for this data and needs to be notified.
+  int write(uint8_t const * data, int size, bool fromISR, bool * wasEmpty);
+
+  // consumer side
+  int read(uint8_t * dest, int size);
+  bool peek(uint8_t * c);
+
+private:
+
+  uint8_t *             m_buffer;
+  uint32_t              m_mask;
+
+  std::atomic<uint32_t> m_head;   // next position to write, updated by producers
+  std::atomic<uint32_t> m_tail;   // next position to read, updated by the consumer
+
+  portMUX_TYPE          m_producersLock;
+};
+
+
+// Terminal scrollback buffer: rows scrolled out of the screen are stored as runs of glyphs map items with the same
+// attributes (colors and glyph options). Each run is 3 bytes of attributes, 1 byte of characters count, then the characters.
+// Trailing spaces of the last run are not stored.
+// Compressed rows are stored contiguously into a bytes ring and located by a ring of row descriptors, so append and
+// access by row are O(1). Oldest rows are discarded when either ring is full.
+class TerminalScrollback {
+
+public:
+
+  TerminalScrollback();
+
+  // buffers are allocated in PSRAM when available
+  bool alloc(int maxRows, int bufferSize);
+  void free();
+
+  int maxRows()  { return m_maxRows; }
+  int count()    { return m_count; }
+
+  void clear();
+
+  // appends a row of glyphs map items
+  void push(uint32_t const * mapRow, int columns);
+
+  // decodes row at "index" (0 = oldest) into "columns" glyphs map items
+  void get(int index, uint32_t * mapRow, int columns);
+
+private:
+
+  struct RowDesc {
+    uint32_t offset;
+    uint16_t size;
+  };
+
+  void discardOldest();
+
+  uint8_t *  m_buffer;
+  int        m_bufferSize;
+  int        m_bufferHead;  // where next row is written
+
+  RowDesc *  m_rows;
+  int        m_maxRows;
+  int        m_first;       // descriptor of oldest row
+  int        m_count;
+};
+
+
 enum KeypadMode {
   Application,  // DECKPAM
   Numeric,      // DECKPNM
@@ -659,6 +744,60 @@ public:
    */
   void enableCursor(bool value);
 
+  /**
+   * @brief Enables or disables deferred rendering.
+   *
+   * When deferred rendering is enabled incoming characters just update the characters map. Every FABGLIB_TERMINAL_RENDER_PERIOD_MS
+   * milliseconds the map is compared with what is on screen and only changed characters are drawn.<br>
+   * Output that rewrites the same lines many times (progress bars, "top", etc..) is drawn once per render period instead of once per character.
+   * Changes appear on screen with a delay up to FABGLIB_TERMINAL_RENDER_PERIOD_MS milliseconds.
+   * Deferred rendering requires additional memory, of the same size of the characters map. If it cannot be allocated (also when a
+   * font is loaded later) characters are drawn immediately.
+   *
+   * @param value If true deferred rendering is enabled.
+   *
+   * @return False if deferred rendering cannot be enabled because memory is not enough.
+   */
+  bool enableDeferredRendering(bool value);
+
+  /**
+   * @brief Enables or disables the scrollback buffer.
+   *
+   * When the scrollback buffer is enabled rows scrolled out from the top of the screen are stored compressed, in PSRAM when available.
+   * Rows of the alternate screen buffer are not stored.<br>
+   * SHIFT-PAGEUP and SHIFT-PAGEDOWN scroll the screen back into history (see setScrollbackView()), any other key returns to current screen.
+   *
+   * @param maxRows Maximum number of rows to keep. 0 disables the scrollback buffer, freeing its memory.
+   * @param bufferSize Size in bytes of compressed rows storage, oldest rows are discarded when it is full. -1 = maxRows * FABGLIB_TERMINAL_SCROLLBACK_ROW_SIZE.
+   *
+   * @return True if the scrollback buffer has been allocated.
+   */
+  bool enableScrollback(int maxRows, int bufferSize = -1);
+
+  /**
+   * @brief Gets number of rows stored in the scrollback buffer.
+   *
+   * @return Number of rows stored in the scrollback buffer.
+   */
+  int scrollbackRows() { return m_scrollback.count(); }
+
+  /**
+   * @brief Shows rows of the scrollback buffer.
+   *
+   * While history is shown the screen is held: received characters stay in the input queue (flow control may stop
+   * the sender) until the current screen is shown again.
+   *
+   * @param rows Number of rows the screen is moved back into history. 0 shows current screen.
+   */
+  void setScrollbackView(int rows);
+
+  /**
+   * @brief Gets number of rows the screen is moved back into history.
+   *
+   * @return Number of rows the screen is moved back into history. 0 when current screen is shown.
+   */
+  int scrollbackView() { return m_scrollbackView; }
+
   /**
    * @brief Determines number of codes that the display input queue can still accept.
    *
@@ -774,6 +913,18 @@ public:
    */
   int write(const uint8_t * buffer, int size);
 
+  /**
+   * @brief Sends specified number of codes to the display.
+   *
+   * Same of write(const uint8_t * buffer, int size), used by Print::write() overloads.
+   *
+   * @param buffer Pointer to codes buffer.
+   * @param size Number of codes in the buffer.
+   *
+   * @return The number of codes written.
+   */
+  size_t write(const uint8_t * buffer, size_t size);
+
   /**
    * @brief Sends a single code to the display.
    *
@@ -800,6 +951,7 @@ private:
   void reset();
   void int_clear();
   void clearMap(uint32_t * map);
+  uint32_t backgroundMapItem();
 
   void freeFont();
   void freeTabStops();
@@ -822,6 +974,9 @@ private:
   void resetTabStops();
 
   // scroll control
+  void scrollMapDown(uint32_t * map, uint32_t blankItem);
+  void scrollMapUp(uint32_t * map, uint32_t blankItem);
+
   void scrollDown();
   void scrollDownAt(int startingRow);
   void scrollUp();
@@ -864,6 +1019,8 @@ private:
   char getNextCode(bool processCtrlCodes);
 
   bool setChar(char c);
+  void setQueuedChars();
+  char translateChar(char c);
   GlyphOptions getGlyphOptionsAt(int X, int Y);
 
   void insertAt(int column, int row, int count);
@@ -878,6 +1035,14 @@ private:
   void refresh(int X, int Y);
   void refresh(int X1, int Y1, int X2, int Y2);
 
+  void int_setScrollbackView(int rows);
+  void renderScrollbackView();
+
+  void invalidateShadowMap(int X1, int Y1, int X2, int Y2);
+  void renderDeferred();
+  void flushPendingScroll();
+  void waitInputQueueRendering();
+
   void setLineDoubleWidth(int row, int value);
   int getCharWidthAt(int row);
   int getColumnsAt(int row);
@@ -894,13 +1059,17 @@ private:
 
   void ANSIDecodeVirtualKey(VirtualKey vk);
   void VT52DecodeVirtualKey(VirtualKey vk);
+  bool scrollbackDecodeVirtualKey(VirtualKey vk);
 
   void convHandleTranslation(uint8_t c, bool fromISR);
   void convSendCtrl(ConvCtrl ctrl, bool fromISR);
   void convQueue(const char * str, bool fromISR);
   void TermDecodeVirtualKey(VirtualKey vk);
 
-  bool addToInputQueue(char c, bool fromISR);
+  bool addToInputQueue(char c, bool fromISR) { return addToInputQueue((uint8_t const *) &c, 1, fromISR); }
+  bool addToInputQueue(uint8_t const * data, int size, bool fromISR);
+
+  void waitInputQueue();
 
   void write(char c, bool fromISR);
 
@@ -929,6 +1098,28 @@ private:
   int                m_alternateCursorX;
   int                m_alternateCursorY;
 
+  // deferred rendering: m_shadowMap contains what is actually on screen, cells of m_glyphsBuffer.map which
+  // differ are drawn by renderDeferred()
+  bool               m_deferredRendering;
+  uint32_t *         m_shadowMap;
+  volatile bool      m_renderPending;
+  int64_t            m_nextRenderTime;
+
+  // scrolls up already done on glyphs map but not yet on screen, coalesced by flushPendingScroll() in a single canvas scroll
+  int                m_pendingScrollRows;
+  int64_t            m_pendingScrollDeadline;
+
+  // rows to redraw by flushPendingScroll() (bit 0 = first row)
+  uint32_t           m_dirtyRows;
+
+  TerminalScrollback m_scrollback;
+
+  // number of rows the screen is moved back into history (0 = current screen). m_scrollbackViewBuffer.map contains
+  // history rows followed by screen rows
+  volatile int       m_scrollbackView;
+  GlyphsBuffer       m_scrollbackViewBuffer;
+  bool               m_scrollbackViewPrevCursorEnabled;
+
   FontInfo           m_font;
 
   PaintOptions       m_paintOptions;
@@ -975,7 +1166,7 @@ private:
   volatile bool             m_uart;
 
   // contains characters to be processed (from write() calls)
-  volatile QueueHandle_t    m_inputQueue;
+  TerminalInputQueue        m_inputQueue;
 
   // contains characters received and decoded from keyboard (or as replyes from ANSI-VT queries)
   QueueHandle_t             m_outputQueue;
@@ -0,0 +1,63 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+// Minimal single threaded replacement of FreeRTOS and ESP-IDF definitions used by the hardware independent parts of FabGL.
+// Only for host builds (FABGLIB_HOST_BUILD = 1), see tools/hostshim/readme.txt
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+
+#define IRAM_ATTR
+
+#define pdFALSE             0
+#define pdTRUE              1
+#define portMAX_DELAY       0xffffffffUL
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+
+typedef int       BaseType_t;
+typedef unsigned  UBaseType_t;
+typedef uint32_t  TickType_t;
+
+
+// memory capabilities are ignored
+#define MALLOC_CAP_32BIT     (1 << 1)
+#define MALLOC_CAP_8BIT      (1 << 2)
+#define MALLOC_CAP_DMA       (1 << 3)
+#define MALLOC_CAP_SPIRAM    (1 << 10)
+#define MALLOC_CAP_INTERNAL  (1 << 11)
+
+inline void * heap_caps_malloc(size_t size, uint32_t caps)              { return malloc(size); }
+inline void * heap_caps_realloc(void * ptr, size_t size, uint32_t caps) { return realloc(ptr, size); }
+inline void heap_caps_free(void * ptr)                                  { free(ptr); }
+
+
+typedef enum {
+  GPIO_NUM_0 = 0,
+  GPIO_NUM_MAX = 40,
+} gpio_num_t;
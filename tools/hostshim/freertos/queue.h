@@ -0,0 +1,44 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+
+#include "freertos/FreeRTOS.h"
+
+
+// queues never block: sending to a full queue or receiving from an empty queue fails immediately
+
+typedef struct HostQueue * QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, void const * item, TickType_t ticksToWait);
+BaseType_t xQueueSendToFront(QueueHandle_t queue, void const * item, TickType_t ticksToWait);
+BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t ticksToWait);
+BaseType_t xQueuePeek(QueueHandle_t queue, void * item, TickType_t ticksToWait);
+BaseType_t xQueueReset(QueueHandle_t queue);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
+
+inline BaseType_t xQueueSendToBackFromISR(QueueHandle_t queue, void const * item, BaseType_t * woken) { return xQueueSendToBack(queue, item, 0); }
+inline BaseType_t xQueueReceiveFromISR(QueueHandle_t queue, void * item, BaseType_t * woken)          { return xQueueReceive(queue, item, 0); }
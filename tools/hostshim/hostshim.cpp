@@ -0,0 +1,188 @@
+/*
+  Created by Fabrizio Di Vittorio (fdivitto2013@gmail.com) - <http://www.fabgl.com>
+  Copyright (c) 2019-2020 Fabrizio Di Vittorio.
+  All rights reserved.
+
+  This file is part of FabGL Library.
+
+  FabGL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  FabGL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with FabGL.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "xtensa/hal.h"
+#include "rom/ets_sys.h"
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Queues
+
+
+struct HostQueue {
+  UBaseType_t                      length;
+  UBaseType_t                      itemSize;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+  return new HostQueue { length, itemSize, { } };
+}
+
+
+void vQueueDelete(QueueHandle_t queue)
+{
+  delete queue;
+}
+
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, void const * item, TickType_t ticksToWait)
+{
+  if (queue->items.size() >= queue->length)
+    return pdFALSE;
+  auto src = (uint8_t const *) item;
+  queue->items.emplace_back(src, src + queue->itemSize);
+  return pdTRUE;
+}
+
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, void const * item, TickType_t ticksToWait)
+{
+  if (queue->items.size() >= queue->length)
+    return pdFALSE;
+  auto src = (uint8_t const *) item;
+  queue->items.emplace_front(src, src + queue->itemSize);
+  return pdTRUE;
+}
+
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void * item, TickType_t ticksToWait)
+{
+  if (xQueuePeek(queue, item, ticksToWait) == pdFALSE)
+    return pdFALSE;
+  queue->items.pop_front();
+  return pdTRUE;
+}
+
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void * item, TickType_t ticksToWait)
+{
+  if (queue->items.empty())
+    return pdFALSE;
+  memcpy(item, queue->items.front().data(), queue->itemSize);
+  return pdTRUE;
+}
+
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+  queue->items.clear();
+  return pdTRUE;
+}
+
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+  return queue->items.size();
+}
+
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+  return queue->length - queue->items.size();
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Semaphores
+
+
+struct HostSemaphore {
+  UBaseType_t count;
+  UBaseType_t maxCount;
+};
+
+
+SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+  return new HostSemaphore { 0, 1 };
+}
+
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+  return new HostSemaphore { 1, 1 };
+}
+
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+  delete semaphore;
+}
+
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait)
+{
+  if (semaphore->count == 0)
+    return pdFALSE;
+  --semaphore->count;
+  return pdTRUE;
+}
+
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+  if (semaphore->count >= semaphore->maxCount)
+    return pdFALSE;
+  ++semaphore->count;
+  return pdTRUE;
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Timer
+
+
+int64_t esp_timer_get_time()
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// CPU cycles
+
+
+unsigned xthal_get_ccount()
+{
+  return (unsigned) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+uint32_t ets_get_cpu_frequency()
+{
+  return 1000;
+}